@@ -0,0 +1,421 @@
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+// Standalone rate and efficiency histograms from the event_summary tree
+// written by L1EGRateStudies (summaryTopN > 0), without cmsRun.
+//
+//   l1egStandalone [options] egTriggerRates.root [more.root ...]
+//
+//      -j N                 worker threads (default: one per hardware thread)
+//      -o FILE              output (default l1egStandalone.root)
+//      -t PATH              summary tree (default analyzer/event_summary)
+//      --chunk N            events per work unit (default 5000)
+//      --skip N --events N  only entries [N, N+events) of the inputs taken in order, for
+//                           schedulers that hand out event ranges (see localScheduler.py)
+//      --efficiency         efficiency instead of rate histograms (needs truth_* in the summary)
+//      --endcap             do not restrict candidates to the barrel
+//      --emulated           select with the fixed-point emulated cut bits
+//      --bins N --low X --high X   pt binning (default 10, 0, 50)
+//      --track-dr X         track match dR cut (default 0.1)
+//      --max-candidates N   as multiObjectMaxCandidates (default 6)
+//
+// The input files are indexed once, split into event ranges of --chunk
+// events, and the ranges are processed by a WorkStealingPool; each thread
+// has its own file handles and AnalysisCore::Worker, and the accumulators
+// are merged at the end.  The histograms have the same names and
+// normalisation as the analyzer's, in a directory "analyzer", so
+// normalizeParallelJobs.C and the drawing macros apply unchanged.  The
+// summary keeps the summaryTopN leading candidates of every acceptance and
+// working point selection (see EventSummary.h), so the single rates are
+// exact for summaryTopN >= 1 and the double rates for summaryTopN >= 2.
+// The track-matched rates walk up to multiObjectMaxCandidates passing
+// clusters, they need summaryTopN >= multiObjectMaxCandidates to be exact.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "RVersion.h"
+#include "TFile.h"
+#include "TH1F.h"
+#include "TH2F.h"
+#include "TNamed.h"
+#include "TParameter.h"
+#include "TROOT.h"
+#include "TTree.h"
+#if ROOT_VERSION_CODE < ROOT_VERSION(6,0,0)
+#include "TThread.h"
+#endif
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/AnalysisCore.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/WorkStealingPool.h"
+
+namespace {
+
+struct Options {
+   unsigned threads = 0;
+   std::string output = "l1egStandalone.root";
+   std::string tree = "analyzer/event_summary";
+   Long64_t chunk = 5000;
+   Long64_t skip = 0;
+   Long64_t events = -1;
+   std::vector<std::string> files;
+   l1eg::AnalysisCore::Config core;
+};
+
+Options parse(int argc, char ** argv)
+{
+   Options o;
+   for(int i=1; i<argc; ++i)
+   {
+      const std::string arg = argv[i];
+      auto value = [&]() -> std::string {
+         if ( i+1 >= argc ) throw std::runtime_error("missing value for "+arg);
+         return argv[++i];
+      };
+      if ( arg == "-j" ) o.threads = std::stoul(value());
+      else if ( arg == "-o" ) o.output = value();
+      else if ( arg == "-t" ) o.tree = value();
+      else if ( arg == "--chunk" ) o.chunk = std::max(1L, std::stol(value()));
+      else if ( arg == "--skip" ) o.skip = std::max(0L, std::stol(value()));
+      else if ( arg == "--events" ) o.events = std::stol(value());
+      else if ( arg == "--efficiency" ) o.core.doEfficiencyCalc = true;
+      else if ( arg == "--endcap" ) o.core.useEndcap = true;
+      else if ( arg == "--emulated" ) o.core.useEmulatedCuts = true;
+      else if ( arg == "--bins" ) o.core.nHistBins = std::stoi(value());
+      else if ( arg == "--low" ) o.core.histLow = std::stod(value());
+      else if ( arg == "--high" ) o.core.histHigh = std::stod(value());
+      else if ( arg == "--track-dr" ) o.core.trackMatchDeltaRcut = std::stod(value());
+      else if ( arg == "--max-candidates" ) o.core.multiObjectMaxCandidates = std::stoul(value());
+      else if ( !arg.empty() && arg[0] == '-' ) throw std::runtime_error("unknown option "+arg);
+      else o.files.push_back(arg);
+   }
+   if ( o.files.empty() ) throw std::runtime_error("no input files");
+   return o;
+}
+
+// Reads event_summary entries into FlatEvents, one per thread
+class SummaryReader
+{
+   public:
+      SummaryReader(const std::string& treePath, const std::vector<std::string>& egPrefixes, int capacity) :
+         treePath_(treePath), capacity_(capacity)
+      {
+         crystal_.prefix = "crystal";
+         truth_.prefix = "truth";
+         for(const auto& prefix : egPrefixes)
+         {
+            eg_.push_back(Block());
+            eg_.back().prefix = prefix;
+         }
+         for(auto * block : blocks()) block->resize(capacity_);
+         for(auto * column : {&passBits_, &emulatedPassBits_}) column->resize(capacity_);
+         for(auto * column : {&hovere_, &iso_, &bremStrength_, &trackDeltaR_}) column->resize(capacity_);
+      };
+
+      void open(const std::string& fileName)
+      {
+         if ( fileName == fileName_ ) return;
+         file_.reset(TFile::Open(fileName.c_str()));
+         if ( !file_ || file_->IsZombie() ) throw std::runtime_error("cannot open "+fileName);
+         tree_ = dynamic_cast<TTree *>(file_->Get(treePath_.c_str()));
+         if ( tree_ == nullptr ) throw std::runtime_error(fileName+": no tree "+treePath_);
+         fileName_ = fileName;
+
+         tree_->SetBranchStatus("*", 0);
+         connect("run", &run_);
+         connect("lumi", &lumi_);
+         connect("event", &event_);
+         for(auto * block : blocks())
+         {
+            block->present = connect(block->prefix+"_n", &block->n);
+            connect(block->prefix+"_pt", block->pt.data());
+            connect(block->prefix+"_eta", block->eta.data());
+            connect(block->prefix+"_phi", block->phi.data());
+         }
+         connect("crystal_passBits", passBits_.data());
+         hasEmulated_ = connect("crystal_emulatedPassBits", emulatedPassBits_.data());
+         connect("crystal_hovere", hovere_.data());
+         connect("crystal_iso", iso_.data());
+         connect("crystal_bremStrength", bremStrength_.data());
+         hasTrackDeltaR_ = connect("crystal_trackDeltaR", trackDeltaR_.data());
+      };
+
+      void read(Long64_t entry, l1eg::FlatEvent& event)
+      {
+         tree_->GetEntry(entry);
+         event.run = run_;
+         event.lumi = lumi_;
+         event.event = event_;
+
+         event.clusters.resize(crystal_.n);
+         event.clusterTrackDeltaR.clear();
+         for(int k=0; k<crystal_.n; ++k)
+         {
+            auto& f = event.clusters[k];
+            f.pt = crystal_.pt[k];
+            f.eta = crystal_.eta[k];
+            f.phi = crystal_.phi[k];
+            f.energy = 0.;
+            f.hovere = hovere_[k];
+            f.iso = iso_[k];
+            f.bremStrength = bremStrength_[k];
+            f.crystalPt.fill(0.);
+            f.params.fill(0.);
+            f.passBits = passBits_[k];
+            f.emulatedPassBits = hasEmulated_ ? emulatedPassBits_[k] : 0;
+            if ( hasTrackDeltaR_ ) event.clusterTrackDeltaR.push_back(trackDeltaR_[k]);
+         }
+
+         event.emulatedCuts = hasEmulated_;
+         event.eg.resize(eg_.size());
+         for(size_t i=0; i<eg_.size(); ++i) eg_[i].copyTo(event.eg[i]);
+         truth_.copyTo(event.truth);
+      };
+
+   private:
+      struct Block {
+         std::string prefix;
+         bool present = false;
+         Int_t n = 0;
+         std::vector<Float_t> pt, eta, phi;
+
+         void resize(int capacity)
+         {
+            pt.resize(capacity);
+            eta.resize(capacity);
+            phi.resize(capacity);
+         };
+
+         void copyTo(std::vector<l1eg::FlatCandidate>& out) const
+         {
+            out.clear();
+            if ( !present ) return;
+            for(int k=0; k<n; ++k) out.push_back(l1eg::FlatCandidate{pt[k], eta[k], phi[k]});
+         };
+      };
+
+      std::vector<Block *> blocks()
+      {
+         std::vector<Block *> out {&crystal_, &truth_};
+         for(auto& block : eg_) out.push_back(&block);
+         return out;
+      };
+
+      // False if the branch is not in this summary (older versions)
+      template<typename T>
+      bool connect(const std::string& name, T * address)
+      {
+         if ( tree_->GetBranch(name.c_str()) == nullptr ) return false;
+         tree_->SetBranchStatus(name.c_str(), 1);
+         tree_->SetBranchAddress(name.c_str(), address);
+         return true;
+      };
+
+      std::string treePath_;
+      int capacity_;
+      std::string fileName_;
+      std::unique_ptr<TFile> file_;
+      TTree * tree_ = nullptr;
+      UInt_t run_ = 0;
+      UInt_t lumi_ = 0;
+      ULong64_t event_ = 0;
+      Block crystal_, truth_;
+      std::vector<Block> eg_;
+      std::vector<UInt_t> passBits_, emulatedPassBits_;
+      std::vector<Float_t> hovere_, iso_, bremStrength_, trackDeltaR_;
+      bool hasEmulated_ = false;
+      bool hasTrackDeltaR_ = false;
+};
+
+struct Shard {
+   size_t file;
+   Long64_t first;
+   Long64_t last;
+};
+
+struct WorkerState {
+   WorkerState(const l1eg::AnalysisCore& core, const std::string& treePath, const std::vector<std::string>& egPrefixes, int capacity) :
+      worker(core), reader(treePath, egPrefixes, capacity)
+   {};
+   l1eg::AnalysisCore::Worker worker;
+   SummaryReader reader;
+   l1eg::FlatEvent event;
+};
+
+TH1F * toTH1F(const std::string& name, const std::string& title, const l1eg::BinnedCounts& counts)
+{
+   TH1F * hist = new TH1F(name.c_str(), title.c_str(), counts.nBinsX(), counts.lowX(), counts.highX());
+   for(int i=0; i<=counts.nBinsX()+1; ++i) hist->SetBinContent(i, counts.content(i));
+   return hist;
+}
+
+TH2F * toTH2F(const std::string& name, const std::string& title, const l1eg::BinnedCounts& counts)
+{
+   TH2F * hist = new TH2F(name.c_str(), title.c_str(), counts.nBinsX(), counts.lowX(), counts.highX(), counts.nBinsY(), counts.lowY(), counts.highY());
+   for(int i=0; i<=counts.nBinsX()+1; ++i)
+      for(int j=0; j<=counts.nBinsY()+1; ++j)
+         hist->SetBinContent(i, j, counts.content(i, j));
+   return hist;
+}
+
+void writeRates(const std::string& name, const std::string& title, const l1eg::AnalysisCore::Rates& rates)
+{
+   toTH1F(name+"_rate", title+";ET Threshold (GeV);Rate (kHz)", rates.single)->Write();
+   toTH1F(name+"_rate_double", title+", double EG;Subleading ET Threshold (GeV);Rate (kHz)", rates.doubleObject)->Write();
+   toTH2F(name+"_rate_doubleGrid", title+", double EG;Leading ET Threshold (GeV);Subleading ET Threshold (GeV);Rate (kHz)", rates.doubleGrid)->Write();
+}
+
+void writeEfficiency(const std::string& name, const std::string& title, const l1eg::AnalysisCore::Efficiency& efficiency)
+{
+   toTH1F(name+"_efficiency_pt", title+";Gen. pT (GeV);Efficiency", efficiency.pt)->Write();
+   toTH1F(name+"_efficiency_eta", title+";Gen. #eta;Efficiency", efficiency.eta)->Write();
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+   Options options;
+   try
+   {
+      options = parse(argc, argv);
+   }
+   catch(std::exception& e)
+   {
+      std::cerr << "l1egStandalone: " << e.what() << std::endl;
+      return 1;
+   }
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+   ROOT::EnableThreadSafety();
+#else
+   TThread::Initialize();
+#endif
+   gROOT->SetBatch(true);
+   const auto start = std::chrono::steady_clock::now();
+
+   // Index: entries per file, the algorithms and the branch capacity from the first summary
+   std::vector<std::string> egPrefixes;
+   int capacity = 0;
+   std::vector<Shard> shards;
+   Long64_t nEvents = 0;
+   Long64_t offset = 0;
+   const Long64_t rangeEnd = options.events < 0 ? std::numeric_limits<Long64_t>::max() : options.skip+options.events;
+   for(size_t f=0; f<options.files.size(); ++f)
+   {
+      std::unique_ptr<TFile> file(TFile::Open(options.files[f].c_str()));
+      TTree * tree = file ? dynamic_cast<TTree *>(file->Get(options.tree.c_str())) : nullptr;
+      if ( tree == nullptr )
+      {
+         std::cerr << "l1egStandalone: no " << options.tree << " in " << options.files[f] << ", skipped" << std::endl;
+         continue;
+      }
+      if ( egPrefixes.empty() )
+      {
+         TIter next(tree->GetListOfBranches());
+         while ( TObject * branch = next() )
+         {
+            const std::string name = branch->GetName();
+            if ( name.size() < 2 || name.compare(name.size()-2, 2, "_n") != 0 ) continue;
+            const std::string prefix = name.substr(0, name.size()-2);
+            if ( prefix == "crystal" || prefix == "truth" ) continue;
+            egPrefixes.push_back(prefix);
+            auto * named = dynamic_cast<TNamed *>(tree->GetUserInfo()->FindObject(prefix.c_str()));
+            options.core.egNames.push_back(named ? named->GetTitle() : prefix);
+         }
+         // Array length of the candidate branches, topN in summaries older than the per-selection top N
+         auto * stored = dynamic_cast<TParameter<Int_t> *>(tree->GetUserInfo()->FindObject("capacity"));
+         if ( stored == nullptr ) stored = dynamic_cast<TParameter<Int_t> *>(tree->GetUserInfo()->FindObject("topN"));
+         capacity = stored ? stored->GetVal() : 0;
+      }
+      if ( capacity == 0 ) capacity = std::max(1, static_cast<int>(tree->GetMaximum("crystal_n")));
+      // This file's part of the requested range
+      const Long64_t entries = tree->GetEntries();
+      const Long64_t begin = std::max(0LL, options.skip-offset);
+      const Long64_t end = std::min(entries, rangeEnd-offset);
+      offset += entries;
+      for(Long64_t first=begin; first<end; first+=options.chunk)
+         shards.push_back(Shard{f, first, std::min(end, first+options.chunk)});
+      nEvents += std::max(0LL, end-begin);
+   }
+   if ( shards.empty() )
+   {
+      std::cerr << "l1egStandalone: nothing to process" << std::endl;
+      return 1;
+   }
+
+   const l1eg::AnalysisCore core(options.core);
+   l1eg::WorkStealingPool pool(options.threads);
+   std::vector<std::unique_ptr<WorkerState>> workers;
+   for(unsigned w=0; w<pool.size(); ++w)
+      workers.emplace_back(new WorkerState(core, options.tree, egPrefixes, capacity));
+   const auto indexed = std::chrono::steady_clock::now();
+
+   try
+   {
+      pool.run(shards.size(), [&](size_t s, unsigned w) {
+         const Shard& shard = shards[s];
+         WorkerState& state = *workers[w];
+         state.reader.open(options.files[shard.file]);
+         for(Long64_t entry=shard.first; entry<shard.last; ++entry)
+         {
+            state.reader.read(entry, state.event);
+            core.process(state.event, state.worker);
+         }
+      });
+   }
+   catch(std::exception& e)
+   {
+      std::cerr << "l1egStandalone: " << e.what() << std::endl;
+      return 1;
+   }
+   const auto processed = std::chrono::steady_clock::now();
+
+   // Reduce
+   auto total = core.makeAccumulators();
+   for(const auto& state : workers) total.merge(state->worker.accumulators);
+
+   TFile out(options.output.c_str(), "RECREATE");
+   out.mkdir("analyzer")->cd();
+   if ( options.core.doEfficiencyCalc )
+   {
+      writeEfficiency("dyncrystalEG", "Dynamic Crystal Trigger", total.crystalEfficiency);
+      for(size_t i=0; i<options.core.egNames.size(); ++i)
+         writeEfficiency(options.core.egNames[i], options.core.egNames[i], total.egEfficiency[i]);
+      toTH1F("gen_pt", "Gen. pt;Gen. pT (GeV); Counts", total.denominator.pt)->Write();
+      toTH1F("gen_eta", "Gen. #eta;Gen. #eta; Counts", total.denominator.eta)->Write();
+      // No offline reco in the summary, booked empty for normalizeParallelJobs.C
+      toTH1F("reco_pt", "Offline reco. pt;Gen. pT (GeV); Counts", l1eg::BinnedCounts(options.core.nHistBins, options.core.histLow, options.core.histHigh))->Write();
+   }
+   else
+   {
+      // As L1EGRateStudies::endJob: integrated, not normalised, with the event count alongside
+      total.integrateRates();
+      TH1F eventCount("eventCount", "Event Count", 1, -1, 1);
+      eventCount.SetBinContent(1, total.eventCount);
+      eventCount.Write();
+      writeRates("dyncrystalEG", "Dynamic Crystal Trigger", total.crystal);
+      writeRates("dyncrystalEG_trackMatched", "Dynamic Crystal Trigger, track-matched", total.trackMatched);
+      toTH2F("dyncrystalEG_trackMatched_rate_plusEGGrid", "Dynamic Crystal Trigger, track-matched EG + EG;Track-matched ET Threshold (GeV);Other EG ET Threshold (GeV);Rate (kHz)", total.trackMatchedPlusEG)->Write();
+      for(size_t i=0; i<options.core.egNames.size(); ++i)
+         writeRates(options.core.egNames[i], options.core.egNames[i], total.eg[i]);
+   }
+   out.Close();
+
+   const auto seconds = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+      return std::chrono::duration<double>(b-a).count();
+   };
+   std::cout << "l1egStandalone: " << nEvents << " events in " << shards.size() << " ranges, " << total.eventCount << " counted, "
+             << pool.size() << " threads, " << pool.steals() << " ranges stolen" << std::endl
+             << "  index " << seconds(start, indexed) << "s, process " << seconds(indexed, processed) << "s ("
+             << nEvents/std::max(1e-9, seconds(indexed, processed)) << " events/s), output " << options.output << std::endl;
+   return 0;
+}
@@ -0,0 +1,427 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_AnalysisCore_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_AnalysisCore_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::AnalysisCore AnalysisCore.h SLHCUpgradeSimulations/L1EGRateStudies/interface/AnalysisCore.h
+
+ Description: Framework-free rate and efficiency accumulation on flat per-event inputs
+
+ Implementation:
+     FlatEvent holds what the rate and efficiency passes of L1EGRateStudies
+     read: the cluster feature records (with their cut bits), the dR to
+     the nearest L1 track of each cluster, the EG candidates of each other
+     algorithm, and the truth particles at the ECAL entrance.  process()
+     applies the same selections as the analyzer: barrel only unless
+     useEndcap, working point kRateStudies (or its fixed-point emulation),
+     the leading and subleading passing object for the single, double and
+     track-matched rates, and the one-to-one truth matching with a dR and
+     relative pt cut for the efficiencies.  The per-event selection is
+     public, rates(event, scratch, out), so that L1EGRateStudies fills its
+     rate histograms from the same code.
+
+     All per-thread state lives in a Worker: the accumulators (plain bin
+     counts, merged with merge()) and the matching buffers.  The core itself
+     is const during processing, so any number of workers can share it.
+     Nothing here depends on the framework or on ROOT; bin/l1egStandalone
+     feeds it from the event_summary tree and writes the histograms.
+*/
+//
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ClusterFeatures.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/DeltaRMatching.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/PtOrdered.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ScratchArena.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/TruthMatching.h"
+
+namespace l1eg {
+
+struct FlatCandidate {
+   float pt;
+   float eta;
+   float phi;
+};
+
+struct FlatEvent {
+   uint32_t run = 0;
+   uint32_t lumi = 0;
+   uint64_t event = 0;
+   std::vector<ClusterFeatures> clusters;
+   // dR to the nearest L1 track, same order as clusters; empty if there are no tracks
+   std::vector<float> clusterTrackDeltaR;
+   // EG candidates of each algorithm, in AnalysisCore::Config::egNames order
+   std::vector<std::vector<FlatCandidate>> eg;
+   // Generated electrons and photons at the ECAL entrance
+   std::vector<FlatCandidate> truth;
+   // False if the emulated cut bits were not computed, useEmulatedCuts then selects with the float cuts
+   bool emulatedCuts = true;
+};
+
+// Bin counts with under- and overflow, binned like TH1 (bin 0 underflow, nBins+1 overflow)
+class BinnedCounts
+{
+   public:
+      BinnedCounts() {};
+      BinnedCounts(int nBins, double lo, double hi, int nBinsY = 0, double loY = 0., double hiY = 0.) :
+         nx_(nBins), ny_(nBinsY), lo_(lo), hi_(hi), loY_(loY), hiY_(hiY),
+         counts_((nBins+2)*(nBinsY > 0 ? nBinsY+2 : 1), 0.)
+      {};
+
+      int nBinsX() const { return nx_; };
+      int nBinsY() const { return ny_; };
+      double lowX() const { return lo_; };
+      double highX() const { return hi_; };
+      double lowY() const { return loY_; };
+      double highY() const { return hiY_; };
+
+      void fill(double x) { counts_[bin(x, nx_, lo_, hi_)] += 1.; };
+      void fill(double x, double y) { counts_[index(bin(x, nx_, lo_, hi_), bin(y, ny_, loY_, hiY_))] += 1.; };
+
+      double content(int i, int j = 0) const { return counts_[index(i, j)]; };
+
+      void merge(const BinnedCounts& other)
+      {
+         for(size_t i=0; i<counts_.size(); ++i) counts_[i] += other.counts_[i];
+      };
+
+      // Each bin becomes the count at or above its lower edge, over and underflow included
+      // (as L1EGRateStudies::integrateDown)
+      void integrateDown()
+      {
+         if ( ny_ == 0 )
+         {
+            for(int i=nx_; i>=0; --i) counts_[i] += counts_[i+1];
+            return;
+         }
+         for(int i=nx_+1; i>=0; --i)
+            for(int j=ny_+1; j>=0; --j)
+            {
+               double integral = content(i, j);
+               if ( i <= nx_ ) integral += content(i+1, j);
+               if ( j <= ny_ ) integral += content(i, j+1);
+               if ( i <= nx_ && j <= ny_ ) integral -= content(i+1, j+1);
+               counts_[index(i, j)] = integral;
+            }
+      };
+
+   private:
+      static int bin(double x, int n, double lo, double hi)
+      {
+         if ( x < lo ) return 0;
+         if ( !(x < hi) ) return n+1;
+         return 1 + std::min(n-1, int(n*(x-lo)/(hi-lo)));
+      };
+      size_t index(int i, int j) const { return size_t(j)*(nx_+2) + i; };
+
+      int nx_ = 0;
+      int ny_ = 0;
+      double lo_ = 0., hi_ = 0., loY_ = 0., hiY_ = 0.;
+      std::vector<double> counts_;
+};
+
+class AnalysisCore
+{
+   public:
+      struct Config {
+         bool useEndcap = false;
+         bool useEmulatedCuts = false;
+         // Efficiency mode: events without truth in acceptance are not counted
+         bool doEfficiencyCalc = false;
+         float trackMatchDeltaRcut = 0.1;
+         float genMatchDeltaRcut = 0.1;
+         float genMatchRelPtcut = 0.5;
+         unsigned multiObjectMaxCandidates = 6;
+         int nHistBins = 10;
+         double histLow = 0.;
+         double histHigh = 50.;
+         int nHistEtaBins = 20;
+         double histetaLow = -2.5;
+         double histetaHigh = 2.5;
+         std::vector<std::string> egNames;
+      };
+
+      // Leading-object rates of one algorithm, before integration
+      struct Rates {
+         BinnedCounts single;
+         BinnedCounts doubleObject;
+         BinnedCounts doubleGrid;
+
+         void merge(const Rates& other)
+         {
+            single.merge(other.single);
+            doubleObject.merge(other.doubleObject);
+            doubleGrid.merge(other.doubleGrid);
+         };
+      };
+
+      struct Efficiency {
+         BinnedCounts pt;
+         BinnedCounts eta;
+
+         void merge(const Efficiency& other)
+         {
+            pt.merge(other.pt);
+            eta.merge(other.eta);
+         };
+      };
+
+      struct Accumulators {
+         long eventCount = 0;
+         Rates crystal;
+         Rates trackMatched;
+         BinnedCounts trackMatchedPlusEG;
+         std::vector<Rates> eg;
+         Efficiency denominator;
+         Efficiency crystalEfficiency;
+         std::vector<Efficiency> egEfficiency;
+
+         void merge(const Accumulators& other)
+         {
+            eventCount += other.eventCount;
+            crystal.merge(other.crystal);
+            trackMatched.merge(other.trackMatched);
+            trackMatchedPlusEG.merge(other.trackMatchedPlusEG);
+            for(size_t i=0; i<eg.size(); ++i) eg[i].merge(other.eg[i]);
+            denominator.merge(other.denominator);
+            crystalEfficiency.merge(other.crystalEfficiency);
+            for(size_t i=0; i<egEfficiency.size(); ++i) egEfficiency[i].merge(other.egEfficiency[i]);
+         };
+
+         // Rate histograms to rates above threshold, once all workers are merged
+         void integrateRates()
+         {
+            for(Rates * r : {&crystal, &trackMatched})
+            {
+               r->single.integrateDown();
+               r->doubleObject.integrateDown();
+               r->doubleGrid.integrateDown();
+            }
+            trackMatchedPlusEG.integrateDown();
+            for(auto& r : eg)
+            {
+               r.single.integrateDown();
+               r.doubleObject.integrateDown();
+               r.doubleGrid.integrateDown();
+            }
+         };
+      };
+
+      // Leading and subleading selected objects of one event
+      struct Leading {
+         std::array<float, 2> pt {{0., 0.}};
+         unsigned n = 0;
+      };
+
+      // What one event contributes to the rates
+      struct EventRates {
+         Leading crystal;
+         Leading trackMatched;
+         // Cross trigger: the leading track-matched cluster plus the leading other passing cluster
+         bool trackMatchedPlusEG = false;
+         float trackMatchedPlusEGOtherPt = 0.;
+         // Same order as FlatEvent::eg
+         std::vector<Leading> eg;
+      };
+
+      // Per-thread accumulators and buffers
+      struct Worker {
+         explicit Worker(const AnalysisCore& core) : accumulators(core.makeAccumulators()) {};
+
+         Accumulators accumulators;
+         EventRates eventRates;
+         std::vector<FlatCandidate> denominators;
+         EtaPhiArray trueEtaPhi;
+         EtaPhiArray matchEtaPhi;
+         OneToOneMatcher oneToOne;
+         ScratchArena scratch;
+      };
+
+      explicit AnalysisCore(const Config& config) : config_(config) {};
+
+      const Config& config() const { return config_; };
+
+      // Empty accumulators binned as configured
+      Accumulators makeAccumulators() const
+      {
+         Accumulators a;
+         a.crystal = rates();
+         a.trackMatched = rates();
+         a.trackMatchedPlusEG = grid();
+         a.eg.assign(config_.egNames.size(), rates());
+         a.denominator = efficiency();
+         a.crystalEfficiency = efficiency();
+         a.egEfficiency.assign(config_.egNames.size(), efficiency());
+         return a;
+      };
+
+      bool passesCuts(const FlatEvent& event, const ClusterFeatures& f) const
+      {
+         return ( config_.useEmulatedCuts && event.emulatedCuts ) ? f.passesEmulated(ClusterFeatures::kRateStudies) : f.passes(ClusterFeatures::kRateStudies);
+      };
+
+      bool inAcceptance(float eta) const { return config_.useEndcap || std::fabs(eta) < 1.479; };
+
+      void process(const FlatEvent& event, Worker& worker) const
+      {
+         worker.scratch.reset();
+         if ( config_.doEfficiencyCalc )
+         {
+            if ( !efficiency(event, worker) ) return;
+         }
+         else
+            rates(event, worker);
+         worker.accumulators.eventCount++;
+      };
+
+      // Clusters are walked in pt order until the two leading passing and the two leading
+      // track-matched passing clusters are known, or multiObjectMaxCandidates passing clusters were seen
+      void rates(const FlatEvent& event, ScratchArena& scratch, EventRates& out) const
+      {
+         out.crystal = Leading();
+         out.trackMatched = Leading();
+         out.trackMatchedPlusEG = false;
+         out.trackMatchedPlusEGOtherPt = 0.;
+         unsigned trackMatchedRank = 0; // rank of the leading track-matched cluster among the passing ones
+         for(unsigned i : ptOrdered(event.clusters, scratch))
+         {
+            const auto& f = event.clusters[i];
+            if ( !inAcceptance(f.eta) || !passesCuts(event, f) ) continue;
+            if ( out.crystal.n < 2 ) out.crystal.pt[out.crystal.n] = f.pt;
+            if ( !event.clusterTrackDeltaR.empty() && event.clusterTrackDeltaR[i] < config_.trackMatchDeltaRcut )
+            {
+               if ( out.trackMatched.n == 0 ) trackMatchedRank = out.crystal.n;
+               if ( out.trackMatched.n < 2 ) out.trackMatched.pt[out.trackMatched.n] = f.pt;
+               out.trackMatched.n++;
+            }
+            out.crystal.n++;
+            if ( (out.crystal.n >= 2 && out.trackMatched.n >= 2) || out.crystal.n >= config_.multiObjectMaxCandidates ) break;
+         }
+         if ( out.trackMatched.n > 0 && out.crystal.n > 1 )
+         {
+            out.trackMatchedPlusEG = true;
+            out.trackMatchedPlusEGOtherPt = ( trackMatchedRank == 0 ) ? out.crystal.pt[1] : out.crystal.pt[0];
+         }
+
+         // Can't assume the highest candidates are in the barrel
+         out.eg.resize(event.eg.size());
+         for(size_t alg=0; alg<event.eg.size(); ++alg)
+         {
+            Leading& leading = out.eg[alg];
+            leading = Leading();
+            for(unsigned i : ptOrdered(event.eg[alg], scratch))
+            {
+               const auto& candidate = event.eg[alg][i];
+               if ( !inAcceptance(candidate.eta) ) continue;
+               leading.pt[leading.n++] = candidate.pt;
+               if ( leading.n == 2 ) break;
+            }
+         }
+      };
+
+   private:
+      Rates rates() const
+      {
+         Rates r;
+         r.single = BinnedCounts(config_.nHistBins, config_.histLow, config_.histHigh);
+         r.doubleObject = BinnedCounts(config_.nHistBins, config_.histLow, config_.histHigh);
+         r.doubleGrid = grid();
+         return r;
+      };
+
+      BinnedCounts grid() const
+      {
+         return BinnedCounts(config_.nHistBins, config_.histLow, config_.histHigh, config_.nHistBins, config_.histLow, config_.histHigh);
+      };
+
+      Efficiency efficiency() const
+      {
+         Efficiency e;
+         e.pt = BinnedCounts(config_.nHistBins, config_.histLow, config_.histHigh);
+         e.eta = BinnedCounts(config_.nHistEtaBins, config_.histetaLow, config_.histetaHigh);
+         return e;
+      };
+
+      void rates(const FlatEvent& event, Worker& worker) const
+      {
+         Accumulators& a = worker.accumulators;
+         EventRates& r = worker.eventRates;
+         rates(event, worker.scratch, r);
+         fill(a.crystal, r.crystal);
+         fill(a.trackMatched, r.trackMatched);
+         if ( r.trackMatchedPlusEG ) a.trackMatchedPlusEG.fill(r.trackMatched.pt[0], r.trackMatchedPlusEGOtherPt);
+         for(size_t alg=0; alg<r.eg.size() && alg<a.eg.size(); ++alg) fill(a.eg[alg], r.eg[alg]);
+      };
+
+      static void fill(Rates& r, const Leading& leading)
+      {
+         if ( leading.n > 0 ) r.single.fill(leading.pt[0]);
+         if ( leading.n > 1 )
+         {
+            r.doubleObject.fill(leading.pt[1]);
+            r.doubleGrid.fill(leading.pt[0], leading.pt[1]);
+         }
+      };
+
+      // False if the event has no truth particle in acceptance
+      bool efficiency(const FlatEvent& event, Worker& worker) const
+      {
+         Accumulators& a = worker.accumulators;
+         auto& denominators = worker.denominators;
+         denominators.clear();
+         for(const auto& truth : event.truth)
+            if ( inAcceptance(truth.eta) ) denominators.push_back(truth);
+         if ( denominators.empty() ) return false;
+
+         worker.trueEtaPhi.clear();
+         for(const auto& d : denominators)
+         {
+            worker.trueEtaPhi.push_back(d.eta, d.phi);
+            a.denominator.pt.fill(d.pt);
+            a.denominator.eta.fill(d.eta);
+         }
+
+         // One-to-one assignment of the clusters, then of each algorithm's candidates
+         worker.matchEtaPhi.clear();
+         for(const auto& f : event.clusters) worker.matchEtaPhi.push_back(f.eta, f.phi);
+         const auto& clusterAssignment = worker.oneToOne.match(worker.trueEtaPhi, worker.matchEtaPhi, config_.genMatchDeltaRcut, [&](unsigned t, unsigned c) {
+            return std::fabs(event.clusters[c].pt-denominators[t].pt)/denominators[t].pt < config_.genMatchRelPtcut;
+         });
+         for(size_t t=0; t<denominators.size(); ++t)
+         {
+            if ( clusterAssignment[t] < 0 || !passesCuts(event, event.clusters[clusterAssignment[t]]) ) continue;
+            a.crystalEfficiency.pt.fill(denominators[t].pt);
+            a.crystalEfficiency.eta.fill(denominators[t].eta);
+         }
+
+         for(size_t alg=0; alg<event.eg.size() && alg<a.egEfficiency.size(); ++alg)
+         {
+            const auto& candidates = event.eg[alg];
+            worker.matchEtaPhi.clear();
+            for(const auto& c : candidates) worker.matchEtaPhi.push_back(c.eta, c.phi);
+            const auto& assignment = worker.oneToOne.match(worker.trueEtaPhi, worker.matchEtaPhi, config_.genMatchDeltaRcut, [&](unsigned t, unsigned c) {
+               return std::fabs(candidates[c].pt-denominators[t].pt)/denominators[t].pt < config_.genMatchRelPtcut;
+            });
+            for(size_t t=0; t<denominators.size(); ++t)
+            {
+               if ( assignment[t] < 0 ) continue;
+               a.egEfficiency[alg].pt.fill(denominators[t].pt);
+               a.egEfficiency[alg].eta.fill(denominators[t].eta);
+            }
+         }
+         return true;
+      };
+
+      Config config_;
+};
+
+} // namespace l1eg
+
+#endif
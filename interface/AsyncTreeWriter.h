@@ -0,0 +1,134 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_AsyncTreeWriter_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_AsyncTreeWriter_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::AsyncTreeWriter AsyncTreeWriter.h SLHCUpgradeSimulations/L1EGRateStudies/interface/AsyncTreeWriter.h
+
+ Description: Fills a TTree from a dedicated thread, so basket compression is off the event loop
+
+ Implementation:
+     The tree's branches point into buffer(), a Record owned by the writer.
+     fill() copies the caller's record into a single-producer
+     single-consumer ring (SpscRing.h) and returns; the ring's thread copies
+     each record into buffer() and calls TTree::Fill, in push order, so the
+     tree is the same entry for entry as with synchronous filling.  Ring
+     slots are copies of the prototype given to book(), so records with
+     vector members of fixed size are copied without allocating.  When the ring is
+     full fill() waits for the writer (counted in stalls()), nothing is
+     dropped.  sync() returns once every pushed record is in the tree, and
+     must be called before anything else reads or writes the tree (e.g. a
+     checkpoint); close() syncs and stops the thread.  Without open(), or
+     with async false, fill() fills the tree directly.  The optional
+     beforeFill hook runs right before each TTree::Fill, on the thread that
+     fills (e.g. PackedColumns::pack on buffer()).
+     ROOT does not support concurrent writes to one TFile, and under ROOT 5
+     gDirectory is shared by all threads: while the writer is open, no
+     other thread may fill a tree in, or create objects through, the file
+     that holds the tree (e.g. another TTree booked by TFileService, or
+     TFileService::make in the event loop).  It is off in the shipped cfgs.
+*/
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "RVersion.h"
+#include "TTree.h"
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+#include "TROOT.h"
+#else
+#include "TThread.h"
+#endif
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/SpscRing.h"
+
+namespace l1eg {
+
+template<typename Record>
+class AsyncTreeWriter
+{
+   public:
+      AsyncTreeWriter() {};
+      ~AsyncTreeWriter() { close(); };
+
+      AsyncTreeWriter(const AsyncTreeWriter&) = delete;
+      AsyncTreeWriter& operator=(const AsyncTreeWriter&) = delete;
+
+      // prototype fixes the size of any vector members; book the branches on buffer() afterwards
+      void book(TTree * tree, const Record& prototype, std::function<void()> beforeFill = nullptr)
+      {
+         tree_ = tree;
+         beforeFill_ = beforeFill;
+         buffer_ = prototype;
+         prototype_ = prototype;
+      };
+
+      Record& buffer() { return buffer_; };
+
+      // capacity: records in flight, rounded up to a power of 2
+      void open(size_t capacity, bool async)
+      {
+         if ( !async || tree_ == nullptr || ring_.started() ) return;
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+         ROOT::EnableThreadSafety();
+#else
+         TThread::Initialize();
+#endif
+         // Spin briefly for the next record, sleep when the producer is quiet
+         ring_.start(capacity, prototype_, [this](const Record& record) { write(record); }, 64, std::chrono::microseconds(200));
+      };
+
+      inline void fill(const Record& record)
+      {
+         if ( !ring_.started() )
+         {
+            write(record);
+            return;
+         }
+         Record * slot = ring_.claim();
+         if ( slot == nullptr )
+         {
+            stalls_++;
+            while ( (slot = ring_.claim()) == nullptr ) std::this_thread::yield();
+         }
+         *slot = record;
+         ring_.publish();
+      };
+
+      // Returns once the tree holds every record passed to fill()
+      void sync() { ring_.sync(); };
+
+      void close() { ring_.stop(); };
+
+      uint64_t filled() const { return filled_; };
+      // Calls to fill() that had to wait for the writer
+      uint64_t stalls() const { return stalls_; };
+
+   private:
+      void write(const Record& record)
+      {
+         buffer_ = record;
+         if ( beforeFill_ ) beforeFill_();
+         tree_->Fill();
+         filled_++;
+      };
+
+      TTree * tree_ = nullptr;
+      Record buffer_;
+      Record prototype_;
+      std::function<void()> beforeFill_;
+
+      std::atomic<uint64_t> filled_{0};
+      uint64_t stalls_ = 0;
+
+      SpscRing<Record> ring_;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_Checkpoint_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_Checkpoint_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::Checkpoint Checkpoint.h SLHCUpgradeSimulations/L1EGRateStudies/interface/Checkpoint.h
+
+ Description: Periodic snapshot of an analyzer's accumulators, to resume preempted jobs
+
+ Implementation:
+     Every N events, all histograms in the module's TFileService directory,
+     the registered counters and other state are written to a local ROOT
+     file (to a temporary name, then renamed, so a preemption during the
+     write leaves the previous snapshot intact).  Trees and the ids of the
+     processed events only grow, so each snapshot writes just the entries
+     and ids added since the previous one, to a new segment file next to it
+     (name_seg1.root, name_seg2.root, ...), before the main file, which
+     records how many segments it covers; the I/O per snapshot does not
+     grow with the job.  The main file also holds a fingerprint of the
+     configuration (see setFingerprint()), and a snapshot with a different
+     one (another input list, other module parameters) is ignored and then
+     overwritten.  On restart, restore() adds the saved histograms to the
+     freshly booked ones, copies the saved tree entries, and done() reports
+     which events are already included so the analyzer can skip them.
+     Events processed after the last snapshot are simply processed again.
+     Only the top level of the directory is saved.
+*/
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "TDirectory.h"
+#include "TFile.h"
+#include "TH1.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TNamed.h"
+#include "TParameter.h"
+#include "TTree.h"
+
+namespace l1eg {
+
+class Checkpoint
+{
+   public:
+      // An empty fileName disables checkpointing
+      Checkpoint(const std::string& fileName, unsigned everyNEvents) :
+         fileName_(fileName),
+         everyNEvents_(everyNEvents)
+      {};
+
+      bool active() const { return !fileName_.empty(); };
+
+      // Description of everything the accumulated state depends on (module parameters,
+      // input files, ...), only a snapshot taken with the same description is restored
+      void setFingerprint(const std::string& description)
+      {
+         // FNV-1a, stable across builds and platforms
+         uint64_t hash = 0xcbf29ce484222325ull;
+         for(unsigned char c : description) hash = (hash ^ c) * 0x100000001b3ull;
+         char text[17];
+         snprintf(text, sizeof(text), "%016llx", (unsigned long long) hash);
+         fingerprint_ = text;
+      };
+
+      // Counters are saved and restored along with the histograms
+      void addCounter(const std::string& name, int * counter) { counters_.push_back(std::make_pair(name, counter)); };
+
+      // Other state (e.g. QuantileSketchSet): save writes it to the top level of the
+      // checkpoint file, restore merges it back from there
+      void addState(std::function<void(TDirectory *)> save, std::function<void(TDirectory *)> restore)
+      {
+         states_.push_back(std::make_pair(save, restore));
+      };
+
+      // Merges a previous snapshot, if there is one, into the objects of dir,
+      // which must already be booked.  Returns the number of events restored
+      size_t restore(TDirectory * dir)
+      {
+         if ( !active() ) return 0;
+         TFile * in = TFile::Open(fileName_.c_str(), "READ");
+         if ( in == nullptr || in->IsZombie() )
+         {
+            delete in;
+            return 0;
+         }
+         TNamed * fingerprint = dynamic_cast<TNamed *>(in->Get("checkpoint_fingerprint"));
+         auto * segments = dynamic_cast<TParameter<Int_t> *>(in->Get("checkpoint_segments"));
+         if ( fingerprint == nullptr || segments == nullptr || fingerprint_ != fingerprint->GetTitle() )
+         {
+            std::cout << "Checkpoint " << fileName_ << ": taken with a different configuration or input, ignored" << std::endl;
+            in->Close();
+            delete in;
+            return 0;
+         }
+
+         // Segments beyond the count of the main file are left over from an interrupted
+         // snapshot (or an older job) and are overwritten by the next ones
+         const int nSegments = segments->GetVal();
+         std::vector<TFile *> parts;
+         for(int segment=1; segment<=nSegments; ++segment)
+         {
+            parts.push_back(TFile::Open(segmentName(segment).c_str(), "READ"));
+            if ( parts.back() == nullptr || parts.back()->IsZombie() )
+            {
+               // Nothing restored is consistent without all segments, start over
+               std::cout << "Checkpoint " << fileName_ << ": segment " << segment << " is missing, ignored" << std::endl;
+               for(TFile * part : parts) delete part;
+               in->Close();
+               delete in;
+               return 0;
+            }
+         }
+
+         TIter next(in->GetListOfKeys());
+         while ( TKey * key = static_cast<TKey *>(next()) )
+         {
+            TObject * target = dir->Get(key->GetName());
+            if ( target != nullptr && target->InheritsFrom(TH1::Class()) )
+               static_cast<TH1 *>(target)->Add(static_cast<TH1 *>(key->ReadObj()));
+         }
+         for(auto& counter : counters_)
+         {
+            auto * saved = dynamic_cast<TParameter<Long64_t> *>(in->Get(("checkpoint_"+counter.first).c_str()));
+            if ( saved != nullptr ) *counter.second = saved->GetVal();
+         }
+         for(auto& state : states_) state.second(in);
+         in->Close();
+         delete in;
+
+         for(TFile * part : parts)
+         {
+            TIter nextKey(part->GetListOfKeys());
+            while ( TKey * key = static_cast<TKey *>(nextKey()) )
+            {
+               // Only the latest cycle, a large tree may have been autosaved on the way
+               if ( key->GetCycle() != part->GetKey(key->GetName())->GetCycle() ) continue;
+               TObject * target = dir->Get(key->GetName());
+               if ( target != nullptr && target->InheritsFrom(TTree::Class()) )
+                  static_cast<TTree *>(target)->CopyEntries(static_cast<TTree *>(key->ReadObj()));
+            }
+            TTree * events = dynamic_cast<TTree *>(part->Get("checkpoint_events"));
+            if ( events != nullptr )
+            {
+               EventId id;
+               events->SetBranchAddress("run", &id.run);
+               events->SetBranchAddress("lumi", &id.lumi);
+               events->SetBranchAddress("event", &id.event);
+               for(Long64_t i=0; i<events->GetEntries(); ++i)
+               {
+                  events->GetEntry(i);
+                  processed_.push_back(id);
+                  done_.insert(id);
+               }
+            }
+            part->Close();
+            delete part;
+         }
+
+         // The next snapshot continues after what is restored
+         segments_ = nSegments;
+         savedEvents_ = processed_.size();
+         TIter nextObject(dir->GetList());
+         while ( TObject * obj = nextObject() )
+            if ( obj->InheritsFrom(TTree::Class()) ) savedEntries_[obj->GetName()] = static_cast<TTree *>(obj)->GetEntries();
+
+         std::cout << "Checkpoint " << fileName_ << ": restored " << processed_.size() << " events from " << nSegments << " segments";
+         if ( !processed_.empty() )
+            std::cout << ", last run " << processed_.back().run << " lumi " << processed_.back().lumi << " event " << processed_.back().event;
+         std::cout << std::endl;
+         return processed_.size();
+      };
+
+      // True if the event is already included in the restored state
+      bool done(uint32_t run, uint32_t lumi, uint64_t event) const
+      {
+         return !done_.empty() && done_.count(EventId{run, lumi, event}) > 0;
+      };
+
+      // True if the next eventDone() writes a snapshot
+      bool saveDue() const { return active() && everyNEvents_ > 0 && sinceLastSave_+1 >= everyNEvents_; };
+
+      // Call after each event is fully accumulated, snapshots every N events
+      void eventDone(TDirectory * dir, uint32_t run, uint32_t lumi, uint64_t event)
+      {
+         if ( !active() ) return;
+         processed_.push_back(EventId{run, lumi, event});
+         if ( everyNEvents_ > 0 && ++sinceLastSave_ >= everyNEvents_ ) save(dir);
+      };
+
+      void save(TDirectory * dir)
+      {
+         if ( !active() ) return;
+         TDirectory::TContext restoreDirectory(dir);
+
+         // New tree entries and event ids since the previous snapshot
+         const int segment = segments_+1;
+         if ( !writeAtomically(segmentName(segment), [this, dir](TFile& out) {
+            TIter next(dir->GetList());
+            while ( TObject * obj = next() )
+            {
+               if ( !obj->InheritsFrom(TTree::Class()) ) continue;
+               // The tree's baskets live in the TFileService file, copy the entries themselves
+               TTree * tree = static_cast<TTree *>(obj);
+               const Long64_t saved = savedEntries_[tree->GetName()];
+               out.cd();
+               TTree * copy = tree->CloneTree(0);
+               for(Long64_t i=saved; i<tree->GetEntries(); ++i)
+               {
+                  tree->GetEntry(i);
+                  copy->Fill();
+               }
+               copy->Write(tree->GetName());
+               delete copy;
+            }
+
+            // Owned by the output file, deleted by Close()
+            out.cd();
+            TTree * events = new TTree("checkpoint_events", "Events included in this segment");
+            EventId id;
+            events->Branch("run", &id.run);
+            events->Branch("lumi", &id.lumi);
+            events->Branch("event", &id.event);
+            for(size_t i=savedEvents_; i<processed_.size(); ++i)
+            {
+               id = processed_[i];
+               events->Fill();
+            }
+            events->Write();
+         }) ) return;
+
+         if ( !writeAtomically(fileName_, [this, dir, segment](TFile& out) {
+            TIter next(dir->GetList());
+            while ( TObject * obj = next() )
+               if ( obj->InheritsFrom(TH1::Class()) ) out.WriteTObject(obj, obj->GetName());
+            for(auto& counter : counters_)
+            {
+               TParameter<Long64_t> saved(("checkpoint_"+counter.first).c_str(), *counter.second);
+               out.WriteTObject(&saved);
+            }
+            for(auto& state : states_) state.first(&out);
+            TNamed fingerprint("checkpoint_fingerprint", fingerprint_.c_str());
+            out.WriteTObject(&fingerprint);
+            TParameter<Int_t> segments("checkpoint_segments", segment);
+            out.WriteTObject(&segments);
+         }) ) return;
+
+         // Only now is the segment part of the snapshot
+         segments_ = segment;
+         savedEvents_ = processed_.size();
+         TIter next(dir->GetList());
+         while ( TObject * obj = next() )
+            if ( obj->InheritsFrom(TTree::Class()) ) savedEntries_[obj->GetName()] = static_cast<TTree *>(obj)->GetEntries();
+         sinceLastSave_ = 0;
+      };
+
+      // Call at the end of a successful job, the output file is then complete
+      void remove()
+      {
+         if ( !active() ) return;
+         std::remove(fileName_.c_str());
+         // Including segments left over from interrupted snapshots
+         for(int segment=1; std::remove(segmentName(segment).c_str()) == 0 || segment < segments_; ++segment) {}
+      };
+
+   private:
+      struct EventId {
+         UInt_t run;
+         UInt_t lumi;
+         ULong64_t event;
+         bool operator==(const EventId& other) const { return run == other.run && lumi == other.lumi && event == other.event; };
+      };
+      struct EventIdHash {
+         size_t operator()(const EventId& id) const { return std::hash<uint64_t>()(id.event ^ (uint64_t(id.run) << 32) ^ id.lumi); };
+      };
+
+      std::string segmentName(int segment) const
+      {
+         const std::string suffix = "_seg"+std::to_string(segment);
+         const size_t n = fileName_.size();
+         if ( n > 5 && fileName_.compare(n-5, 5, ".root") == 0 ) return fileName_.substr(0, n-5)+suffix+".root";
+         return fileName_+suffix;
+      };
+
+      // Writes a file through a temporary name, false if it could not be written
+      bool writeAtomically(const std::string& name, std::function<void(TFile&)> write)
+      {
+         const std::string tmpName = name + ".tmp";
+         TFile out(tmpName.c_str(), "RECREATE");
+         if ( out.IsZombie() ) return false;
+         write(out);
+         out.Close();
+         return std::rename(tmpName.c_str(), name.c_str()) == 0;
+      };
+
+      std::string fileName_;
+      unsigned everyNEvents_;
+      std::string fingerprint_;
+      unsigned sinceLastSave_ = 0;
+      // Segments, event ids and entries per tree covered by the last snapshot
+      int segments_ = 0;
+      size_t savedEvents_ = 0;
+      std::map<std::string, Long64_t> savedEntries_;
+      std::vector<std::pair<std::string, int *>> counters_;
+      std::vector<std::pair<std::function<void(TDirectory *)>, std::function<void(TDirectory *)>>> states_;
+      std::vector<EventId> processed_;
+      std::unordered_set<EventId, EventIdHash> done_;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_ClusterFeatureExtractor_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_ClusterFeatureExtractor_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::ClusterFeatureExtractor ClusterFeatureExtractor.h SLHCUpgradeSimulations/L1EGRateStudies/interface/ClusterFeatureExtractor.h
+
+ Description: Fills ClusterFeatures records from L1EGCrystalCluster
+
+ Implementation:
+     The experimental param key strings are built once per job, but the
+     cluster keeps its params in a string-keyed map and has no other
+     accessor: extract() still makes one GetExperimentalParam() map
+     lookup per param, nine per cluster, once per event in the context
+     producer.  Downstream code reads the record's params by enum.  Kept
+     apart from ClusterFeatures.h, which has no dependency on the cluster
+     data format.
+*/
+//
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "SimDataFormats/SLHC/interface/L1EGCrystalCluster.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ClusterFeatures.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/CrystalHitStore.h"
+
+namespace l1eg {
+
+class ClusterFeatureExtractor
+{
+   public:
+      // The experimental param keys, in ClusterFeatures::Param order
+      ClusterFeatureExtractor() :
+         keys_{{"uncorrectedPt", "uncorrectedE", "crystalCount", "upperSideLobePt", "lowerSideLobePt",
+                "phiStripContiguous0", "phiStripOneHole0", "phiStripContiguous3p", "phiStripOneHole3p"}}
+      {};
+
+      const std::string& key(ClusterFeatures::Param p) const { return keys_[p]; };
+
+      ClusterFeatures extract(const l1slhc::L1EGCrystalCluster& cluster) const
+      {
+         ClusterFeatures f;
+         f.pt = cluster.pt();
+         f.eta = cluster.eta();
+         f.phi = cluster.phi();
+         f.energy = cluster.energy();
+         f.hovere = cluster.hovere();
+         f.iso = cluster.isolation();
+         f.bremStrength = cluster.bremStrength();
+         f.seedIndex = crystal::index(cluster.seedCrystal());
+         for(size_t i=0; i<f.crystalPt.size(); ++i) f.crystalPt[i] = cluster.GetCrystalPt(i);
+         for(size_t p=0; p<keys_.size(); ++p) f.params[p] = cluster.GetExperimentalParam(keys_[p]);
+         if ( ClusterFeatures::passesRateStudiesCuts(f) ) f.passBits |= 1u << ClusterFeatures::kRateStudies;
+         if ( ClusterFeatures::passesHeatMapCuts(f) ) f.passBits |= 1u << ClusterFeatures::kHeatMap;
+         return f;
+      };
+
+      // One record per cluster, same order as the collection
+      void extract(const l1slhc::L1EGCrystalClusterCollection& clusters, std::vector<ClusterFeatures>& out) const
+      {
+         out.clear();
+         out.reserve(clusters.size());
+         for(const auto& cluster : clusters) out.push_back(extract(cluster));
+      };
+
+   private:
+      std::array<std::string, ClusterFeatures::kNParams> keys_;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_ClusterFeatures_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_ClusterFeatures_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\file ClusterFeatures.h SLHCUpgradeSimulations/L1EGRateStudies/interface/ClusterFeatures.h
+
+ Description: Flat per-cluster feature record, with the cut decisions of every working point
+
+ Implementation:
+     Everything the analyzers read from a L1EGCrystalCluster (kinematics,
+     crystal pts, the string-keyed experimental params) is copied once per
+     event into a ClusterFeatures record (see ClusterFeatureExtractor.h),
+     and the record is addressed by the Param enum.  Cuts are evaluated
+     once at extraction time and kept as one bit per WorkingPoint.  This
+     header does not depend on the framework, so the standalone analysis
+     core (AnalysisCore.h) uses the same records and cuts.
+*/
+//
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace l1eg {
+
+class ClusterFeatures
+{
+   public:
+      // Experimental params of L1EGCrystalCluster, see ClusterFeatureExtractor for the keys
+      enum Param {
+         kUncorrectedPt,
+         kUncorrectedE,
+         kCrystalCount,
+         kUpperSideLobePt,
+         kLowerSideLobePt,
+         kPhiStripContiguous0,
+         kPhiStripOneHole0,
+         kPhiStripContiguous3p,
+         kPhiStripOneHole3p,
+         kNParams
+      };
+
+      // Cut sets, kRateStudies is the L1EGRateStudies selection (separate barrel and endcap cuts),
+      // kHeatMap the tighter barrel selection used to pick fakes in L1EGCrystalsHeatMap
+      enum WorkingPoint {
+         kRateStudies,
+         kHeatMap,
+         kNWorkingPoints
+      };
+
+      float pt = 0.;
+      float eta = 0.;
+      float phi = 0.;
+      float energy = 0.;
+      float hovere = 0.;
+      float iso = 0.;
+      float bremStrength = 0.;
+      // Seed crystal, as a unified barrel + endcap index (see crystal::index in CrystalHitStore.h), -1 if unknown
+      int seedIndex = -1;
+      std::array<float, 6> crystalPt;
+      std::array<float, kNParams> params;
+      uint32_t passBits = 0;
+      // Same bits from the fixed-point emulation of the cuts, see FixedPointCuts.h
+      uint32_t emulatedPassBits = 0;
+
+      inline float param(Param p) const{return params[p];};
+      inline bool passes(WorkingPoint wp) const{return passBits & (1u << wp);};
+      inline bool passesEmulated(WorkingPoint wp) const{return emulatedPassBits & (1u << wp);};
+      inline bool isEndcap() const{return std::fabs(eta) > 1.479;};
+      // Shower shape: 5th crystal over the two leading crystals
+      inline float ptRatio() const{return crystalPt[4]/(crystalPt[0]+crystalPt[1]);};
+
+      // Upper cut values as a function of the cluster pt, shared with the fixed-point LUTs
+      struct Thresholds {
+         double hovere;
+         double iso;
+         double ptRatio;
+      };
+
+      static Thresholds rateStudiesThresholds(float cut_pt, bool endcap)
+      {
+         if ( endcap )
+            return Thresholds{22./cut_pt, 64./cut_pt+0.1, (cut_pt < 40) ? 0.18*(1-cut_pt/70.):0.18*3/7.};
+         return Thresholds{14./cut_pt+0.05, 40./cut_pt+0.1, (cut_pt < 30) ? 0.18*(1-cut_pt/100.):0.18*0.7};
+      };
+
+      static Thresholds heatMapThresholds(float pt)
+      {
+         return Thresholds{14./pt+0.05, 40./pt+0.1, (pt < 20) ? 0.08:0.08*(1+(pt-20)/25.)};
+      };
+      // Above this pt the heat map selection also requires a non-zero 5th crystal
+      static constexpr float kHeatMapShapeMinPt = 10.;
+
+      static bool passesRateStudiesCuts(const ClusterFeatures& f)
+      {
+         const Thresholds t = rateStudiesThresholds(f.param(kUncorrectedPt), f.isEndcap());
+         return f.hovere < t.hovere
+                && f.iso < t.iso
+                && f.ptRatio() < t.ptRatio;
+      };
+
+      static bool passesHeatMapCuts(const ClusterFeatures& f)
+      {
+         const Thresholds t = heatMapThresholds(f.pt);
+         return f.hovere < t.hovere
+                && f.iso < t.iso
+                && f.ptRatio() < t.ptRatio
+                && ((f.pt > kHeatMapShapeMinPt) ? (f.ptRatio() > 0.):true);
+      };
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_CrystalHitStore_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_CrystalHitStore_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\file CrystalHitStore.h SLHCUpgradeSimulations/L1EGRateStudies/interface/CrystalHitStore.h
+
+ Description: Dense, index-based store of barrel and endcap ECAL hits
+
+ Implementation:
+     Barrel and endcap crystals share one index: the EB hash, followed by
+     the EE hash offset by the number of barrel crystals.  Window queries
+     walk the (ieta, iphi) or (ix, iy) neighbourhood directly, so their
+     cost grows with the window size and only logarithmically with the
+     number of hits.  In the endcap the neighbourhood
+     comes from a precomputed (zside, ix, iy) -> index grid.
+     A store is self-contained: its hits are sorted by crystal index, and
+     lookups are binary searches over a parallel index vector (in the
+     barrel, within the hits of one ieta row), so an event product stays
+     valid for as long as it is kept.  Stores are made by a
+     CrystalHitStoreBuilder, which keeps the first hit of each crystal with
+     a dense slot table over every crystal (about 300 kB).  The producer
+     keeps one builder, and the table is reused across events by clearing
+     only the slots the previous event filled.
+*/
+//
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "DataFormats/DetId/interface/DetId.h"
+#include "DataFormats/EcalDetId/interface/EBDetId.h"
+#include "DataFormats/EcalDetId/interface/EEDetId.h"
+#include "DataFormats/EcalDetId/interface/EcalSubdetector.h"
+#include "DataFormats/GeometryVector/interface/GlobalPoint.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/EBTriggerTowerMap.h"
+
+namespace l1eg {
+namespace ee {
+
+   constexpr int kCrystals = EEDetId::kSizeForDenseIndexing;
+   constexpr int kMaxIX = 100;
+   constexpr int kMaxIY = 100;
+
+   // (zside, ix, iy) -> unified crystal index and back, -1 where there is no crystal.
+   // Built on first use from EEDetId::unhashIndex(), the endcap layout has no closed
+   // form to evaluate at compile time (see EBTriggerTowerMap.h for the barrel)
+   struct CrystalTables {
+      std::array<int32_t, 2*kMaxIX*kMaxIY> grid;
+      std::array<int8_t, kCrystals> ix;
+      std::array<int8_t, kCrystals> iy;
+      std::array<int8_t, kCrystals> zside;
+
+      static int gridIndex(int z, int x, int y) { return ((z > 0) ? kMaxIX*kMaxIY : 0) + (x-1)*kMaxIY + y-1; };
+
+      CrystalTables()
+      {
+         grid.fill(-1);
+         for(int hash=0; hash<kCrystals; ++hash)
+         {
+            EEDetId id = EEDetId::unhashIndex(hash);
+            ix[hash] = id.ix();
+            iy[hash] = id.iy();
+            zside[hash] = id.zside();
+            grid[gridIndex(id.zside(), id.ix(), id.iy())] = eb::kCrystals + hash;
+         }
+      };
+   };
+
+   inline const CrystalTables& tables()
+   {
+      static const CrystalTables t;
+      return t;
+   };
+
+} // namespace ee
+
+namespace crystal {
+
+   constexpr int kCount = eb::kCrystals + ee::kCrystals;
+
+   inline bool isBarrel(int index) { return index >= 0 && index < eb::kCrystals; };
+   inline bool isEndcap(int index) { return index >= eb::kCrystals && index < kCount; };
+
+   // Unified barrel + endcap crystal index, -1 for anything else
+   inline int index(const DetId& id)
+   {
+      if ( id.det() != DetId::Ecal ) return -1;
+      if ( id.subdetId() == EcalBarrel ) return EBDetId(id).hashedIndex();
+      if ( id.subdetId() == EcalEndcap ) return eb::kCrystals + EEDetId(id).hashedIndex();
+      return -1;
+   };
+
+} // namespace crystal
+
+class CaloHit
+{
+   public:
+      DetId id;
+      int index = -1; // see crystal::index(), -1 for non-ECAL hits
+      GlobalPoint position;
+      double energy = 0.;
+      inline double pt() const{return energy*sin(position.theta());};
+      inline bool isBarrel() const{return crystal::isBarrel(index);};
+      inline bool isEndcap() const{return crystal::isEndcap(index);};
+      // Barrel trigger tower, see EBTriggerTowerMap.h, -1 outside the barrel
+      inline int tower() const{return isBarrel() ? eb::tower(index) : -1;};
+};
+
+class CrystalHitStore
+{
+   public:
+      CrystalHitStore() {};
+
+      const std::vector<CaloHit>& hits() const { return hits_; };
+      bool empty() const { return hits_.empty(); };
+      size_t size() const { return hits_.size(); };
+
+      const CaloHit * at(int index) const { return at(index, 0, indices_.size()); };
+      const CaloHit * find(const DetId& id) const { return at(crystal::index(id)); };
+
+      // Calls fn(hit, di, dj) for every hit within +-range crystals of center,
+      // (di, dj) = (dieta, diphi) in the barrel and (dix, diy) in the endcap.
+      // Windows do not cross between barrel and endcap.
+      template<typename Function>
+      void forEachInWindow(const CaloHit& center, int range, Function fn) const
+      {
+         if ( center.isBarrel() )
+         {
+            const int ceta = eb::contiguousIEta(eb::ieta(center.index));
+            const int iphi0 = eb::iphi(center.index);
+            for(int di=-range; di<=range; ++di)
+            {
+               const int c = ceta + di;
+               if ( c < -eb::kMaxIEta || c >= eb::kMaxIEta ) continue;
+               const int ieta = (c >= 0) ? c+1 : c;
+               // Hits of this ieta row, the crystals of a row are contiguous in the index
+               const int rowStart = eb::hashedIndex(ieta, 1);
+               const size_t first = std::lower_bound(indices_.begin(), indices_.end(), rowStart) - indices_.begin();
+               const size_t last = std::lower_bound(indices_.begin()+first, indices_.end(), rowStart + eb::kMaxIPhi) - indices_.begin();
+               if ( first == last ) continue;
+               for(int dj=-range; dj<=range; ++dj)
+               {
+                  const int iphi = (iphi0 - 1 + dj + 2*eb::kMaxIPhi) % eb::kMaxIPhi + 1;
+                  if ( const CaloHit * hit = at(rowStart + iphi - 1, first, last) ) fn(*hit, di, eb::deltaIPhi(iphi, iphi0));
+               }
+            }
+         }
+         else if ( center.isEndcap() )
+         {
+            const auto& t = ee::tables();
+            const int hash = center.index - eb::kCrystals;
+            const int ix0 = t.ix[hash], iy0 = t.iy[hash], z = t.zside[hash];
+            for(int di=-range; di<=range; ++di)
+            {
+               const int ix = ix0 + di;
+               if ( ix < 1 || ix > ee::kMaxIX ) continue;
+               for(int dj=-range; dj<=range; ++dj)
+               {
+                  const int iy = iy0 + dj;
+                  if ( iy < 1 || iy > ee::kMaxIY ) continue;
+                  if ( const CaloHit * hit = at(t.grid[ee::CrystalTables::gridIndex(z, ix, iy)]) ) fn(*hit, di, dj);
+               }
+            }
+         }
+      };
+
+   private:
+      friend class CrystalHitStoreBuilder;
+
+      // Hit of crystal index among hits_[first, last), nullptr if there is none
+      const CaloHit * at(int index, size_t first, size_t last) const
+      {
+         const auto begin = indices_.begin();
+         const auto it = std::lower_bound(begin+first, begin+last, index);
+         return ( it != begin+last && *it == index ) ? &hits_[it-begin] : nullptr;
+      };
+
+      // Sorted by crystal index, one hit per crystal
+      std::vector<CaloHit> hits_;
+      std::vector<int32_t> indices_;
+};
+
+// Collects the hits of one event and makes them a CrystalHitStore
+class CrystalHitStoreBuilder
+{
+   public:
+      CrystalHitStoreBuilder() : slot_(crystal::kCount, -1) {};
+
+      void reserve(size_t n) { hits_.reserve(n); };
+
+      // Only the first hit of each crystal is kept
+      void add(const DetId& id, const GlobalPoint& position, double energy)
+      {
+         const int index = crystal::index(id);
+         if ( index < 0 || slot_[index] >= 0 ) return;
+         slot_[index] = hits_.size();
+         CaloHit hit;
+         hit.id = id;
+         hit.index = index;
+         hit.position = position;
+         hit.energy = energy;
+         hits_.push_back(hit);
+      };
+
+      // The hits added since the last build(), the builder is empty again afterwards
+      CrystalHitStore build()
+      {
+         for(const auto& hit : hits_) slot_[hit.index] = -1;
+         std::sort(hits_.begin(), hits_.end(), [](const CaloHit& a, const CaloHit& b) { return a.index < b.index; });
+         CrystalHitStore store;
+         store.indices_.reserve(hits_.size());
+         for(const auto& hit : hits_) store.indices_.push_back(hit.index);
+         store.hits_.swap(hits_);
+         hits_.clear();
+         return store;
+      };
+
+   private:
+      // Unified crystal index -> position in hits_, -1 if the crystal has no hit yet
+      std::vector<int32_t> slot_;
+      std::vector<CaloHit> hits_;
+};
+
+} // namespace l1eg
+
+#endif
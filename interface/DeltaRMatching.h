@@ -0,0 +1,114 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_DeltaRMatching_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_DeltaRMatching_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\file DeltaRMatching.h SLHCUpgradeSimulations/L1EGRateStudies/interface/DeltaRMatching.h
+
+ Description: Batched deltaR matching on structure-of-arrays eta/phi
+
+ Implementation:
+     Candidates are copied into contiguous eta and phi arrays once, and all
+     distances to a reference direction are computed in one loop as dR^2.
+     The loop has no sqrt, no calls and no comparisons: phi is folded with
+     two fabs, assuming both inputs are within [-pi, pi] as returned by the
+     candidates, so the compiler can vectorise it at -O2 -ftree-vectorize.  The
+     best-match and within-cone queries read the resulting dR^2 array, so
+     each distance is computed once per reference.
+*/
+//
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace l1eg {
+
+// dR^2 for phi within [-pi, pi].  |dphi| is folded into [0, pi] without
+// comparisons: for |x| in [0, 2pi], pi - |pi - |x|| = min(|x|, 2pi - |x|)
+inline float deltaR2(float eta1, float phi1, float eta2, float phi2)
+{
+   const float pi = M_PI;
+   const float deta = eta1 - eta2;
+   const float dphi = pi - std::fabs(pi - std::fabs(phi1 - phi2));
+   return deta*deta + dphi*dphi;
+}
+
+class EtaPhiArray
+{
+   public:
+      void clear() { eta_.clear(); phi_.clear(); };
+      void reserve(size_t n) { eta_.reserve(n); phi_.reserve(n); };
+      void push_back(float eta, float phi) { eta_.push_back(eta); phi_.push_back(phi); };
+
+      // Anything with eta() and phi(), in collection order
+      template<typename Collection>
+      void assign(const Collection& collection)
+      {
+         clear();
+         reserve(collection.size());
+         for(const auto& c : collection) push_back(c.eta(), c.phi());
+      };
+
+      size_t size() const { return eta_.size(); };
+      const float * eta() const { return eta_.data(); };
+      const float * phi() const { return phi_.data(); };
+
+   private:
+      std::vector<float> eta_;
+      std::vector<float> phi_;
+};
+
+class DeltaRMatcher
+{
+   public:
+      // dR^2 from (eta, phi) to every entry of the array, kept until the next call
+      const std::vector<float>& compute(const EtaPhiArray& array, float eta, float phi)
+      {
+         const size_t n = array.size();
+         dr2_.resize(n);
+         const float * __restrict__ etas = array.eta();
+         const float * __restrict__ phis = array.phi();
+         float * __restrict__ out = dr2_.data();
+         for(size_t i=0; i<n; ++i) out[i] = deltaR2(etas[i], phis[i], eta, phi);
+         return dr2_;
+      };
+
+      const std::vector<float>& dr2() const { return dr2_; };
+      float dr2(size_t i) const { return dr2_[i]; };
+      float dr(size_t i) const { return std::sqrt(dr2_[i]); };
+
+      // Index of the closest entry with dR < maxDR, -1 if none
+      int best(float maxDR = std::numeric_limits<float>::max()) const
+      {
+         int best = -1;
+         float bestDR2 = (maxDR < std::sqrt(std::numeric_limits<float>::max())) ? maxDR*maxDR : std::numeric_limits<float>::max();
+         for(size_t i=0; i<dr2_.size(); ++i)
+         {
+            if ( dr2_[i] < bestDR2 )
+            {
+               bestDR2 = dr2_[i];
+               best = i;
+            }
+         }
+         return best;
+      };
+
+      bool within(size_t i, float maxDR) const { return dr2_[i] < maxDR*maxDR; };
+
+      bool anyWithin(float maxDR) const
+      {
+         const float maxDR2 = maxDR*maxDR;
+         bool found = false;
+         for(size_t i=0; i<dr2_.size(); ++i) found |= dr2_[i] < maxDR2;
+         return found;
+      };
+
+   private:
+      std::vector<float> dr2_;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_DiagnosticLog_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_DiagnosticLog_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::DiagnosticLog DiagnosticLog.h SLHCUpgradeSimulations/L1EGRateStudies/interface/DiagnosticLog.h
+
+ Description: Asynchronous event-keyed diagnostic records, written as JSON lines
+
+ Implementation:
+     log() copies a small fixed-size record (event id, category, a short
+     message and a few numbers) into a single-producer single-consumer ring
+     (SpscRing.h) and returns; the ring's thread writes it to the output
+     file.  If the buffer is full the record is dropped and counted, so the
+     event loop never waits on I/O.  Each category can be prescaled (keep
+     every Nth record) and capped (keep at most N records per job).  When the
+     log is not opened, or a category is not enabled, log() is a single
+     inline mask test.
+*/
+//
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/SpscRing.h"
+
+namespace l1eg {
+
+class DiagnosticLog
+{
+   public:
+      static constexpr size_t kMaxValues = 6;
+      static constexpr size_t kMessageLength = 56;
+      static constexpr size_t kCapacity = 1 << 14; // records, power of 2
+
+      struct Record {
+         uint32_t run;
+         uint32_t lumi;
+         uint64_t event;
+         uint16_t category;
+         uint16_t nValues;
+         std::array<float, kMaxValues> values;
+         std::array<char, kMessageLength> message;
+      };
+
+      // Category ids are indices into categoryNames, at most 32 categories.
+      // Messages are written verbatim, so they should not contain quotes
+      explicit DiagnosticLog(const std::vector<std::string>& categoryNames) :
+         names_(categoryNames),
+         counts_(categoryNames.size(), 0),
+         kept_(categoryNames.size(), 0)
+      {};
+
+      ~DiagnosticLog() { close(); };
+
+      DiagnosticLog(const DiagnosticLog&) = delete;
+      DiagnosticLog& operator=(const DiagnosticLog&) = delete;
+
+      // enabled: category names to record, all of them if empty.
+      // prescale: keep every Nth record of each category.  maxPerCategory: 0 for no limit
+      void open(const std::string& fileName, const std::vector<std::string>& enabled, unsigned prescale, unsigned maxPerCategory)
+      {
+         if ( fileName.empty() ) return;
+         out_.open(fileName.c_str());
+         prescale_ = std::max(1u, prescale);
+         maxPerCategory_ = maxPerCategory;
+         enabledMask_ = 0;
+         for(size_t c=0; c<names_.size(); ++c)
+         {
+            if ( enabled.empty() || std::find(begin(enabled), end(enabled), names_[c]) != end(enabled) )
+               enabledMask_ |= 1u << c;
+         }
+         ring_.start(kCapacity, Record(), [this](const Record& r) { write(r); }, 0, std::chrono::milliseconds(2));
+      };
+
+      // Flushes everything still queued and stops the writer
+      void close()
+      {
+         if ( !ring_.started() ) return;
+         ring_.stop();
+         out_.close();
+         enabledMask_ = 0;
+      };
+
+      void setEvent(uint32_t run, uint32_t lumi, uint64_t event) { run_ = run; lumi_ = lumi; event_ = event; };
+
+      inline bool enabled(unsigned category) const { return enabledMask_ & (1u << category); };
+
+      inline void log(unsigned category, const char * message, std::initializer_list<float> values = {})
+      {
+         if ( enabled(category) ) push(category, message, values);
+      };
+
+      uint64_t written() const { return written_; };
+      uint64_t dropped() const { return dropped_; };
+
+   private:
+      void push(unsigned category, const char * message, std::initializer_list<float> values)
+      {
+         if ( counts_[category]++ % prescale_ != 0 ) return;
+         if ( maxPerCategory_ > 0 && kept_[category] >= maxPerCategory_ ) return;
+         kept_[category]++;
+
+         Record * slot = ring_.claim();
+         if ( slot == nullptr )
+         {
+            dropped_++;
+            return;
+         }
+         Record& r = *slot;
+         r.run = run_;
+         r.lumi = lumi_;
+         r.event = event_;
+         r.category = category;
+         r.nValues = (values.size() < kMaxValues) ? values.size() : kMaxValues;
+         std::copy_n(values.begin(), r.nValues, r.values.begin());
+         strncpy(r.message.data(), message, kMessageLength-1);
+         r.message[kMessageLength-1] = '\0';
+         ring_.publish();
+      };
+
+      void write(const Record& r)
+      {
+         out_ << "{\"run\":" << r.run << ",\"lumi\":" << r.lumi << ",\"event\":" << r.event
+              << ",\"category\":\"" << names_[r.category] << "\",\"message\":\"" << r.message.data() << "\",\"values\":[";
+         for(size_t i=0; i<r.nValues; ++i) out_ << ((i > 0) ? "," : "") << r.values[i];
+         out_ << "]}\n";
+         written_++;
+      };
+
+      std::vector<std::string> names_;
+      std::vector<uint64_t> counts_;
+      std::vector<uint64_t> kept_;
+      uint32_t enabledMask_ = 0;
+      unsigned prescale_ = 1;
+      unsigned maxPerCategory_ = 0;
+
+      uint32_t run_ = 0;
+      uint32_t lumi_ = 0;
+      uint64_t event_ = 0;
+
+      std::atomic<uint64_t> written_{0};
+      uint64_t dropped_ = 0;
+
+      std::ofstream out_;
+      SpscRing<Record> ring_;
+};
+
+} // namespace l1eg
+
+#endif
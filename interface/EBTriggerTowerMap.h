@@ -0,0 +1,101 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_EBTriggerTowerMap_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_EBTriggerTowerMap_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\file EBTriggerTowerMap.h SLHCUpgradeSimulations/L1EGRateStudies/interface/EBTriggerTowerMap.h
+
+ Description: Geometry-free barrel crystal <-> trigger tower mapping
+
+ Implementation:
+     The barrel crystal numbering and the crystal -> trigger tower
+     assignment are fixed by construction, so everything EBDetId and
+     EcalTrigTowerDetId compute for us can be written as constexpr
+     arithmetic on the dense crystal hash (EBDetId::hashedIndex()).
+     The functions are checked against EBDetId reference values at
+     compile time (static_assert below) and for every crystal by
+     test/testEBTriggerTowerMap.cpp.  The per-crystal tables are not
+     constexpr: C++11 (gcc 4.7/4.8) has neither loops in constexpr
+     functions nor std::index_sequence, and recursive template expansion
+     does not reach 61200 entries.  They are a function-local static
+     filled from the constexpr functions on first use, once per job, and
+     only read afterwards.
+*/
+//
+
+#include <array>
+#include <cstdint>
+
+namespace l1eg {
+namespace eb {
+
+   constexpr int kMaxIEta = 85;
+   constexpr int kMaxIPhi = 360;
+   constexpr int kCrystals = 2*kMaxIEta*kMaxIPhi;
+   constexpr int kCrystalsPerTower = 5;
+   constexpr int kMaxTowerIEta = kMaxIEta/kCrystalsPerTower;
+   constexpr int kMaxTowerIPhi = kMaxIPhi/kCrystalsPerTower;
+   constexpr int kTowers = 2*kMaxTowerIEta*kMaxTowerIPhi;
+
+   // ieta with the zero gap removed, -85..84
+   constexpr int contiguousIEta(int ieta) { return (ieta > 0) ? ieta-1 : ieta; }
+
+   // Same as EBDetId::hashedIndex()
+   constexpr int hashedIndex(int ieta, int iphi) { return (kMaxIEta + contiguousIEta(ieta))*kMaxIPhi + iphi - 1; }
+   constexpr int ietaFromHash(int hash) { return hash/kMaxIPhi - kMaxIEta + ((hash/kMaxIPhi >= kMaxIEta) ? 1 : 0); }
+   constexpr int iphiFromHash(int hash) { return hash%kMaxIPhi + 1; }
+
+   // Same as EBDetId::tower_ieta() and EBDetId::tower_iphi()
+   constexpr int towerIEta(int ieta) { return (ieta > 0) ? (ieta-1)/kCrystalsPerTower+1 : -((-ieta-1)/kCrystalsPerTower+1); }
+   constexpr int towerIPhi(int iphi) { return ((iphi-1)/kCrystalsPerTower-1 <= 0) ? (iphi-1)/kCrystalsPerTower-1+kMaxTowerIPhi : (iphi-1)/kCrystalsPerTower-1; }
+
+   // Dense barrel tower index, 0..kTowers-1, from EcalTrigTowerDetId ieta() and iphi()
+   constexpr int towerIndex(int tower_ieta, int tower_iphi) { return (kMaxTowerIEta + ((tower_ieta > 0) ? tower_ieta-1 : tower_ieta))*kMaxTowerIPhi + tower_iphi - 1; }
+   constexpr int towerIndexFromHash(int hash) { return towerIndex(towerIEta(ietaFromHash(hash)), towerIPhi(iphiFromHash(hash))); }
+
+   // Signed versions of EBDetId::distanceEta() and EBDetId::distancePhi(), a - b
+   // Phi wraps into (-180, 180] with a single branch-free correction, since |a-b| < 360
+   constexpr int deltaIEta(int ieta_a, int ieta_b) { return contiguousIEta(ieta_a) - contiguousIEta(ieta_b); }
+   constexpr int deltaIPhi(int iphi_a, int iphi_b) { return (iphi_a-iphi_b) - kMaxIPhi*((iphi_a-iphi_b > kMaxIPhi/2) - (iphi_a-iphi_b <= -kMaxIPhi/2)); }
+
+   // Reference values taken from EBDetId
+   static_assert(hashedIndex(-85, 1) == 0 && hashedIndex(85, 360) == kCrystals-1, "EB hash range");
+   static_assert(hashedIndex(1, 1) == kMaxIEta*kMaxIPhi, "EB hash skips ieta=0");
+   static_assert(ietaFromHash(hashedIndex(-1, 7)) == -1 && ietaFromHash(hashedIndex(1, 7)) == 1 && iphiFromHash(hashedIndex(1, 7)) == 7, "EB hash inverse");
+   static_assert(towerIEta(5) == 1 && towerIEta(6) == 2 && towerIEta(-85) == -17, "EB tower ieta");
+   static_assert(towerIPhi(1) == 71 && towerIPhi(11) == 1 && towerIPhi(360) == 70, "EB tower iphi");
+   static_assert(towerIndexFromHash(0) >= 0 && towerIndexFromHash(kCrystals-1) < kTowers, "EB tower index range");
+   static_assert(deltaIPhi(1, 360) == 1 && deltaIPhi(360, 1) == -1 && deltaIPhi(181, 1) == 180 && deltaIPhi(1, 181) == 180, "EB phi wrap");
+   static_assert(deltaIEta(1, -1) == 1 && deltaIEta(-1, 1) == -1 && deltaIEta(3, 1) == 2, "EB eta gap");
+
+   struct CrystalTables {
+      std::array<int16_t, kCrystals> tower;
+      std::array<int8_t, kCrystals> ieta;
+      std::array<int16_t, kCrystals> iphi;
+
+      CrystalTables()
+      {
+         for(int hash=0; hash<kCrystals; ++hash)
+         {
+            tower[hash] = towerIndexFromHash(hash);
+            ieta[hash] = ietaFromHash(hash);
+            iphi[hash] = iphiFromHash(hash);
+         }
+      };
+   };
+
+   inline const CrystalTables& tables()
+   {
+      static const CrystalTables t;
+      return t;
+   };
+
+   inline int tower(int hash) { return tables().tower[hash]; };
+   inline int ieta(int hash) { return tables().ieta[hash]; };
+   inline int iphi(int hash) { return tables().iphi[hash]; };
+
+} // namespace eb
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_EventSummary_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_EventSummary_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::EventSummary EventSummary.h SLHCUpgradeSimulations/L1EGRateStudies/interface/EventSummary.h
+
+ Description: Compact per-event record of the leading L1 EG candidates of every algorithm
+
+ Implementation:
+     One tree entry per event with, for the crystal clusters and for each
+     EG algorithm, the pt, eta and phi of the stored candidates, highest pt
+     first.  A candidate is stored if it is among the topN highest pt of
+     any selection a reader applies: all, or barrel only (|eta| < 1.479),
+     and for the crystal clusters also passing each working point, float
+     or emulated, in the barrel or anywhere.  Any of these selections then
+     sees its topN leading candidates exactly, whatever fails it in front
+     of them.  The crystal clusters also carry their
+     working point bits (ClusterFeatures::passBits, and emulatedPassBits),
+     the features the cuts are made of, and the dR to the nearest L1
+     track, so selections can be redone offline.  The truth particles at
+     the ECAL entrance, if any, are stored the same way (prefix truth).
+     No selection is applied: barrel-only, pass-cut or multi-object rules
+     are all derived from the tree, by test/summaryRates.py or by
+     bin/l1egStandalone.  Algorithm branch prefixes are the input tag with
+     anything but letters and digits replaced by '_', e.g.
+     l1extraParticlesUCT_All; the tree's user info maps each prefix back
+     to the algorithm name (TNamed) and records topN and the branch array
+     length, capacity (TParameter).
+     Selections that are not among these (a cut on the stored features,
+     the track match) only see what the others kept.
+*/
+//
+
+#include <cctype>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "TNamed.h"
+#include "TParameter.h"
+#include "TTree.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/L1EGEventContext.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/PtOrdered.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ScratchArena.h"
+
+namespace l1eg {
+
+class EventSummary
+{
+   public:
+      static std::string branchPrefix(const std::string& name)
+      {
+         std::string prefix(name);
+         for(auto& c : prefix) if ( !std::isalnum(c) ) c = '_';
+         return prefix;
+      };
+
+      // egNames: the algorithms to record, as named in the EventContext
+      void book(TTree * tree, unsigned topN, const std::vector<std::string>& egNames)
+      {
+         tree_ = tree;
+         topN_ = topN;
+         crystalCapacity_ = topN_*kCrystalSelections;
+         egCapacity_ = topN_*kEGSelections;
+         counts_.resize(kCrystalSelections);
+         tree_->Branch("run", &run_, "run/i");
+         tree_->Branch("lumi", &lumi_, "lumi/i");
+         tree_->Branch("event", &event_, "event/l");
+
+         book(crystal_, "crystal", crystalCapacity_);
+         for(auto * column : {&hovere_, &iso_, &bremStrength_, &ptRatio_, &crystalCount_}) column->resize(crystalCapacity_);
+         passBits_.resize(crystalCapacity_);
+         emulatedPassBits_.resize(crystalCapacity_);
+         trackDeltaR_.resize(crystalCapacity_);
+         tree_->Branch("crystal_passBits", passBits_.data(), "crystal_passBits[crystal_n]/i");
+         tree_->Branch("crystal_emulatedPassBits", emulatedPassBits_.data(), "crystal_emulatedPassBits[crystal_n]/i");
+         tree_->Branch("crystal_hovere", hovere_.data(), "crystal_hovere[crystal_n]/F");
+         tree_->Branch("crystal_iso", iso_.data(), "crystal_iso[crystal_n]/F");
+         tree_->Branch("crystal_bremStrength", bremStrength_.data(), "crystal_bremStrength[crystal_n]/F");
+         tree_->Branch("crystal_ptRatio", ptRatio_.data(), "crystal_ptRatio[crystal_n]/F");
+         tree_->Branch("crystal_crystalCount", crystalCount_.data(), "crystal_crystalCount[crystal_n]/F");
+         tree_->Branch("crystal_trackDeltaR", trackDeltaR_.data(), "crystal_trackDeltaR[crystal_n]/F");
+         book(truth_, "truth", topN_);
+
+         // Reserved up front, the branches keep pointers into the blocks
+         eg_.resize(egNames.size());
+         for(size_t i=0; i<egNames.size(); ++i)
+         {
+            eg_[i].name = egNames[i];
+            book(eg_[i], branchPrefix(egNames[i]), egCapacity_);
+            tree_->GetUserInfo()->Add(new TNamed(branchPrefix(egNames[i]).c_str(), egNames[i].c_str()));
+         }
+         tree_->GetUserInfo()->Add(new TParameter<Int_t>("topN", topN_));
+         // Array length of the candidate branches
+         tree_->GetUserInfo()->Add(new TParameter<Int_t>("capacity", crystalCapacity_));
+      };
+
+      // trackDeltaR(clusterIndex): dR from the cluster to the nearest L1 track, only
+      // called for the stored clusters; without it the branch holds kNoTrack
+      void fill(uint32_t run, uint32_t lumi, uint64_t event, const EventContext& context, ScratchArena& arena,
+                std::function<float(unsigned)> trackDeltaR = std::function<float(unsigned)>())
+      {
+         run_ = run;
+         lumi_ = lumi;
+         event_ = event;
+
+         crystal_.n = 0;
+         std::fill(counts_.begin(), counts_.end(), 0u);
+         unsigned open = kCrystalSelections;
+         for(unsigned i : ptOrdered(context.clusterFeatures, arena))
+         {
+            if ( open == 0 ) break;
+            const auto& f = context.clusterFeatures[i];
+            if ( !keep(selections(f), open) ) continue;
+            const int k = crystal_.n++;
+            crystal_.pt[k] = f.pt;
+            crystal_.eta[k] = f.eta;
+            crystal_.phi[k] = f.phi;
+            passBits_[k] = f.passBits;
+            emulatedPassBits_[k] = f.emulatedPassBits;
+            trackDeltaR_[k] = kNoTrack;
+            if ( trackDeltaR ) trackDeltaR_[k] = trackDeltaR(i);
+            hovere_[k] = f.hovere;
+            iso_[k] = f.iso;
+            bremStrength_[k] = f.bremStrength;
+            ptRatio_[k] = f.ptRatio();
+            crystalCount_[k] = f.param(ClusterFeatures::kCrystalCount);
+         }
+
+         // Truth in producer order, the leading particle first for single particle guns
+         truth_.n = 0;
+         for(const auto& truth : context.truth)
+         {
+            if ( truth_.n == int(topN_) ) break;
+            const auto& ecal = truth.ecal;
+            const int k = truth_.n++;
+            truth_.pt[k] = ecal.pt();
+            truth_.eta[k] = ecal.eta();
+            truth_.phi[k] = ecal.phi();
+         }
+
+         for(auto& block : eg_)
+         {
+            block.n = 0;
+            const auto * collection = context.egCollection(block.name);
+            if ( collection == nullptr ) continue;
+            std::fill(counts_.begin(), counts_.end(), 0u);
+            unsigned open = kEGSelections;
+            for(unsigned i : ptOrdered(*collection, arena))
+            {
+               if ( open == 0 ) break;
+               const auto& candidate = (*collection)[i];
+               if ( !keep(barrel(candidate.eta()) ? 3u : 1u, open) ) continue;
+               const int k = block.n++;
+               block.pt[k] = candidate.pt();
+               block.eta[k] = candidate.eta();
+               block.phi[k] = candidate.phi();
+            }
+         }
+         tree_->Fill();
+      };
+
+      static constexpr float kNoTrack = 999.;
+
+      // Selections a candidate can be stored for: all and barrel, then for the crystal
+      // clusters each working point (float, emulated) x (all, barrel)
+      static constexpr unsigned kEGSelections = 2;
+      static constexpr unsigned kCrystalSelections = kEGSelections + 4*ClusterFeatures::kNWorkingPoints;
+
+   private:
+      static bool barrel(float eta) { return std::fabs(eta) < 1.479; };
+
+      // Bit s set if f is in selection s
+      static uint32_t selections(const ClusterFeatures& f)
+      {
+         const bool inBarrel = barrel(f.eta);
+         uint32_t bits = inBarrel ? 3u : 1u;
+         for(unsigned wp=0; wp<ClusterFeatures::kNWorkingPoints; ++wp)
+         {
+            const unsigned first = kEGSelections + 4*wp;
+            if ( f.passes(ClusterFeatures::WorkingPoint(wp)) ) bits |= ( inBarrel ? 3u : 1u ) << first;
+            if ( f.passesEmulated(ClusterFeatures::WorkingPoint(wp)) ) bits |= ( inBarrel ? 3u : 1u ) << (first+2);
+         }
+         return bits;
+      };
+
+      // Counts the candidate in its selections, true if one of them had fewer than topN;
+      // open is the number of selections still below topN
+      bool keep(uint32_t bits, unsigned& open)
+      {
+         bool kept = false;
+         for(unsigned s=0; s<counts_.size(); ++s)
+         {
+            if ( !(bits & (1u << s)) || counts_[s] == topN_ ) continue;
+            kept = true;
+            if ( ++counts_[s] == topN_ ) open--;
+         }
+         return kept;
+      };
+
+      struct Block {
+         std::string name;
+         Int_t n = 0;
+         std::vector<Float_t> pt, eta, phi;
+      };
+
+      void book(Block& block, const std::string& prefix, unsigned capacity)
+      {
+         block.pt.resize(capacity);
+         block.eta.resize(capacity);
+         block.phi.resize(capacity);
+         tree_->Branch((prefix+"_n").c_str(), &block.n, (prefix+"_n/I").c_str());
+         tree_->Branch((prefix+"_pt").c_str(), block.pt.data(), (prefix+"_pt["+prefix+"_n]/F").c_str());
+         tree_->Branch((prefix+"_eta").c_str(), block.eta.data(), (prefix+"_eta["+prefix+"_n]/F").c_str());
+         tree_->Branch((prefix+"_phi").c_str(), block.phi.data(), (prefix+"_phi["+prefix+"_n]/F").c_str());
+      };
+
+      TTree * tree_ = nullptr;
+      unsigned topN_ = 0;
+      unsigned crystalCapacity_ = 0;
+      unsigned egCapacity_ = 0;
+      // Candidates stored so far per selection
+      std::vector<unsigned> counts_;
+      UInt_t run_ = 0;
+      UInt_t lumi_ = 0;
+      ULong64_t event_ = 0;
+      Block crystal_;
+      std::vector<UInt_t> passBits_, emulatedPassBits_;
+      std::vector<Float_t> hovere_, iso_, bremStrength_, ptRatio_, crystalCount_, trackDeltaR_;
+      Block truth_;
+      std::vector<Block> eg_;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_FixedPointCuts_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_FixedPointCuts_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::FixedPointCuts FixedPointCuts.h SLHCUpgradeSimulations/L1EGRateStudies/interface/FixedPointCuts.h
+
+ Description: Integer emulation of the crystal EG working points, as firmware would evaluate them
+
+ Implementation:
+     Cluster and crystal pts are quantised to ptLSB with ptBits, H/E and
+     isolation to ratioLSB with ratioBits, saturating at the top.  A
+     saturated H/E or isolation is out of range, so it fails its cut
+     whatever the threshold: cut values are capped at the largest code,
+     and only inputs below it can pass.  The default range (16 bits of
+     1/1024, up to 64) holds every H/E and isolation threshold down to a
+     cluster pt of about 1 GeV (isolation 40/pt+0.1 in the barrel,
+     64/pt+0.1 in the endcap), so only below that can a value between 64
+     and the float threshold pass the float cut and fail the emulated one.
+     The pt
+     dependent cut values of ClusterFeatures are tabulated once per job in
+     lookup tables indexed by pt bin (lutPtLSB wide, 2^lutBits entries, the
+     last bin is used above the range), evaluated at the bin centre and
+     quantised like the inputs.  The shower shape cut c4/(c0+c1) < R is
+     evaluated as (c4 << F) < R*2^F*(c0+c1), so the per-cluster decision
+     is a table lookup and a few integer compares, with no division and no
+     branch.  The tables are filled at run time from the configured LSBs,
+     which is where the firmware would load them from, rather than being
+     compile-time constants.
+*/
+//
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ClusterFeatures.h"
+
+namespace l1eg {
+
+class FixedPointCuts
+{
+   public:
+      struct Config {
+         double ptLSB = 0.25;            // GeV, cluster and crystal pt
+         unsigned ptBits = 12;
+         double ratioLSB = 1./1024;      // H/E and isolation
+         unsigned ratioBits = 16;        // range 64, see above
+         double lutPtLSB = 0.5;          // GeV, a power of 2 multiple of ptLSB
+         unsigned lutBits = 8;
+         unsigned shapeFractionBits = 10;
+      };
+
+      // Quantised inputs of one cluster
+      struct Inputs {
+         uint32_t pt;
+         uint32_t cutPt; // uncorrected pt, used by the rate study cuts
+         uint32_t hovere;
+         uint32_t iso;
+         uint32_t crystal0;
+         uint32_t crystal1;
+         uint32_t crystal4;
+         uint32_t endcap;
+      };
+
+      explicit FixedPointCuts(const Config& config) :
+         config_(config),
+         ptMax_((1u << config.ptBits) - 1),
+         ratioMax_((1u << config.ratioBits) - 1),
+         lutShift_(std::max(0, int(std::lround(std::log2(config.lutPtLSB/config.ptLSB))))),
+         lutMax_((1u << config.lutBits) - 1),
+         heatMapShapeMinPt_(std::lround(ClusterFeatures::kHeatMapShapeMinPt/config.ptLSB))
+      {
+         const unsigned n = 1u << config.lutBits;
+         const double binWidth = config.ptLSB*(1u << lutShift_);
+         for(auto& table : rateStudies_) table.resize(n);
+         heatMap_.resize(n);
+         for(unsigned i=0; i<n; ++i)
+         {
+            const float pt = (i + 0.5)*binWidth;
+            rateStudies_[0][i] = entry(ClusterFeatures::rateStudiesThresholds(pt, false));
+            rateStudies_[1][i] = entry(ClusterFeatures::rateStudiesThresholds(pt, true));
+            heatMap_[i] = entry(ClusterFeatures::heatMapThresholds(pt));
+         }
+      };
+
+      Inputs quantise(const ClusterFeatures& f) const
+      {
+         Inputs in;
+         in.pt = quantise(f.pt, config_.ptLSB, ptMax_);
+         in.cutPt = quantise(f.param(ClusterFeatures::kUncorrectedPt), config_.ptLSB, ptMax_);
+         in.hovere = quantise(f.hovere, config_.ratioLSB, ratioMax_);
+         in.iso = quantise(f.iso, config_.ratioLSB, ratioMax_);
+         in.crystal0 = quantise(f.crystalPt[0], config_.ptLSB, ptMax_);
+         in.crystal1 = quantise(f.crystalPt[1], config_.ptLSB, ptMax_);
+         in.crystal4 = quantise(f.crystalPt[4], config_.ptLSB, ptMax_);
+         in.endcap = f.isEndcap();
+         return in;
+      };
+
+      // Same bit layout as ClusterFeatures::passBits
+      uint32_t passBits(const Inputs& in) const
+      {
+         const uint64_t shape = uint64_t(in.crystal4) << config_.shapeFractionBits;
+         const uint64_t sum01 = in.crystal0 + in.crystal1;
+
+         const Entry& r = rateStudies_[in.endcap][lutIndex(in.cutPt)];
+         const uint32_t rate = (in.hovere < r.hovere) & (in.iso < r.iso) & (shape < r.ptRatio*sum01);
+
+         const Entry& h = heatMap_[lutIndex(in.pt)];
+         const uint32_t heat = (in.hovere < h.hovere) & (in.iso < h.iso) & (shape < h.ptRatio*sum01)
+                               & ((in.crystal4 > 0) | (in.pt <= heatMapShapeMinPt_));
+
+         return (rate << ClusterFeatures::kRateStudies) | (heat << ClusterFeatures::kHeatMap);
+      };
+
+      uint32_t passBits(const ClusterFeatures& f) const { return passBits(quantise(f)); };
+
+   private:
+      struct Entry {
+         uint32_t hovere;
+         uint32_t iso;
+         uint64_t ptRatio; // in units of 2^-shapeFractionBits
+      };
+
+      static uint32_t quantise(double x, double lsb, uint32_t max)
+      {
+         if ( !(x > 0.) ) return 0;
+         return uint32_t(std::min(std::floor(x/lsb), double(max)));
+      };
+
+      // value < threshold in float becomes quantised value < ceil(threshold/lsb), capped at the
+      // saturated input value max, so that saturated inputs fail
+      uint32_t threshold(double t, double lsb, uint32_t max) const
+      {
+         if ( !(t > 0.) ) return 0;
+         return uint32_t(std::min(std::ceil(t/lsb), double(max)));
+      };
+
+      Entry entry(const ClusterFeatures::Thresholds& t) const
+      {
+         Entry e;
+         e.hovere = threshold(t.hovere, config_.ratioLSB, ratioMax_);
+         e.iso = threshold(t.iso, config_.ratioLSB, ratioMax_);
+         e.ptRatio = (t.ptRatio > 0.) ? uint64_t(std::lround(std::ldexp(t.ptRatio, config_.shapeFractionBits))) : 0;
+         return e;
+      };
+
+      uint32_t lutIndex(uint32_t pt) const { return std::min(pt >> lutShift_, lutMax_); };
+
+      Config config_;
+      uint32_t ptMax_;
+      uint32_t ratioMax_;
+      unsigned lutShift_;
+      uint32_t lutMax_;
+      uint32_t heatMapShapeMinPt_;
+      std::array<std::vector<Entry>, 2> rateStudies_; // barrel, endcap
+      std::vector<Entry> heatMap_;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_HeatmapReservoir_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_HeatmapReservoir_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::HeatmapReservoir HeatmapReservoir.h SLHCUpgradeSimulations/L1EGRateStudies/interface/HeatmapReservoir.h
+
+ Description: Fixed-size uniform sample of per-cluster crystal windows, plus their running average
+
+ Implementation:
+     Candidates are split into strata by pt and brem strength bin edges
+     (values outside the edges go to the first or last bin, no edges means
+     a single bin).  Each stratum keeps at most samplesPerStratum windows,
+     chosen by reservoir sampling (Algorithm R) with the fixed-seed
+     Xorshift.h generator, so every candidate seen has the same chance of
+     being kept and reruns keep the same ones.  All window storage is allocated in the
+     constructor, memory does not grow with the number of events.
+     The caller fills window() (zeroed by beginSample()) through add(), then
+     commit()s the candidate; every committed window is also summed into
+     the stratum's aggregate.  write() stores the kept windows in the
+     heatmapReservoir tree (one entry per window, with weight = seen/kept
+     of its stratum) and the aggregates as TH2Fs scaled by 1/seen, like
+     the named heatmaps of L1EGCrystalsHeatMap.
+*/
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "TDirectory.h"
+#include "TH1.h"
+#include "TH2.h"
+#include "TTree.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/Xorshift.h"
+
+namespace l1eg {
+
+class HeatmapReservoir
+{
+   public:
+      struct Sample
+      {
+         UInt_t run = 0;
+         UInt_t lumi = 0;
+         ULong64_t event = 0;
+         Float_t pt = 0.;
+         Float_t genPt = 0.;
+         Float_t deltaR = 0.;
+         Float_t crystalCount = 0.;
+         Float_t bremStrength = 0.;
+      };
+
+      HeatmapReservoir(int range, unsigned samplesPerStratum, const std::vector<double>& ptEdges, const std::vector<double>& bremEdges) :
+         range_(range),
+         side_(2*range+1),
+         k_(samplesPerStratum),
+         ptEdges_(ptEdges),
+         bremEdges_(bremEdges),
+         nPt_(ptEdges.size() > 1 ? ptEdges.size()-1 : 1),
+         nBrem_(bremEdges.size() > 1 ? bremEdges.size()-1 : 1),
+         window_(side_*side_, 0.f),
+         samples_(nPt_*nBrem_*k_*side_*side_, 0.f),
+         meta_(nPt_*nBrem_*k_),
+         aggregates_(nPt_*nBrem_*side_*side_, 0.),
+         seen_(nPt_*nBrem_, 0)
+      {};
+
+      size_t strata() const { return nPt_*nBrem_; };
+      int stratum(float pt, float bremStrength) const { return bin(ptEdges_, pt)*nBrem_ + bin(bremEdges_, bremStrength); };
+
+      // Zeroes window() for the next candidate
+      float * beginSample()
+      {
+         std::fill(window_.begin(), window_.end(), 0.f);
+         return window_.data();
+      };
+      float * window() { return window_.data(); };
+      // (dieta, diphi) in the barrel, (dix, diy) in the endcap, as in CrystalHitStore::forEachInWindow
+      inline void add(int di, int dj, float pt) { window_[(di+range_)*side_ + (dj+range_)] += pt; };
+
+      void commit(const Sample& sample)
+      {
+         const size_t s = stratum(sample.pt, sample.bremStrength);
+         const size_t pixels = side_*side_;
+         double * aggregate = &aggregates_[s*pixels];
+         for(size_t p=0; p<pixels; ++p) aggregate[p] += window_[p];
+
+         const uint64_t n = ++seen_[s];
+         if ( k_ == 0 ) return;
+         uint64_t slot = n-1;
+         if ( n > k_ )
+         {
+            slot = random_() % n;
+            if ( slot >= k_ ) return;
+         }
+         std::copy(window_.begin(), window_.end(), samples_.begin() + (s*k_+slot)*pixels);
+         meta_[s*k_+slot] = sample;
+      };
+
+      uint64_t seen(size_t s) const { return seen_[s]; };
+      uint64_t kept(size_t s) const { return std::min<uint64_t>(seen_[s], k_); };
+      uint64_t seen() const { uint64_t n = 0; for(auto s : seen_) n += s; return n; };
+      uint64_t kept() const { uint64_t n = 0; for(size_t s=0; s<strata(); ++s) n += kept(s); return n; };
+      size_t bytes() const { return samples_.size()*sizeof(float) + meta_.size()*sizeof(Sample) + aggregates_.size()*sizeof(double); };
+
+      void write(TDirectory * dir, const std::string& name = "heatmapReservoir") const
+      {
+         TDirectory::TContext restoreDirectory(dir);
+         const size_t pixels = side_*side_;
+
+         TTree * tree = new TTree(name.c_str(), "Reservoir-sampled crystal windows");
+         Int_t stratumIndex, ptBin, bremBin, range = range_;
+         Float_t weight;
+         Sample sample;
+         std::vector<Float_t> window(pixels);
+         tree->Branch("stratum", &stratumIndex, "stratum/I");
+         tree->Branch("ptBin", &ptBin, "ptBin/I");
+         tree->Branch("bremBin", &bremBin, "bremBin/I");
+         tree->Branch("weight", &weight, "weight/F");
+         tree->Branch("run", &sample.run, "run/i");
+         tree->Branch("lumi", &sample.lumi, "lumi/i");
+         tree->Branch("event", &sample.event, "event/l");
+         tree->Branch("pt", &sample.pt, "pt/F");
+         tree->Branch("genPt", &sample.genPt, "genPt/F");
+         tree->Branch("deltaR", &sample.deltaR, "deltaR/F");
+         tree->Branch("crystalCount", &sample.crystalCount, "crystalCount/F");
+         tree->Branch("bremStrength", &sample.bremStrength, "bremStrength/F");
+         tree->Branch("range", &range, "range/I");
+         tree->Branch("window", window.data(), ("window["+std::to_string(pixels)+"]/F").c_str());
+
+         TH1D * seenHist = new TH1D((name+"_seen").c_str(), "Candidates per stratum;Stratum;Candidates", strata(), -.5, strata()-.5);
+         TH2F * all = makeMap(name+"_all", "All candidates");
+         std::vector<double> allSum(pixels, 0.);
+         for(size_t s=0; s<strata(); ++s)
+         {
+            stratumIndex = s;
+            ptBin = s / nBrem_;
+            bremBin = s % nBrem_;
+            seenHist->SetBinContent(s+1, seen_[s]);
+            seenHist->GetXaxis()->SetBinLabel(s+1, label(ptBin, bremBin).c_str());
+
+            const size_t nKept = kept(s);
+            weight = nKept > 0 ? float(seen_[s])/nKept : 0.;
+            for(size_t slot=0; slot<nKept; ++slot)
+            {
+               sample = meta_[s*k_+slot];
+               std::copy(samples_.begin() + (s*k_+slot)*pixels, samples_.begin() + (s*k_+slot+1)*pixels, window.begin());
+               tree->Fill();
+            }
+
+            const double * aggregate = &aggregates_[s*pixels];
+            for(size_t p=0; p<pixels; ++p) allSum[p] += aggregate[p];
+            if ( strata() > 1 )
+            {
+               TH2F * map = makeMap(name+"_stratum"+std::to_string(s), label(ptBin, bremBin));
+               fillMap(map, aggregate, seen_[s]);
+            }
+         }
+         fillMap(all, allSum.data(), seen());
+         tree->Write();
+         delete tree;
+      };
+
+   private:
+      static int bin(const std::vector<double>& edges, float x)
+      {
+         int i = 0;
+         while ( i+2 < int(edges.size()) && x >= edges[i+1] ) ++i;
+         return i;
+      };
+
+      std::string label(int ptBin, int bremBin) const
+      {
+         char text[128];
+         std::string result;
+         if ( ptEdges_.size() > 1 )
+         {
+            snprintf(text, sizeof(text), "%g<pt<%g", ptEdges_[ptBin], ptEdges_[ptBin+1]);
+            result += text;
+         }
+         if ( bremEdges_.size() > 1 )
+         {
+            snprintf(text, sizeof(text), "%s%g<brem<%g", result.empty() ? "" : ",", bremEdges_[bremBin], bremEdges_[bremBin+1]);
+            result += text;
+         }
+         return result.empty() ? "All candidates" : result;
+      };
+
+      TH2F * makeMap(const std::string& name, const std::string& title) const
+      {
+         return new TH2F(name.c_str(), title.c_str(), side_, -range_-.5, range_+.5, side_, -range_-.5, range_+.5);
+      };
+
+      // Mean window per candidate, entries = candidates
+      void fillMap(TH2F * map, const double * sum, uint64_t n) const
+      {
+         for(int i=0; i<side_; ++i)
+            for(int j=0; j<side_; ++j)
+               map->SetBinContent(i+1, j+1, n > 0 ? sum[i*side_+j]/n : 0.);
+         map->SetEntries(n);
+      };
+
+      int range_;
+      int side_;
+      unsigned k_;
+      std::vector<double> ptEdges_;
+      std::vector<double> bremEdges_;
+      size_t nPt_;
+      size_t nBrem_;
+      std::vector<float> window_;
+      // [stratum][slot][pixel]
+      std::vector<float> samples_;
+      std::vector<Sample> meta_;
+      // [stratum][pixel]
+      std::vector<double> aggregates_;
+      std::vector<uint64_t> seen_;
+      Xorshift random_;
+};
+
+} // namespace l1eg
+
+#endif
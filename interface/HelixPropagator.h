@@ -0,0 +1,200 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_HelixPropagator_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_HelixPropagator_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::HelixPropagator HelixPropagator.h SLHCUpgradeSimulations/L1EGRateStudies/interface/HelixPropagator.h
+
+ Description: Batched propagation of gen particles to the ECAL entrance in a uniform solenoid field
+
+ Implementation:
+     Same surfaces and acceptance as BaseParticlePropagator::propagateToEcalEntrance():
+     a cylinder of radius 129 cm closed by disks at |z| = 303.353 cm,
+     then, for barrel crossings beyond |eta| = 1.479, the 152.6 x 320.9 cm
+     corner cylinder; anything beyond |eta| = 3 fails.  surface is the
+     equivalent of getSuccess() (kBarrel, kEndcap, or kFailed).
+     Instead of stepping an object per particle, each particle's helix is
+     intersected in closed form: the transverse circle with the cylinder
+     (two-circle intersection, angles measured from the helix centre so
+     that nearly straight tracks keep their precision), and z(s) with the
+     disks; neutral particles (or |curvature| below 1e-12 /cm) are lines.
+     Inputs and outputs are structure-of-arrays in Batch, positions in cm,
+     momenta in GeV, field in T along +z.  Energy is unchanged, so the
+     caller keeps E and takes eta, phi from the exit point.
+*/
+//
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace l1eg {
+
+class HelixPropagator
+{
+   public:
+      // Values of BaseParticlePropagator::getSuccess()
+      enum Surface { kFailed = 0, kBarrel = 1, kEndcap = 2 };
+
+      struct Config
+      {
+         double bField = 4.;
+         double barrelRadius = 129.0;
+         double endcapZ = 303.353;
+         double cornerRadius = 152.6;
+         double cornerEndcapZ = 320.9;
+         // cos^2(theta) of eta 1.479 and 3
+         double cornerCos2Theta = 0.81230;
+         double acceptanceCos2Theta = 0.99014;
+      };
+
+      // Structure of arrays, the first block is input, the second output of propagate()
+      struct Batch
+      {
+         std::vector<double> x, y, z, px, py, pz;
+         std::vector<int> charge;
+
+         std::vector<double> exitX, exitY, exitZ, exitPhi, pathLength;
+         std::vector<int> surface;
+
+         size_t size() const { return x.size(); };
+         void clear()
+         {
+            for(auto * v : {&x, &y, &z, &px, &py, &pz}) v->clear();
+            charge.clear();
+         };
+         void push_back(double x0, double y0, double z0, double px0, double py0, double pz0, int q)
+         {
+            x.push_back(x0); y.push_back(y0); z.push_back(z0);
+            px.push_back(px0); py.push_back(py0); pz.push_back(pz0);
+            charge.push_back(q);
+         };
+         double exitEta(size_t i) const { return std::asinh(exitZ[i]/std::hypot(exitX[i], exitY[i])); };
+         double exitPositionPhi(size_t i) const { return std::atan2(exitY[i], exitX[i]); };
+      };
+
+      HelixPropagator() {};
+      explicit HelixPropagator(const Config& config) : config_(config) {};
+
+      const Config& config() const { return config_; };
+
+      void propagate(Batch& batch) const
+      {
+         const size_t n = batch.size();
+         for(auto * v : {&batch.exitX, &batch.exitY, &batch.exitZ, &batch.exitPhi, &batch.pathLength}) v->resize(n);
+         batch.surface.resize(n);
+         for(size_t i=0; i<n; ++i)
+         {
+            Track t(batch.x[i], batch.y[i], batch.z[i], batch.px[i], batch.py[i], batch.pz[i], curvature(batch, i));
+            Surface surface = toCylinder(t, config_.barrelRadius, config_.endcapZ);
+            if ( surface == kBarrel && cos2Theta(t) > config_.cornerCos2Theta )
+               surface = toCylinder(t, config_.cornerRadius, config_.cornerEndcapZ);
+            if ( surface != kFailed && cos2Theta(t) > config_.acceptanceCos2Theta ) surface = kFailed;
+
+            batch.exitX[i] = t.x;
+            batch.exitY[i] = t.y;
+            batch.exitZ[i] = t.z;
+            batch.exitPhi[i] = t.phi;
+            batch.pathLength[i] = t.path;
+            batch.surface[i] = surface;
+         }
+      };
+
+   private:
+      // Helix state, moved along in place by toCylinder()
+      struct Track
+      {
+         Track(double x0, double y0, double z0, double px, double py, double pz, double omega0) :
+            x(x0), y(y0), z(z0), phi(std::atan2(py, px)), pt(std::hypot(px, py)), cotTheta(pz/std::hypot(px, py)), omega(omega0) {};
+         double x, y, z, phi, pt, cotTheta;
+         // signed curvature dphi/ds, s the transverse path length (cm)
+         double omega;
+         double path = 0.;
+      };
+
+      // 0.299792458 GeV/(T m), in /cm
+      double curvature(const Batch& batch, size_t i) const
+      {
+         const double pt = std::hypot(batch.px[i], batch.py[i]);
+         if ( batch.charge[i] == 0 || pt == 0. ) return 0.;
+         return -batch.charge[i]*0.299792458e-2*config_.bField/pt;
+      };
+
+      static double cos2Theta(const Track& t)
+      {
+         const double r2 = t.x*t.x + t.y*t.y + t.z*t.z;
+         return r2 > 0. ? t.z*t.z/r2 : 0.;
+      };
+
+      // Moves t to the first crossing of the cylinder or its end disks
+      static Surface toCylinder(Track& t, double radius, double halfLength)
+      {
+         const double inf = std::numeric_limits<double>::infinity();
+         if ( t.pt == 0. || t.x*t.x + t.y*t.y > radius*radius || std::fabs(t.z) > halfLength ) return kFailed;
+
+         double sBarrel = inf;
+         const bool straight = std::fabs(t.omega) < 1e-12;
+         if ( straight )
+         {
+            // |r0 + s u|^2 = R^2, u the transverse direction
+            const double b = t.x*std::cos(t.phi) + t.y*std::sin(t.phi);
+            const double c = t.x*t.x + t.y*t.y - radius*radius;
+            sBarrel = -b + std::sqrt(b*b - c);
+         }
+         else
+         {
+            // Helix centre, and the angle of the start point seen from it
+            const double rho = 1./std::fabs(t.omega);
+            const double sign = t.omega > 0. ? 1. : -1.;
+            const double cx = t.x - std::sin(t.phi)/t.omega;
+            const double cy = t.y + std::cos(t.phi)/t.omega;
+            const double d = std::hypot(cx, cy);
+            const double alpha0 = t.phi - sign*M_PI/2.;
+            const double cosArg = (radius*radius - d*d - rho*rho)/(2.*rho*d);
+            // |cosArg| > 1: the circle stays inside (a looper), only the disks can be reached
+            if ( d > 0. && std::fabs(cosArg) <= 1. )
+            {
+               const double gamma = std::atan2(cy, cx);
+               const double delta = std::acos(cosArg);
+               for(double alpha : {gamma+delta, gamma-delta})
+               {
+                  // Turning angle from the start, in the direction of motion, in (0, 2pi]
+                  double turn = std::remainder(sign*(alpha-alpha0), 2.*M_PI);
+                  if ( turn <= 0. ) turn += 2.*M_PI;
+                  sBarrel = std::min(sBarrel, turn*rho);
+               }
+            }
+         }
+
+         double sEndcap = inf;
+         if ( t.cotTheta != 0. ) sEndcap = ((t.cotTheta > 0. ? halfLength : -halfLength) - t.z)/t.cotTheta;
+         if ( sBarrel == inf && sEndcap == inf ) return kFailed;
+
+         const double s = std::min(sBarrel, sEndcap);
+         if ( straight )
+         {
+            t.x += s*std::cos(t.phi);
+            t.y += s*std::sin(t.phi);
+         }
+         else
+         {
+            // sin(a)-sin(b) and cos(a)-cos(b) as products, precise for small turns
+            const double phi = t.phi + t.omega*s;
+            const double chord = 2.*std::sin(t.omega*s/2.)/t.omega;
+            t.x += chord*std::cos(t.phi + t.omega*s/2.);
+            t.y += chord*std::sin(t.phi + t.omega*s/2.);
+            t.phi = std::remainder(phi, 2.*M_PI);
+         }
+         t.z += s*t.cotTheta;
+         t.path += s*std::sqrt(1. + t.cotTheta*t.cotTheta);
+         return sBarrel <= sEndcap ? kBarrel : kEndcap;
+      };
+
+      Config config_;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_L1EGEventContext_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_L1EGEventContext_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::EventContext L1EGEventContext.h SLHCUpgradeSimulations/L1EGRateStudies/interface/L1EGEventContext.h
+
+ Description: Per-event inputs shared by the L1EG analyzers
+
+ Implementation:
+     Built once per event by L1EGEventContextProducer and consumed
+     read-only by L1EGRateStudies and L1EGCrystalsHeatMap, so the
+     feature extraction, collection merging, hit geometry lookup
+     and gen particle propagation they all need is only done once.
+     The context is only passed between modules in memory, never
+     written out, so its dictionary (classes_def.xml) declares the class
+     alone.  gccxml, which generates the dictionary, does not parse the
+     C++11 of the headers below, so under __GCCXML__ the class is
+     declared without its members.  Written out it would be an empty
+     object: the dictionary marks it non-persistent, and an output module
+     in a process that makes it has to drop *_L1EGEventContext_*_*.
+*/
+//
+
+#ifndef __GCCXML__
+#include <string>
+#include <vector>
+
+#include "DataFormats/Candidate/interface/Candidate.h"
+#include "DataFormats/L1Trigger/interface/L1EmParticle.h"
+#include "DataFormats/L1Trigger/interface/L1EmParticleFwd.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ClusterFeatures.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/CrystalHitStore.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/PtOrdered.h"
+#endif
+
+namespace l1eg {
+
+#ifndef __GCCXML__
+// Generated electron or photon, as generated and propagated to the ECAL entrance
+// (ecal is the generated p4 if the propagation failed)
+class TruthParticle
+{
+   public:
+      int pdgId = 0;
+      bool propagated = false;
+      reco::Candidate::PolarLorentzVector gen;
+      reco::Candidate::PolarLorentzVector ecal;
+};
+#endif
+
+class EventContext
+{
+#ifndef __GCCXML__
+   public:
+      // Features and cut decisions of each crystal cluster, same order as the collection.
+      // Nothing here is sorted, use l1eg::ptOrdered() to walk a collection highest pt first
+      std::vector<ClusterFeatures> clusterFeatures;
+      // True if ClusterFeatures::emulatedPassBits were filled (fixedPointEmulation)
+      bool emulatedCuts = false;
+
+      // EG candidates of each algorithm, in input order.  Run 1 and UCT
+      // isolated/non-isolated collections are also merged into "<label>:All"
+      std::vector<std::string> egNames;
+      std::vector<l1extra::L1EmParticleCollection> egCandidates;
+
+      // ECAL (barrel, optionally endcap) and HCAL hits with positions resolved
+      CrystalHitStore ecalHits;
+      std::vector<CaloHit> hcalHits;
+
+      // Truth: the first gen particle (single particle guns), or every
+      // status 1 electron and photon in acceptance, see L1EGEventContextProducer
+      std::vector<TruthParticle> truth;
+
+      // nullptr if the algorithm was not configured in the producer
+      const l1extra::L1EmParticleCollection * egCollection(const std::string& name) const
+      {
+         for(size_t i=0; i<egNames.size(); ++i)
+            if ( egNames[i] == name ) return &egCandidates[i];
+         return nullptr;
+      };
+#endif
+};
+
+} // namespace l1eg
+
+#endif
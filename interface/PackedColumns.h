@@ -0,0 +1,358 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_PackedColumns_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_PackedColumns_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::PackedColumns PackedColumns.h SLHCUpgradeSimulations/L1EGRateStudies/interface/PackedColumns.h
+
+ Description: Tree columns with a declared storage precision each
+
+ Implementation:
+     Every column is declared with its source (a float, int or bool, or a
+     fixed-size float array, that stays at the same address) and a
+     precision:
+        full                 stored as is
+        mantissa:N           float with N mantissa bits, rounded to nearest
+                             even; same branch type, the zeroed low bits
+                             compress away
+        fixed:lo:hi:N        N <= 16 bit code over [lo, hi] (clamped), in a
+                             <name>_q branch; the alias <name> decodes it
+        int:N                signed 8, 16 or 32 bit integer (saturating)
+        flag                 one bit of the shared packedFlags byte; the
+                             alias <name> reads it back
+     Without packing every column is booked at full precision on its
+     source, exactly like TTree::Branch(name, &source).  With packing pack()
+     encodes the sources into an internal buffer the branches point at; it
+     must be called before each TTree::Fill.  Aliases are stored with the
+     tree, so TTree::Draw and TTreeFormula expressions (cutStudy.C,
+     drawBremParams.C, roc.py) see the original column names.  The
+     precision of every column is recorded in the tree's user info
+     ("columnPrecision").  Precisions can be overridden by name with
+     "name=spec" strings.
+*/
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "TList.h"
+#include "TNamed.h"
+#include "TTree.h"
+
+namespace l1eg {
+
+struct ColumnPrecision {
+   enum Kind { kFull, kMantissa, kFixed, kInt, kFlag };
+   Kind kind = kFull;
+   unsigned bits = 32;
+   float low = 0.;
+   float high = 0.;
+
+   static ColumnPrecision parse(const std::string& spec)
+   {
+      ColumnPrecision p;
+      if ( spec == "full" ) return p;
+      if ( spec == "flag" )
+      {
+         p.kind = kFlag;
+         p.bits = 1;
+         return p;
+      }
+      if ( sscanf(spec.c_str(), "mantissa:%u", &p.bits) == 1 && p.bits >= 1 && p.bits <= 23 ) p.kind = kMantissa;
+      else if ( sscanf(spec.c_str(), "fixed:%g:%g:%u", &p.low, &p.high, &p.bits) == 3 && p.bits >= 1 && p.bits <= 16 && p.high > p.low ) p.kind = kFixed;
+      else if ( sscanf(spec.c_str(), "int:%u", &p.bits) == 1 && p.bits >= 1 && p.bits <= 32 ) p.kind = kInt;
+      else throw std::invalid_argument("PackedColumns: bad precision '"+spec+"'");
+      return p;
+   };
+
+   std::string str() const
+   {
+      char out[64];
+      switch ( kind )
+      {
+         case kMantissa: snprintf(out, sizeof(out), "mantissa:%u", bits); break;
+         case kFixed: snprintf(out, sizeof(out), "fixed:%.9g:%.9g:%u", low, high, bits); break;
+         case kInt: snprintf(out, sizeof(out), "int:%u", bits); break;
+         case kFlag: return "flag";
+         default: return "full";
+      }
+      return out;
+   };
+
+   // Step of a fixed code, both ends of the range are representable
+   double lsb() const { return (double(high)-low)/((1u << bits)-1); };
+};
+
+// x with only the leading `bits` mantissa bits, rounded to nearest even
+inline float truncateMantissa(float x, unsigned bits)
+{
+   if ( bits >= 23 || !std::isfinite(x) ) return x;
+   uint32_t u;
+   std::memcpy(&u, &x, sizeof(u));
+   const unsigned drop = 23-bits;
+   u += (1u << (drop-1)) - 1 + ((u >> drop) & 1);
+   u &= ~((1u << drop) - 1);
+   std::memcpy(&x, &u, sizeof(x));
+   return x;
+}
+
+inline uint16_t encodeFixed(float x, const ColumnPrecision& p)
+{
+   const uint32_t maxCode = (1u << p.bits)-1;
+   if ( std::isnan(x) || x <= p.low ) return 0;
+   if ( x >= p.high ) return maxCode;
+   return std::min<uint32_t>(maxCode, uint32_t(std::floor((x-p.low)/p.lsb() + 0.5)));
+}
+
+inline float decodeFixed(uint16_t code, const ColumnPrecision& p)
+{
+   return p.low + code*p.lsb();
+}
+
+template<typename T>
+inline T saturate(double x)
+{
+   if ( std::isnan(x) ) return 0;
+   const double lo = double(std::numeric_limits<T>::min());
+   const double hi = double(std::numeric_limits<T>::max());
+   return T(std::floor(std::max(lo, std::min(hi, x)) + 0.5));
+}
+
+class PackedColumns
+{
+   public:
+      // overrides: "name=spec", applied to the columns declared later
+      PackedColumns(bool packed, const std::vector<std::string>& overrides = std::vector<std::string>()) :
+         packed_(packed)
+      {
+         for(const auto& o : overrides)
+         {
+            const size_t eq = o.find('=');
+            if ( eq == std::string::npos ) throw std::invalid_argument("PackedColumns: override '"+o+"' is not name=spec");
+            overrides_[o.substr(0, eq)] = ColumnPrecision::parse(o.substr(eq+1));
+         }
+      };
+
+      bool packed() const { return packed_; };
+
+      // n > 1: fixed-size array, as name[n]/F, or as the leaf list `leaves` (e.g. "1:2:3") if given
+      void add(const std::string& name, const float * source, const std::string& precision, size_t n = 1, const std::string& leaves = "")
+      {
+         Column c = column(name, precision, kFloat, n);
+         c.source = source;
+         c.leaves = leaves;
+         if ( c.precision.kind == ColumnPrecision::kFixed && n > 1 ) throw std::invalid_argument("PackedColumns: fixed precision on array "+name);
+         if ( c.precision.kind == ColumnPrecision::kFlag ) throw std::invalid_argument("PackedColumns: flag precision on float "+name);
+         columns_.push_back(c);
+      };
+
+      void add(const std::string& name, const int * source, const std::string& precision)
+      {
+         Column c = column(name, precision, kInt, 1);
+         c.source = source;
+         if ( c.precision.kind == ColumnPrecision::kMantissa || c.precision.kind == ColumnPrecision::kFlag )
+            throw std::invalid_argument("PackedColumns: "+c.precision.str()+" precision on int "+name);
+         columns_.push_back(c);
+      };
+
+      void add(const std::string& name, const bool * source, const std::string& precision)
+      {
+         Column c = column(name, precision, kBool, 1);
+         c.source = source;
+         if ( c.precision.kind != ColumnPrecision::kFull && c.precision.kind != ColumnPrecision::kFlag )
+            throw std::invalid_argument("PackedColumns: "+c.precision.str()+" precision on bool "+name);
+         columns_.push_back(c);
+      };
+
+      void book(TTree * tree)
+      {
+         // Storage layout first, the buffer must not move once branches point into it
+         size_t size = 0;
+         unsigned nFlags = 0;
+         for(auto& c : columns_)
+         {
+            if ( !packed_ ) continue;
+            if ( c.precision.kind == ColumnPrecision::kFlag )
+            {
+               if ( nFlags == 8 ) throw std::invalid_argument("PackedColumns: more than 8 flags");
+               c.flagBit = nFlags++;
+               continue;
+            }
+            c.width = storageWidth(c);
+            size = (size + c.width-1)/c.width*c.width;
+            c.offset = size;
+            size += c.width*c.n;
+         }
+         flagsOffset_ = size;
+         storage_.assign((size+1+7)/8, 0);
+
+         std::string description;
+         for(const auto& c : columns_)
+         {
+            description += c.name + "=" + (packed_ ? c.precision.str() : std::string("full")) + " ";
+            if ( !packed_ || c.precision.kind == ColumnPrecision::kFull )
+            {
+               void * address = packed_ ? at(c.offset) : const_cast<void *>(c.source);
+               tree->Branch(c.name.c_str(), address, leafList(c, c.name, sourceType(c)).c_str());
+            }
+            else if ( c.precision.kind == ColumnPrecision::kMantissa )
+               tree->Branch(c.name.c_str(), at(c.offset), leafList(c, c.name, 'F').c_str());
+            else if ( c.precision.kind == ColumnPrecision::kInt )
+               tree->Branch(c.name.c_str(), at(c.offset), leafList(c, c.name, intType(c.width)).c_str());
+            else if ( c.precision.kind == ColumnPrecision::kFixed )
+            {
+               const std::string stored = c.name+"_q";
+               tree->Branch(stored.c_str(), at(c.offset), (stored + (c.width == 1 ? "/b" : "/s")).c_str());
+               char alias[128];
+               snprintf(alias, sizeof(alias), "(%.9g+%s*%.9g)", c.precision.low, stored.c_str(), c.precision.lsb());
+               tree->SetAlias(c.name.c_str(), alias);
+            }
+            else if ( c.precision.kind == ColumnPrecision::kFlag )
+               tree->SetAlias(c.name.c_str(), ("(packedFlags&"+std::to_string(1u << c.flagBit)+")!=0").c_str());
+         }
+         if ( nFlags > 0 ) tree->Branch("packedFlags", at(flagsOffset_), "packedFlags/b");
+         tree->GetUserInfo()->Add(new TNamed("columnPrecision", description.c_str()));
+      };
+
+      // Encodes the sources, call before every TTree::Fill (no-op without packing)
+      void pack()
+      {
+         if ( !packed_ ) return;
+         uint8_t flags = 0;
+         for(const auto& c : columns_)
+         {
+            switch ( c.precision.kind )
+            {
+               case ColumnPrecision::kFull:
+                  std::memcpy(at(c.offset), c.source, c.width*c.n);
+                  break;
+               case ColumnPrecision::kMantissa:
+                  for(size_t i=0; i<c.n; ++i)
+                     store<float>(c, i, truncateMantissa(static_cast<const float *>(c.source)[i], c.precision.bits));
+                  break;
+               case ColumnPrecision::kFixed:
+                  if ( c.width == 1 ) store<uint8_t>(c, 0, encodeFixed(value(c, 0), c.precision));
+                  else store<uint16_t>(c, 0, encodeFixed(value(c, 0), c.precision));
+                  break;
+               case ColumnPrecision::kInt:
+                  for(size_t i=0; i<c.n; ++i)
+                  {
+                     if ( c.width == 1 ) store<int8_t>(c, i, saturate<int8_t>(value(c, i)));
+                     else if ( c.width == 2 ) store<int16_t>(c, i, saturate<int16_t>(value(c, i)));
+                     else store<int32_t>(c, i, saturate<int32_t>(value(c, i)));
+                  }
+                  break;
+               case ColumnPrecision::kFlag:
+                  if ( *static_cast<const bool *>(c.source) ) flags |= 1u << c.flagBit;
+                  break;
+            }
+         }
+         *static_cast<uint8_t *>(at(flagsOffset_)) = flags;
+      };
+
+      // Uncompressed bytes per entry, as stored
+      size_t bytesPerEntry() const
+      {
+         size_t bytes = 0;
+         bool flags = false;
+         for(const auto& c : columns_)
+         {
+            if ( !packed_ ) bytes += sourceWidth(c)*c.n;
+            else if ( c.precision.kind == ColumnPrecision::kFlag ) flags = true;
+            else bytes += c.width*c.n;
+         }
+         return bytes + (flags ? 1 : 0);
+      };
+
+   private:
+      enum SourceType { kFloat, kInt, kBool };
+
+      struct Column {
+         std::string name;
+         SourceType type;
+         size_t n;
+         std::string leaves;
+         ColumnPrecision precision;
+         const void * source = nullptr;
+         size_t width = 0;
+         size_t offset = 0;
+         unsigned flagBit = 0;
+      };
+
+      Column column(const std::string& name, const std::string& precision, SourceType type, size_t n) const
+      {
+         Column c;
+         c.name = name;
+         c.type = type;
+         c.n = n;
+         auto o = overrides_.find(name);
+         c.precision = (o != overrides_.end()) ? o->second : ColumnPrecision::parse(precision);
+         return c;
+      };
+
+      static size_t sourceWidth(const Column& c) { return c.type == kBool ? sizeof(bool) : 4; };
+
+      static size_t storageWidth(const Column& c)
+      {
+         switch ( c.precision.kind )
+         {
+            case ColumnPrecision::kFixed: return c.precision.bits <= 8 ? 1 : 2;
+            case ColumnPrecision::kInt: return c.precision.bits <= 8 ? 1 : (c.precision.bits <= 16 ? 2 : 4);
+            default: return sourceWidth(c);
+         }
+      };
+
+      static char sourceType(const Column& c) { return c.type == kFloat ? 'F' : (c.type == kInt ? 'I' : 'O'); };
+      static char intType(size_t width) { return width == 1 ? 'B' : (width == 2 ? 'S' : 'I'); };
+
+      static std::string leafList(const Column& c, const std::string& name, char type)
+      {
+         const std::string suffix = std::string("/") + type;
+         if ( c.n == 1 ) return name + suffix;
+         if ( c.leaves.empty() ) return name + "[" + std::to_string(c.n) + "]" + suffix;
+         // Every leaf of the list gets the type
+         std::string out;
+         size_t start = 0;
+         while ( true )
+         {
+            const size_t end = c.leaves.find(':', start);
+            out += c.leaves.substr(start, end-start) + suffix;
+            if ( end == std::string::npos ) break;
+            out += ":";
+            start = end+1;
+         }
+         return out;
+      };
+
+      double value(const Column& c, size_t i) const
+      {
+         if ( c.type == kFloat ) return static_cast<const float *>(c.source)[i];
+         if ( c.type == kInt ) return static_cast<const int *>(c.source)[i];
+         return *static_cast<const bool *>(c.source);
+      };
+
+      void * at(size_t offset) { return reinterpret_cast<uint8_t *>(storage_.data()) + offset; };
+
+      template<typename T>
+      void store(const Column& c, size_t i, T x) { std::memcpy(static_cast<uint8_t *>(at(c.offset)) + i*sizeof(T), &x, sizeof(T)); };
+
+      bool packed_;
+      std::map<std::string, ColumnPrecision> overrides_;
+      std::vector<Column> columns_;
+      // uint64_t for alignment of the packed values
+      std::vector<uint64_t> storage_;
+      size_t flagsOffset_ = 0;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_PtOrdered_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_PtOrdered_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::PtOrdered PtOrdered.h SLHCUpgradeSimulations/L1EGRateStudies/interface/PtOrdered.h
+
+ Description: Lazy highest-pt-first iteration over a collection
+
+ Implementation:
+     The candidate indices are put in a binary max-heap by pt, which is O(N),
+     and each step of the iteration pops one of them in O(log N).  Loops that
+     stop at the leading candidate, or at the first one passing some cuts,
+     then cost O(N + k log N) instead of a full O(N log N) sort.
+     Usage:
+        for(unsigned i : l1eg::ptOrdered(collection)) { ... collection[i] ... }
+     Passing a ScratchArena puts the index heap in per-event scratch memory.
+*/
+//
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ScratchArena.h"
+
+namespace l1eg {
+
+namespace detail {
+// pt of a candidate (pt()) or of a flat record (pt member), the int/long overloads prefer pt()
+template<typename T> auto ptOf(const T& c, int) -> decltype(c.pt()) { return c.pt(); }
+template<typename T> auto ptOf(const T& c, long) -> decltype(c.pt) { return c.pt; }
+}
+
+template<typename Collection>
+class PtOrdered
+{
+   public:
+      explicit PtOrdered(const Collection& collection, ScratchArena * arena = nullptr) :
+         collection_(&collection),
+         heap_(collection.size(), 0u, ArenaAllocator<unsigned>(arena)),
+         heapSize_(collection.size())
+      {
+         for(unsigned i=0; i<heap_.size(); ++i) heap_[i] = i;
+         std::make_heap(heap_.begin(), heap_.end(), Less{collection_});
+         advance();
+      };
+
+      class iterator : public std::iterator<std::input_iterator_tag, unsigned>
+      {
+         public:
+            explicit iterator(PtOrdered * parent) : parent_(parent) {};
+            unsigned operator*() const { return parent_->current_; };
+            iterator& operator++() { parent_->advance(); return *this; };
+            // Single pass: any iterator compares equal to end() once the heap is exhausted
+            bool operator!=(const iterator&) const { return parent_->hasCurrent_; };
+            bool operator==(const iterator& other) const { return !(*this != other); };
+         private:
+            PtOrdered * parent_;
+      };
+
+      iterator begin() { return iterator(this); };
+      iterator end() { return iterator(this); };
+
+   private:
+      struct Less {
+         const Collection * c;
+         bool operator()(unsigned a, unsigned b) const { return detail::ptOf((*c)[a], 0) < detail::ptOf((*c)[b], 0); };
+      };
+
+      void advance()
+      {
+         hasCurrent_ = heapSize_ > 0;
+         if ( !hasCurrent_ ) return;
+         std::pop_heap(heap_.begin(), heap_.begin()+heapSize_, Less{collection_});
+         current_ = heap_[--heapSize_];
+      };
+
+      const Collection * collection_;
+      ArenaVector<unsigned> heap_;
+      size_t heapSize_;
+      unsigned current_ = 0;
+      bool hasCurrent_ = false;
+};
+
+template<typename Collection>
+PtOrdered<Collection> ptOrdered(const Collection& collection) { return PtOrdered<Collection>(collection); }
+
+template<typename Collection>
+PtOrdered<Collection> ptOrdered(const Collection& collection, ScratchArena& arena) { return PtOrdered<Collection>(collection, &arena); }
+
+} // namespace l1eg
+
+#endif
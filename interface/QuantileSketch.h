@@ -0,0 +1,339 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_QuantileSketch_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_QuantileSketch_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::QuantileSketch QuantileSketch.h SLHCUpgradeSimulations/L1EGRateStudies/interface/QuantileSketch.h
+
+ Description: Mergeable streaming quantile sketch (KLL), and a named set of them written next to the histograms
+
+ Implementation:
+     QuantileSketch keeps a stack of compactors: values enter level 0 with
+     weight 1, and a level that reaches its capacity is sorted and every
+     other value (random offset) moves up a level with twice the weight.
+     Capacities shrink geometrically (2/3) below the top level, so memory
+     is about 3k values whatever the stream length, and the rank error is
+     of order 1/k.  The exact count, min and max are kept alongside.
+
+     QuantileSketchSet ties sketches to histograms: fill(hist, x) fills
+     both.  write() stores every retained value with its weight in one
+     tree (quantileSketch_items) and the per-stream name, count and range
+     in another (quantileSketch_streams).  hadd concatenates the trees of
+     parallel jobs, and the union of weighted values is itself a valid
+     merged sketch, so test/sketchHistograms.py can produce quantiles and
+     correctly ranged histograms from the merged output.  read() merges
+     stored sketches back in, which is how Checkpoint restores them.
+*/
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "TDirectory.h"
+#include "TH1.h"
+#include "TH2.h"
+#include "TTree.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/Xorshift.h"
+
+namespace l1eg {
+
+class QuantileSketch
+{
+   public:
+      explicit QuantileSketch(unsigned k = 200) : k_(std::max(k, 8u)), levels_(1) {};
+
+      void add(float x)
+      {
+         if ( std::isnan(x) ) return;
+         ++n_;
+         min_ = std::min(min_, x);
+         max_ = std::max(max_, x);
+         levels_[0].push_back(x);
+         if ( levels_[0].size() >= capacity(0) ) compress();
+      };
+
+      void merge(const QuantileSketch& other)
+      {
+         if ( other.levels_.size() > levels_.size() ) levels_.resize(other.levels_.size());
+         for(size_t h=0; h<other.levels_.size(); ++h)
+            levels_[h].insert(end(levels_[h]), begin(other.levels_[h]), end(other.levels_[h]));
+         n_ += other.n_;
+         min_ = std::min(min_, other.min_);
+         max_ = std::max(max_, other.max_);
+         compress();
+      };
+
+      uint64_t count() const { return n_; };
+      float min() const { return min_; };
+      float max() const { return max_; };
+
+      // Number of values retained
+      size_t size() const
+      {
+         size_t n = 0;
+         for(const auto& level : levels_) n += level.size();
+         return n;
+      };
+
+      // f(value, weight) for every retained value, the weights sum to count()
+      template<typename F>
+      void forEachItem(F f) const
+      {
+         for(size_t h=0; h<levels_.size(); ++h)
+            for(float x : levels_[h]) f(x, uint64_t(1) << h);
+      };
+
+      // Approximate q-quantile, q in [0, 1]; the exact min and max at the ends
+      float quantile(double q) const
+      {
+         if ( n_ == 0 ) return std::nan("");
+         if ( q <= 0. ) return min_;
+         if ( q >= 1. ) return max_;
+         std::vector<std::pair<float, uint64_t>> items;
+         items.reserve(size());
+         forEachItem([&items](float x, uint64_t w) { items.push_back(std::make_pair(x, w)); });
+         std::sort(begin(items), end(items));
+         uint64_t total = 0;
+         for(const auto& item : items) total += item.second;
+         const double target = q*total;
+         uint64_t cumulative = 0;
+         for(const auto& item : items)
+         {
+            cumulative += item.second;
+            if ( cumulative >= target ) return item.first;
+         }
+         return max_;
+      };
+
+      // Adds a stored value of the given weight (a power of 2) without touching count, min or max
+      void addStored(float x, uint64_t weight)
+      {
+         size_t h = 0;
+         while ( (uint64_t(1) << (h+1)) <= weight ) ++h;
+         if ( h >= levels_.size() ) levels_.resize(h+1);
+         levels_[h].push_back(x);
+      };
+
+      // Adds the exact count and range of stored values
+      void addStoredSummary(uint64_t n, float min, float max)
+      {
+         n_ += n;
+         min_ = std::min(min_, min);
+         max_ = std::max(max_, max);
+      };
+
+      // Brings every level back within its capacity
+      void compress()
+      {
+         for(size_t h=0; h<levels_.size(); ++h)
+         {
+            if ( levels_[h].size() < capacity(h) ) continue;
+            if ( h+1 == levels_.size() ) levels_.emplace_back();
+            auto& level = levels_[h];
+            std::sort(begin(level), end(level));
+            // With an odd count the largest value stays, so no weight is lost
+            float kept = 0.;
+            const bool odd = level.size() % 2;
+            if ( odd )
+            {
+               kept = level.back();
+               level.pop_back();
+            }
+            auto& above = levels_[h+1];
+            for(size_t i=randomBit(); i<level.size(); i+=2) above.push_back(level[i]);
+            level.clear();
+            if ( odd ) level.push_back(kept);
+         }
+      };
+
+   private:
+      size_t capacity(size_t level) const
+      {
+         const size_t depth = levels_.size() - 1 - level;
+         return std::max<size_t>(2, std::ceil(k_*std::pow(2./3., double(depth))));
+      };
+
+      unsigned randomBit() { return random_() & 1; };
+
+      unsigned k_;
+      std::vector<std::vector<float>> levels_;
+      uint64_t n_ = 0;
+      float min_ = INFINITY;
+      float max_ = -INFINITY;
+      Xorshift random_;
+};
+
+class QuantileSketchSet
+{
+   public:
+      // k = 0 disables the sketches, fill() then only fills the histograms
+      explicit QuantileSketchSet(unsigned k = 200) : k_(k) {};
+
+      bool active() const { return k_ > 0; };
+      size_t size() const { return streams_.size(); };
+
+      QuantileSketch& book(const std::string& name, const std::string& title)
+      {
+         streams_.push_back(Stream{name, title, QuantileSketch(k_)});
+         return streams_.back().sketch;
+      };
+
+      // Sketches the axes of hist, named after it (with _x, _y for 2D histograms)
+      void track(TH1 * hist)
+      {
+         if ( !active() ) return;
+         const std::string name = hist->GetName();
+         const size_t first = streams_.size();
+         if ( hist->GetDimension() == 1 )
+            book(name, hist->GetXaxis()->GetTitle());
+         else
+         {
+            book(name+"_x", hist->GetXaxis()->GetTitle());
+            book(name+"_y", hist->GetYaxis()->GetTitle());
+         }
+         index_[hist] = first;
+      };
+
+      void fill(TH1 * hist, double x)
+      {
+         hist->Fill(x);
+         auto it = index_.find(hist);
+         if ( it != index_.end() ) streams_[it->second].sketch.add(x);
+      };
+
+      void fill(TH2 * hist, double x, double y)
+      {
+         hist->Fill(x, y);
+         auto it = index_.find(hist);
+         if ( it == index_.end() ) return;
+         streams_[it->second].sketch.add(x);
+         streams_[it->second+1].sketch.add(y);
+      };
+
+      // Creates, fills and writes the two sketch trees in dir
+      void write(TDirectory * dir) const
+      {
+         if ( !active() ) return;
+         TDirectory::TContext restoreDirectory(dir);
+
+         TTree * streams = new TTree("quantileSketch_streams", "Quantile sketch streams");
+         Int_t stream;
+         char name[kNameLength], title[kNameLength];
+         Long64_t n;
+         Float_t min, max;
+         streams->Branch("stream", &stream, "stream/I");
+         streams->Branch("name", name, "name/C");
+         streams->Branch("title", title, "title/C");
+         streams->Branch("count", &n, "count/L");
+         streams->Branch("min", &min, "min/F");
+         streams->Branch("max", &max, "max/F");
+
+         TTree * items = new TTree("quantileSketch_items", "Quantile sketch values and weights");
+         Float_t value;
+         Long64_t weight;
+         items->Branch("stream", &stream, "stream/I");
+         items->Branch("value", &value, "value/F");
+         items->Branch("weight", &weight, "weight/L");
+
+         for(size_t i=0; i<streams_.size(); ++i)
+         {
+            const auto& s = streams_[i];
+            stream = i;
+            copyName(name, s.name);
+            copyName(title, s.title);
+            n = s.sketch.count();
+            min = s.sketch.min();
+            max = s.sketch.max();
+            streams->Fill();
+            s.sketch.forEachItem([&](float x, uint64_t w) {
+               value = x;
+               weight = w;
+               items->Fill();
+            });
+         }
+         streams->Write();
+         items->Write();
+         delete streams;
+         delete items;
+      };
+
+      // Merges sketches stored by write() into the booked streams of the same name
+      void read(TDirectory * dir)
+      {
+         if ( !active() ) return;
+         TTree * streams = dynamic_cast<TTree *>(dir->Get("quantileSketch_streams"));
+         TTree * items = dynamic_cast<TTree *>(dir->Get("quantileSketch_items"));
+         if ( streams == nullptr || items == nullptr ) return;
+
+         std::unordered_map<std::string, size_t> byName;
+         for(size_t i=0; i<streams_.size(); ++i) byName[streams_[i].name] = i;
+
+         Int_t stream;
+         char name[kNameLength];
+         Long64_t n;
+         Float_t min, max;
+         streams->SetBranchAddress("stream", &stream);
+         streams->SetBranchAddress("name", name);
+         streams->SetBranchAddress("count", &n);
+         streams->SetBranchAddress("min", &min);
+         streams->SetBranchAddress("max", &max);
+         std::unordered_map<Int_t, QuantileSketch *> target;
+         for(Long64_t i=0; i<streams->GetEntries(); ++i)
+         {
+            streams->GetEntry(i);
+            auto it = byName.find(name);
+            if ( it == byName.end() ) continue;
+            QuantileSketch& sketch = streams_[it->second].sketch;
+            sketch.addStoredSummary(n, min, max);
+            target[stream] = &sketch;
+         }
+
+         Float_t value;
+         Long64_t weight;
+         items->SetBranchAddress("stream", &stream);
+         items->SetBranchAddress("value", &value);
+         items->SetBranchAddress("weight", &weight);
+         for(Long64_t i=0; i<items->GetEntries(); ++i)
+         {
+            items->GetEntry(i);
+            auto it = target.find(stream);
+            if ( it != target.end() ) it->second->addStored(value, weight);
+         }
+         for(auto& s : streams_) s.sketch.compress();
+         delete streams;
+         delete items;
+      };
+
+   private:
+      static constexpr size_t kNameLength = 256;
+
+      static void copyName(char * buffer, const std::string& s)
+      {
+         std::strncpy(buffer, s.c_str(), kNameLength-1);
+         buffer[kNameLength-1] = '\0';
+      };
+
+      struct Stream {
+         std::string name;
+         std::string title;
+         QuantileSketch sketch;
+      };
+
+      unsigned k_;
+      // A deque, references returned by book() stay valid
+      std::deque<Stream> streams_;
+      std::unordered_map<const TH1 *, size_t> index_;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_ScratchArena_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_ScratchArena_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::ScratchArena ScratchArena.h SLHCUpgradeSimulations/L1EGRateStudies/interface/ScratchArena.h
+
+ Description: Monotonic per-event scratch memory
+
+ Implementation:
+     Allocations bump a pointer through one block, deallocation is a no-op,
+     and reset() at the start of each event rewinds it.  When an event needs
+     more than the block holds, the excess comes from extra blocks, and the
+     next reset() replaces everything with a single block a quarter larger
+     than the high water mark, so once the largest event has been seen, event processing
+     does no heap allocation for the scratch containers.  One arena per
+     module instance, i.e. per stream; it is not thread safe.
+*/
+//
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace l1eg {
+
+class ScratchArena
+{
+   public:
+      explicit ScratchArena(size_t initialBytes = 64*1024) :
+         block_(new char[initialBytes]),
+         capacity_(initialBytes)
+      {};
+
+      ScratchArena(const ScratchArena&) = delete;
+      ScratchArena& operator=(const ScratchArena&) = delete;
+
+      void * allocate(size_t bytes, size_t alignment)
+      {
+         const size_t start = (used_ + alignment - 1) & ~(alignment - 1);
+         if ( start + bytes <= capacity_ )
+         {
+            used_ = start + bytes;
+            highWater_ = std::max(highWater_, used_ + overflowBytes_);
+            return block_.get() + start;
+         }
+         // Does not fit: serve from a dedicated block until the next reset
+         overflow_.emplace_back(new char[bytes + alignment]);
+         overflowBytes_ += bytes + alignment;
+         overflowAllocations_++;
+         highWater_ = std::max(highWater_, used_ + overflowBytes_);
+         const uintptr_t p = reinterpret_cast<uintptr_t>(overflow_.back().get());
+         return reinterpret_cast<void *>((p + alignment - 1) & ~uintptr_t(alignment - 1));
+      };
+
+      // Call at the start of each event, invalidates everything allocated since the last reset
+      void reset()
+      {
+         if ( !overflow_.empty() )
+         {
+            overflow_.clear();
+            capacity_ = highWater_ + highWater_/4;
+            block_.reset(new char[capacity_]);
+            resizes_++;
+         }
+         used_ = 0;
+         overflowBytes_ = 0;
+         resets_++;
+      };
+
+      size_t capacity() const { return capacity_; };
+      size_t highWaterMark() const { return highWater_; };
+      size_t overflowAllocations() const { return overflowAllocations_; };
+      size_t resizes() const { return resizes_; };
+      size_t resets() const { return resets_; };
+
+      // One line for the end of job report
+      std::string summary() const
+      {
+         return "high water mark " + std::to_string(highWater_) + " bytes over " + std::to_string(resets_) + " events, "
+                + std::to_string(overflowAllocations_) + " overflow allocations, " + std::to_string(resizes_) + " resizes";
+      };
+
+   private:
+      std::unique_ptr<char[]> block_;
+      size_t capacity_;
+      size_t used_ = 0;
+      std::vector<std::unique_ptr<char[]>> overflow_;
+      size_t overflowBytes_ = 0;
+      size_t highWater_ = 0;
+      size_t overflowAllocations_ = 0;
+      size_t resizes_ = 0;
+      size_t resets_ = 0;
+};
+
+// Standard allocator on a ScratchArena, or on the heap if no arena is given
+template<typename T>
+class ArenaAllocator
+{
+   public:
+      typedef T value_type;
+      typedef T * pointer;
+      typedef const T * const_pointer;
+      typedef T & reference;
+      typedef const T & const_reference;
+      typedef size_t size_type;
+      typedef ptrdiff_t difference_type;
+      template<typename U> struct rebind { typedef ArenaAllocator<U> other; };
+
+      ArenaAllocator(ScratchArena * arena = nullptr) : arena_(arena) {};
+      template<typename U> ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {};
+
+      T * allocate(size_t n)
+      {
+         if ( arena_ == nullptr ) return static_cast<T *>(::operator new(n*sizeof(T)));
+         return static_cast<T *>(arena_->allocate(n*sizeof(T), std::alignment_of<T>::value));
+      };
+      void deallocate(T * p, size_t)
+      {
+         if ( arena_ == nullptr ) ::operator delete(p);
+      };
+
+      template<typename U, typename... Args> void construct(U * p, Args&&... args) { ::new((void *) p) U(std::forward<Args>(args)...); };
+      template<typename U> void destroy(U * p) { p->~U(); };
+      size_t max_size() const { return size_t(-1)/sizeof(T); };
+
+      ScratchArena * arena() const { return arena_; };
+
+   private:
+      ScratchArena * arena_;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena() == b.arena(); }
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena() != b.arena(); }
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_ShowerShapes_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_ShowerShapes_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::ShowerShapeEngine ShowerShapes.h SLHCUpgradeSimulations/L1EGRateStudies/interface/ShowerShapes.h
+
+ Description: Configurable window shower shapes, recomputed from barrel rec hits around the cluster seed
+
+ Implementation:
+     Each variable is a "name=kind:args" string, offsets are in crystals
+     from the seed, (deta, dphi) inclusive ranges, pt in GeV:
+        sum:e0:e1:p0:p1              pt sum over the window
+        maxsum:e0:e1:p0:p1:h:w       largest h x w sub-window sum inside the
+                                     window (E2x5max is maxsum:-1:1:-2:2:2:5)
+        count:e0:e1:p0:p1:t          crystals above t GeV
+        rank:e0:e1:p0:p1:n           n-th highest crystal pt (n = 1 is the highest)
+        run:e0:e1:d:t                phi strip length: contiguous phi columns,
+                                     each summed over e0..e1, above t GeV,
+                                     through the seed column, at most d each side
+        ratio:a:b                    a/b of two earlier variables, 0 if b is 0
+     setHits() spreads the barrel hit pts over a dense (ieta, iphi) grid,
+     padded in eta with zeros and in phi with a copy of the wrapped
+     columns, so any window is a block of contiguous rows.  compute()
+     copies the block around the seed (as far as the widest variable
+     reaches) and builds its summed-area table, so every sum and sub-window
+     sum costs four lookups.  Only the grid cells written by setHits() are
+     cleared for the next event.  Seeds outside the barrel give zeros.
+*/
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/CrystalHitStore.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/EBTriggerTowerMap.h"
+
+namespace l1eg {
+
+class ShowerShapeEngine
+{
+   public:
+      enum Kind { kSum, kMaxSum, kCount, kRank, kRun, kRatio };
+
+      struct Variable
+      {
+         std::string name;
+         Kind kind;
+         int e0 = 0, e1 = 0, p0 = 0, p1 = 0;
+         // maxsum: sub-window size; rank: n; run: reach in phi; ratio: operand indices
+         int a = 0, b = 0;
+         float threshold = 0.;
+      };
+
+      explicit ShowerShapeEngine(const std::vector<std::string>& definitions)
+      {
+         for(const auto& definition : definitions) variables_.push_back(parse(definition));
+         for(const auto& v : variables_)
+            reach_ = std::max({reach_, std::abs(v.e0), std::abs(v.e1), std::abs(v.p0), std::abs(v.p1)});
+         side_ = 2*reach_ + 1;
+         rows_ = 2*eb::kMaxIEta + 2*reach_;
+         columns_ = eb::kMaxIPhi + 2*reach_;
+         if ( !variables_.empty() ) grid_.assign(rows_*columns_, 0.f);
+         patch_.resize(side_*side_);
+         table_.resize((side_+1)*(side_+1));
+         values_.reserve(side_*side_);
+      };
+
+      size_t size() const { return variables_.size(); };
+      bool empty() const { return variables_.empty(); };
+      const Variable& variable(size_t i) const { return variables_[i]; };
+      // Storage precision for PackedColumns, crystal counts are small integers
+      const char * precision(size_t i) const
+      {
+         return ( variables_[i].kind == kCount || variables_[i].kind == kRun ) ? "mantissa:8" : "mantissa:10";
+      };
+
+      void setHits(const CrystalHitStore& hits)
+      {
+         if ( empty() ) return;
+         for(int cell : written_) grid_[cell] = 0.f;
+         written_.clear();
+         for(const auto& hit : hits.hits())
+         {
+            if ( !hit.isBarrel() ) continue;
+            const int row = eb::contiguousIEta(eb::ieta(hit.index)) + eb::kMaxIEta + reach_;
+            const int phi = eb::iphi(hit.index) - 1;
+            const float pt = hit.pt();
+            set(row, phi + reach_, pt);
+            // Halo copies of the columns within reach of the wrap
+            if ( phi < reach_ ) set(row, phi + eb::kMaxIPhi + reach_, pt);
+            if ( phi >= eb::kMaxIPhi - reach_ ) set(row, phi - eb::kMaxIPhi + reach_, pt);
+         }
+      };
+
+      // out: size() values for the cluster seeded at crystal::index seedIndex
+      void compute(int seedIndex, float * out)
+      {
+         if ( empty() ) return;
+         if ( !crystal::isBarrel(seedIndex) )
+         {
+            std::fill(out, out+size(), 0.f);
+            return;
+         }
+         const int row = eb::contiguousIEta(eb::ieta(seedIndex)) + eb::kMaxIEta + reach_;
+         const int column = eb::iphi(seedIndex) - 1 + reach_;
+         for(int i=0; i<side_; ++i)
+         {
+            const float * source = &grid_[(row - reach_ + i)*columns_ + column - reach_];
+            std::copy(source, source + side_, &patch_[i*side_]);
+         }
+         for(int i=0; i<side_; ++i)
+         {
+            double rowSum = 0.;
+            for(int j=0; j<side_; ++j)
+            {
+               rowSum += patch_[i*side_+j];
+               table_[(i+1)*(side_+1) + j+1] = table_[i*(side_+1) + j+1] + rowSum;
+            }
+         }
+
+         for(size_t k=0; k<size(); ++k)
+         {
+            const Variable& v = variables_[k];
+            switch ( v.kind )
+            {
+               case kSum:
+                  out[k] = sum(v.e0, v.e1, v.p0, v.p1);
+                  break;
+               case kMaxSum:
+               {
+                  double best = 0.;
+                  for(int e=v.e0; e+v.a-1<=v.e1; ++e)
+                     for(int p=v.p0; p+v.b-1<=v.p1; ++p)
+                        best = std::max(best, sum(e, e+v.a-1, p, p+v.b-1));
+                  out[k] = best;
+                  break;
+               }
+               case kCount:
+               {
+                  int n = 0;
+                  forEach(v, [&n, &v](float pt) { n += pt > v.threshold; });
+                  out[k] = n;
+                  break;
+               }
+               case kRank:
+               {
+                  values_.clear();
+                  forEach(v, [this](float pt) { if ( pt > 0. ) values_.push_back(pt); });
+                  if ( int(values_.size()) < v.a ) out[k] = 0.;
+                  else
+                  {
+                     std::nth_element(values_.begin(), values_.begin() + v.a-1, values_.end(), std::greater<float>());
+                     out[k] = values_[v.a-1];
+                  }
+                  break;
+               }
+               case kRun:
+               {
+                  int length = 0;
+                  if ( sum(v.e0, v.e1, 0, 0) > v.threshold )
+                  {
+                     length = 1;
+                     for(int p=1; p<=v.a && sum(v.e0, v.e1, p, p) > v.threshold; ++p) length++;
+                     for(int p=1; p<=v.a && sum(v.e0, v.e1, -p, -p) > v.threshold; ++p) length++;
+                  }
+                  out[k] = length;
+                  break;
+               }
+               case kRatio:
+                  out[k] = ( out[v.b] != 0. ) ? out[v.a]/out[v.b] : 0.;
+                  break;
+            }
+         }
+      };
+
+   private:
+      Variable parse(const std::string& definition) const
+      {
+         const size_t eq = definition.find('=');
+         if ( eq == std::string::npos ) throw std::invalid_argument("ShowerShapeEngine: '"+definition+"' is not name=kind:args");
+         Variable v;
+         v.name = definition.substr(0, eq);
+         const std::string spec = definition.substr(eq+1);
+         const char * s = spec.c_str();
+         char a[64], b[64];
+         int n = 0;
+         bool ok = false;
+         if ( sscanf(s, "sum:%d:%d:%d:%d%n", &v.e0, &v.e1, &v.p0, &v.p1, &n) == 4 )
+         {
+            v.kind = kSum;
+            ok = true;
+         }
+         else if ( sscanf(s, "maxsum:%d:%d:%d:%d:%d:%d%n", &v.e0, &v.e1, &v.p0, &v.p1, &v.a, &v.b, &n) == 6 )
+         {
+            v.kind = kMaxSum;
+            ok = v.a >= 1 && v.b >= 1 && v.a <= v.e1-v.e0+1 && v.b <= v.p1-v.p0+1;
+         }
+         else if ( sscanf(s, "count:%d:%d:%d:%d:%g%n", &v.e0, &v.e1, &v.p0, &v.p1, &v.threshold, &n) == 5 )
+         {
+            v.kind = kCount;
+            ok = true;
+         }
+         else if ( sscanf(s, "rank:%d:%d:%d:%d:%d%n", &v.e0, &v.e1, &v.p0, &v.p1, &v.a, &n) == 5 )
+         {
+            v.kind = kRank;
+            ok = v.a >= 1;
+         }
+         else if ( sscanf(s, "run:%d:%d:%d:%g%n", &v.e0, &v.e1, &v.a, &v.threshold, &n) == 4 )
+         {
+            v.kind = kRun;
+            v.p0 = -v.a;
+            v.p1 = v.a;
+            ok = v.a >= 0;
+         }
+         else if ( sscanf(s, "ratio:%63[^:]:%63s%n", a, b, &n) == 2 )
+         {
+            v.kind = kRatio;
+            v.a = find(a);
+            v.b = find(b);
+            ok = v.a >= 0 && v.b >= 0;
+         }
+         if ( !ok || n != int(spec.size()) || v.e0 > v.e1 || v.p0 > v.p1 )
+            throw std::invalid_argument("ShowerShapeEngine: bad definition '"+definition+"'");
+         return v;
+      };
+
+      int find(const std::string& name) const
+      {
+         for(size_t i=0; i<variables_.size(); ++i)
+            if ( variables_[i].name == name ) return i;
+         return -1;
+      };
+
+      inline void set(int row, int column, float pt)
+      {
+         const int cell = row*columns_ + column;
+         grid_[cell] = pt;
+         written_.push_back(cell);
+      };
+
+      // Window sum from the summed-area table, offsets relative to the seed
+      inline double sum(int e0, int e1, int p0, int p1) const
+      {
+         const int stride = side_+1;
+         const int i0 = e0+reach_, i1 = e1+reach_+1, j0 = p0+reach_, j1 = p1+reach_+1;
+         return table_[i1*stride+j1] - table_[i0*stride+j1] - table_[i1*stride+j0] + table_[i0*stride+j0];
+      };
+
+      template<typename Function>
+      void forEach(const Variable& v, Function fn) const
+      {
+         for(int e=v.e0; e<=v.e1; ++e)
+            for(int p=v.p0; p<=v.p1; ++p) fn(patch_[(e+reach_)*side_ + p+reach_]);
+      };
+
+      std::vector<Variable> variables_;
+      int reach_ = 0;
+      int side_ = 1;
+      int rows_ = 0;
+      int columns_ = 0;
+      // Barrel pt, [contiguous ieta + kMaxIEta + reach][iphi-1 + reach]
+      std::vector<float> grid_;
+      std::vector<int> written_;
+      // Block around the current seed and its summed-area table (row and column 0 stay zero)
+      std::vector<float> patch_;
+      std::vector<double> table_;
+      std::vector<float> values_;
+};
+
+} // namespace l1eg
+
+#endif
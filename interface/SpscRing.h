@@ -0,0 +1,125 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_SpscRing_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_SpscRing_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::SpscRing SpscRing.h SLHCUpgradeSimulations/L1EGRateStudies/interface/SpscRing.h
+
+ Description: Single-producer single-consumer ring of records, drained by its own thread
+
+ Implementation:
+     The producer takes the next free slot with claim(), writes the record
+     in place and makes it visible with publish(); claim() returns nullptr
+     when the ring is full and the caller decides whether to drop or wait.
+     The consumer thread started by start() hands every published record to
+     the consume function, in publish order, and frees its slot right after,
+     so sync() returns once everything published has been consumed.  When
+     the ring is empty the thread yields `spins` times, then sleeps `idle`
+     between polls.  stop() consumes whatever was published before it and
+     joins the thread.  Slots are copies of the prototype given to start(),
+     so records with vector members of fixed size are reused without
+     allocating.  Shared by DiagnosticLog and AsyncTreeWriter.
+*/
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace l1eg {
+
+template<typename Record>
+class SpscRing
+{
+   public:
+      SpscRing() {};
+      ~SpscRing() { stop(); };
+
+      SpscRing(const SpscRing&) = delete;
+      SpscRing& operator=(const SpscRing&) = delete;
+
+      // capacity: records in flight, rounded up to a power of 2
+      void start(size_t capacity, const Record& prototype, std::function<void(const Record&)> consume,
+                 unsigned spins, std::chrono::microseconds idle)
+      {
+         if ( consumer_.joinable() ) return;
+         size_t size = 1;
+         while ( size < capacity ) size <<= 1;
+         ring_.assign(size, prototype);
+         mask_ = size-1;
+         consume_ = consume;
+         spins_ = spins;
+         idle_ = idle;
+         running_ = true;
+         consumer_ = std::thread(&SpscRing::drain, this);
+      };
+
+      // Consumes everything published so far and joins the thread
+      void stop()
+      {
+         if ( !consumer_.joinable() ) return;
+         running_ = false;
+         consumer_.join();
+      };
+
+      bool started() const { return consumer_.joinable(); };
+
+      // Producer side: slot for the next record, nullptr if the ring is full
+      inline Record * claim()
+      {
+         const size_t head = head_.load(std::memory_order_relaxed);
+         if ( head - tail_.load(std::memory_order_acquire) > mask_ ) return nullptr;
+         return &ring_[head & mask_];
+      };
+
+      inline void publish() { head_.store(head_.load(std::memory_order_relaxed)+1, std::memory_order_release); };
+
+      // Producer side: returns once every published record has been consumed
+      void sync() const
+      {
+         if ( !consumer_.joinable() ) return;
+         const size_t head = head_.load(std::memory_order_relaxed);
+         while ( tail_.load(std::memory_order_acquire) != head ) std::this_thread::yield();
+      };
+
+   private:
+      void drain()
+      {
+         unsigned idle = 0;
+         while ( true )
+         {
+            // Read the flag before the queue, so nothing pushed before stop() is missed
+            const bool stopping = !running_.load(std::memory_order_acquire);
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            const size_t head = head_.load(std::memory_order_acquire);
+            if ( tail != head ) idle = 0;
+            for(; tail != head; ++tail)
+            {
+               consume_(ring_[tail & mask_]);
+               tail_.store(tail+1, std::memory_order_release);
+            }
+            if ( stopping ) break;
+            if ( ++idle <= spins_ ) std::this_thread::yield();
+            else std::this_thread::sleep_for(idle_);
+         }
+      };
+
+      std::vector<Record> ring_;
+      size_t mask_ = 0;
+      std::function<void(const Record&)> consume_;
+      unsigned spins_ = 0;
+      std::chrono::microseconds idle_{0};
+
+      std::atomic<size_t> head_{0};
+      std::atomic<size_t> tail_{0};
+      std::atomic<bool> running_{false};
+      std::thread consumer_;
+};
+
+} // namespace l1eg
+
+#endif
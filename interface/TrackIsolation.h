@@ -0,0 +1,115 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_TrackIsolation_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_TrackIsolation_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::TrackIsolation TrackIsolation.h SLHCUpgradeSimulations/L1EGRateStudies/interface/TrackIsolation.h
+
+ Description: Track isolation sums for a ladder of cone sizes, inner veto radii and pt floors
+
+ Implementation:
+     The dR^2 of every track to the isolation axis is computed in one
+     batched loop (DeltaRMatcher).  Each track inside the largest cone is
+     then binned once: the smallest cone containing it, the largest veto
+     radius it is outside of, and the highest pt floor it is above.  Prefix
+     sums over the three bin axes turn these exclusive bins into the
+     count and pt sum for every (veto, floor, cone) combination, so the cost
+     is one pass over the tracks plus a pass over the ladder, whatever
+     its size.  Results are flat arrays indexed by index(veto, floor, cone).
+*/
+//
+
+#include <algorithm>
+#include <vector>
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/DeltaRMatching.h"
+
+namespace l1eg {
+
+class TrackIsolation
+{
+   public:
+      // Cones and vetoes are radii in dR, floors are track pt in GeV.  All are sorted here
+      TrackIsolation(const std::vector<double>& cones, const std::vector<double>& vetoes, const std::vector<double>& ptFloors) :
+         cones_(begin(cones), end(cones)), vetoes_(begin(vetoes), end(vetoes)), floors_(begin(ptFloors), end(ptFloors))
+      {
+         std::sort(begin(cones_), end(cones_));
+         std::sort(begin(vetoes_), end(vetoes_));
+         std::sort(begin(floors_), end(floors_));
+         for(float c : cones_) cone2_.push_back(c*c);
+         for(float v : vetoes_) veto2_.push_back(v*v);
+         count_.resize(size());
+         ptSum_.resize(size());
+      };
+
+      size_t size() const { return cones_.size()*vetoes_.size()*floors_.size(); };
+      size_t index(size_t veto, size_t floor, size_t cone) const { return (veto*floors_.size() + floor)*cones_.size() + cone; };
+
+      const std::vector<float>& cones() const { return cones_; };
+      const std::vector<float>& vetoes() const { return vetoes_; };
+      const std::vector<float>& ptFloors() const { return floors_; };
+
+      // Tracks with dR < cone, dR >= veto and pt > floor around (eta, phi).
+      // The track at index exclude, e.g. the one matched to the cluster, is not counted
+      void compute(const EtaPhiArray& tracks, const std::vector<float>& trackPt, float eta, float phi, int exclude = -1)
+      {
+         std::fill(begin(count_), end(count_), 0.f);
+         std::fill(begin(ptSum_), end(ptSum_), 0.f);
+         const std::vector<float>& dr2 = dr_.compute(tracks, eta, phi);
+         if ( size() == 0 ) return;
+
+         const float maxCone2 = cone2_.back();
+         for(size_t t=0; t<dr2.size(); ++t)
+         {
+            if ( dr2[t] >= maxCone2 || int(t) == exclude ) continue;
+            // Smallest cone with dR < cone
+            const size_t c = std::upper_bound(begin(cone2_), end(cone2_), dr2[t]) - begin(cone2_);
+            // Largest veto with dR >= veto, none if inside the smallest
+            const size_t nVetoed = std::upper_bound(begin(veto2_), end(veto2_), dr2[t]) - begin(veto2_);
+            // Highest floor with pt > floor
+            const size_t nBelow = std::lower_bound(begin(floors_), end(floors_), trackPt[t]) - begin(floors_);
+            if ( nVetoed == 0 || nBelow == 0 ) continue;
+            const size_t i = index(nVetoed-1, nBelow-1, c);
+            count_[i] += 1.f;
+            ptSum_[i] += trackPt[t];
+         }
+
+         // A track in cone c is in every larger cone, a track outside veto v is outside every
+         // smaller veto, and a track above floor f is above every lower floor
+         const size_t nVeto = vetoes_.size(), nFloor = floors_.size(), nCone = cones_.size();
+         for(size_t v=0; v<nVeto; ++v)
+            for(size_t f=0; f<nFloor; ++f)
+               for(size_t c=1; c<nCone; ++c)
+                  accumulate(index(v, f, c), index(v, f, c-1));
+         for(size_t v=0; v<nVeto; ++v)
+            for(size_t f=nFloor-1; f>0; --f)
+               for(size_t c=0; c<nCone; ++c)
+                  accumulate(index(v, f-1, c), index(v, f, c));
+         for(size_t v=nVeto-1; v>0; --v)
+            for(size_t f=0; f<nFloor; ++f)
+               for(size_t c=0; c<nCone; ++c)
+                  accumulate(index(v-1, f, c), index(v, f, c));
+      };
+
+      const std::vector<float>& count() const { return count_; };
+      const std::vector<float>& ptSum() const { return ptSum_; };
+      // dR^2 of every track to the axis of the last compute()
+      const std::vector<float>& dr2() const { return dr_.dr2(); };
+
+   private:
+      void accumulate(size_t to, size_t from)
+      {
+         count_[to] += count_[from];
+         ptSum_[to] += ptSum_[from];
+      };
+
+      std::vector<float> cones_, vetoes_, floors_;
+      std::vector<float> cone2_, veto2_;
+      std::vector<float> count_, ptSum_;
+      DeltaRMatcher dr_;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_TruthMatching_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_TruthMatching_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\file TruthMatching.h SLHCUpgradeSimulations/L1EGRateStudies/interface/TruthMatching.h
+
+ Description: One-to-one assignment of truth particles to L1 objects
+
+ Implementation:
+     The L1 objects are binned in a uniform eta-phi grid whose cells are at
+     least maxDR wide, so every partner within maxDR of a truth particle is
+     in the 3x3 cells around it.  All (truth, L1) pairs within maxDR that the
+     caller accepts are collected, sorted by dR, and assigned greedily: the
+     closest remaining pair wins, and both sides are then taken.  The cost
+     is O(truth + L1 + pairs log pairs) rather than O(truth x L1).
+*/
+//
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/DeltaRMatching.h"
+
+namespace l1eg {
+
+class EtaPhiGrid
+{
+   public:
+      // Bins the points, cells are at least cellSize wide in eta and phi
+      void build(const EtaPhiArray& points, float cellSize)
+      {
+         const size_t n = points.size();
+         etaMin_ = 0.;
+         float etaMax = 0.;
+         for(size_t i=0; i<n; ++i)
+         {
+            etaMin_ = std::min(etaMin_, points.eta()[i]);
+            etaMax = std::max(etaMax, points.eta()[i]);
+         }
+         cellSize_ = cellSize;
+         nEta_ = int((etaMax-etaMin_)/cellSize) + 1;
+         nPhi_ = std::max(1, int(2*M_PI/cellSize));
+
+         // Compressed rows: entries_[cellStart_[c] .. cellStart_[c+1]) are the points in cell c
+         cell_.resize(n);
+         cellStart_.assign(nEta_*nPhi_+1, 0);
+         for(size_t i=0; i<n; ++i)
+         {
+            cell_[i] = etaBin(points.eta()[i])*nPhi_ + phiBin(points.phi()[i]);
+            cellStart_[cell_[i]+1]++;
+         }
+         for(size_t c=1; c<cellStart_.size(); ++c) cellStart_[c] += cellStart_[c-1];
+         entries_.resize(n);
+         fill_.assign(begin(cellStart_), end(cellStart_)-1);
+         for(size_t i=0; i<n; ++i) entries_[fill_[cell_[i]]++] = i;
+      };
+
+      // Calls fn(index) for every point in the cells around (eta, phi), each at most once
+      template<typename Function>
+      void forEachNear(float eta, float phi, Function fn) const
+      {
+         if ( entries_.empty() ) return;
+         const int ie = etaBin(eta);
+         const int ip = phiBin(phi);
+         // With fewer than 3 phi cells the neighbours would repeat, take the whole ring
+         const int phiRange = (nPhi_ < 3) ? 0 : 1;
+         for(int dEta=-1; dEta<=1; ++dEta)
+         {
+            const int e = ie + dEta;
+            if ( e < 0 || e >= nEta_ ) continue;
+            for(int dPhi=-phiRange; dPhi<=phiRange; ++dPhi)
+            {
+               const int pFirst = (phiRange == 0) ? 0 : (ip + dPhi + nPhi_) % nPhi_;
+               const int pLast = (phiRange == 0) ? nPhi_-1 : pFirst;
+               for(int p=pFirst; p<=pLast; ++p)
+               {
+                  const int c = e*nPhi_ + p;
+                  for(unsigned k=cellStart_[c]; k<cellStart_[c+1]; ++k) fn(entries_[k]);
+               }
+            }
+         }
+      };
+
+   private:
+      int etaBin(float eta) const { return std::min(nEta_-1, std::max(0, int((eta-etaMin_)/cellSize_))); };
+      int phiBin(float phi) const { return std::min(nPhi_-1, std::max(0, int((phi+M_PI)/(2*M_PI)*nPhi_))); };
+
+      float etaMin_ = 0.;
+      float cellSize_ = 1.;
+      int nEta_ = 1;
+      int nPhi_ = 1;
+      std::vector<unsigned> cell_;
+      std::vector<unsigned> cellStart_;
+      std::vector<unsigned> fill_;
+      std::vector<unsigned> entries_;
+};
+
+class OneToOneMatcher
+{
+   public:
+      // After match(), the candidate index assigned to each truth particle, -1 if none.
+      // accept(truthIndex, candidateIndex) can veto pairs, e.g. with a relative pt cut
+      template<typename Accept>
+      const std::vector<int>& match(const EtaPhiArray& truth, const EtaPhiArray& candidates, float maxDR, Accept accept)
+      {
+         assignment_.assign(truth.size(), -1);
+         taken_.assign(candidates.size(), false);
+         pairs_.clear();
+         if ( truth.size() == 0 || candidates.size() == 0 ) return assignment_;
+
+         grid_.build(candidates, maxDR);
+         const float maxDR2 = maxDR*maxDR;
+         for(unsigned t=0; t<truth.size(); ++t)
+         {
+            const float eta = truth.eta()[t];
+            const float phi = truth.phi()[t];
+            grid_.forEachNear(eta, phi, [&](unsigned c) {
+               const float dr2 = deltaR2(eta, phi, candidates.eta()[c], candidates.phi()[c]);
+               if ( dr2 < maxDR2 && accept(t, c) ) pairs_.push_back(Pair{dr2, t, c});
+            });
+         }
+
+         // Ties are broken by truth then candidate index, so the assignment is reproducible
+         std::sort(begin(pairs_), end(pairs_), [](const Pair& a, const Pair& b){
+            return (a.dr2 != b.dr2) ? a.dr2 < b.dr2 : (a.truth != b.truth) ? a.truth < b.truth : a.candidate < b.candidate;
+         });
+         for(const auto& pair : pairs_)
+         {
+            if ( assignment_[pair.truth] >= 0 || taken_[pair.candidate] ) continue;
+            assignment_[pair.truth] = pair.candidate;
+            taken_[pair.candidate] = true;
+         }
+         return assignment_;
+      };
+
+      const std::vector<int>& match(const EtaPhiArray& truth, const EtaPhiArray& candidates, float maxDR)
+      {
+         return match(truth, candidates, maxDR, [](unsigned, unsigned){return true;});
+      };
+
+      int operator[](size_t truthIndex) const { return assignment_[truthIndex]; };
+
+   private:
+      struct Pair {
+         float dr2;
+         unsigned truth;
+         unsigned candidate;
+      };
+
+      EtaPhiGrid grid_;
+      std::vector<Pair> pairs_;
+      std::vector<int> assignment_;
+      std::vector<bool> taken_;
+};
+
+} // namespace l1eg
+
+#endif
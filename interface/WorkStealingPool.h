@@ -0,0 +1,135 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_WorkStealingPool_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_WorkStealingPool_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::WorkStealingPool WorkStealingPool.h SLHCUpgradeSimulations/L1EGRateStudies/interface/WorkStealingPool.h
+
+ Description: Runs a fixed set of independent tasks on N threads, idle threads steal work
+
+ Implementation:
+     Tasks are numbered 0..n-1 and dealt out to the workers in contiguous
+     blocks, so neighbouring tasks (e.g. event ranges of the same file) run
+     on the same thread.  Each worker takes tasks from the front of its own
+     queue; when it is empty it steals the back half of another worker's
+     queue.  No task creates new tasks, so a worker that finds every queue
+     empty is done.  The first exception thrown by a task is rethrown by
+     run() once all threads have stopped.
+*/
+//
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace l1eg {
+
+class WorkStealingPool
+{
+   public:
+      // 0 threads: one per hardware thread
+      explicit WorkStealingPool(unsigned nThreads) :
+         nThreads_(nThreads > 0 ? nThreads : std::max(1u, std::thread::hardware_concurrency()))
+      {};
+
+      unsigned size() const { return nThreads_; };
+      // Tasks moved between workers in the last run()
+      size_t steals() const { return steals_; };
+
+      // Calls fn(task, worker) for every task in [0, nTasks), worker in [0, size())
+      template<typename F>
+      void run(size_t nTasks, F fn)
+      {
+         queues_.clear();
+         for(unsigned w=0; w<nThreads_; ++w) queues_.emplace_back(new Queue);
+         for(size_t t=0; t<nTasks; ++t) queues_[t*nThreads_/std::max<size_t>(nTasks, 1)]->tasks.push_back(t);
+         steals_ = 0;
+         failed_ = false;
+         error_ = nullptr;
+
+         std::vector<std::thread> threads;
+         for(unsigned w=0; w<nThreads_; ++w)
+            threads.emplace_back([this, w, &fn]() { work(w, fn); });
+         for(auto& thread : threads) thread.join();
+         if ( error_ ) std::rethrow_exception(error_);
+      };
+
+   private:
+      struct Queue {
+         std::mutex lock;
+         std::deque<size_t> tasks;
+      };
+
+      template<typename F>
+      void work(unsigned w, F& fn)
+      {
+         size_t task;
+         while ( !failed_ && next(w, task) )
+         {
+            try
+            {
+               fn(task, w);
+            }
+            catch(...)
+            {
+               std::lock_guard<std::mutex> guard(errorLock_);
+               if ( !error_ ) error_ = std::current_exception();
+               failed_ = true;
+            }
+         }
+      };
+
+      bool next(unsigned w, size_t& task)
+      {
+         {
+            Queue& own = *queues_[w];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if ( !own.tasks.empty() )
+            {
+               task = own.tasks.front();
+               own.tasks.pop_front();
+               return true;
+            }
+         }
+         for(unsigned i=1; i<nThreads_; ++i)
+         {
+            Queue& victim = *queues_[(w+i) % nThreads_];
+            std::deque<size_t> stolen;
+            {
+               std::lock_guard<std::mutex> guard(victim.lock);
+               const size_t n = (victim.tasks.size()+1)/2;
+               if ( n == 0 ) continue;
+               stolen.assign(victim.tasks.end()-n, victim.tasks.end());
+               victim.tasks.erase(victim.tasks.end()-n, victim.tasks.end());
+            }
+            steals_ += stolen.size();
+            task = stolen.front();
+            stolen.pop_front();
+            if ( !stolen.empty() )
+            {
+               Queue& own = *queues_[w];
+               std::lock_guard<std::mutex> guard(own.lock);
+               own.tasks.insert(own.tasks.end(), stolen.begin(), stolen.end());
+            }
+            return true;
+         }
+         return false;
+      };
+
+      unsigned nThreads_;
+      std::vector<std::unique_ptr<Queue>> queues_;
+      std::atomic<size_t> steals_{0};
+      std::atomic<bool> failed_{false};
+      std::mutex errorLock_;
+      std::exception_ptr error_;
+};
+
+} // namespace l1eg
+
+#endif
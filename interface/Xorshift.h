@@ -0,0 +1,42 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_Xorshift_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_Xorshift_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\class l1eg::Xorshift Xorshift.h SLHCUpgradeSimulations/L1EGRateStudies/interface/Xorshift.h
+
+ Description: Small fixed-seed pseudo-random generator for the sampling in the output summaries
+
+ Implementation:
+     64-bit xorshift (13, 7, 17).  Every instance starts from the same
+     seed, so a rerun over the same input makes the same choices and gives
+     the same output (QuantileSketch compactions, HeatmapReservoir windows).
+     Not for anything that needs statistical quality beyond that.
+*/
+//
+
+#include <cstdint>
+
+namespace l1eg {
+
+class Xorshift
+{
+   public:
+      explicit Xorshift(uint64_t seed = 0x9e3779b97f4a7c15ull) : state_(seed) {};
+
+      uint64_t operator()()
+      {
+         state_ ^= state_ << 13;
+         state_ ^= state_ >> 7;
+         state_ ^= state_ << 17;
+         return state_;
+      };
+
+   private:
+      uint64_t state_;
+};
+
+} // namespace l1eg
+
+#endif
@@ -0,0 +1,440 @@
+// -*- C++ -*-
+//
+// Package:    L1EGCrystalsHeatMap
+// Class:      L1EGCrystalsHeatMap
+// 
+/**\class L1EGCrystalsHeatMap L1EGCrystalsHeatMap.cc SLHCUpgradeSimulations/L1EGRateStudies/plugins/L1EGCrystalsHeatMap.cc
+
+ Description: [one line class summary]
+
+ Implementation:
+     [Notes on implementation]
+*/
+//
+// Original Author:  Nick Smith
+//         Created:  Mon Apr  7 19:20:22 CDT 2014
+// $Id$
+//
+//
+
+
+// system include files
+#include <memory>
+
+// user include files
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/EDAnalyzer.h"
+
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+
+#include "SimDataFormats/Track/interface/SimTrackContainer.h"
+#include "DataFormats/L1Trigger/interface/L1EmParticle.h"
+#include "DataFormats/L1Trigger/interface/L1EmParticleFwd.h"
+#include "DataFormats/Math/interface/deltaR.h"
+#include "DataFormats/Math/interface/deltaPhi.h"
+
+#include "FWCore/Framework/interface/ESHandle.h"
+#include "SimDataFormats/CaloHit/interface/PCaloHitContainer.h"
+#include "FWCore/ServiceRegistry/interface/Service.h"
+
+#include "Geometry/CaloEventSetup/interface/CaloTopologyRecord.h"
+#include "Geometry/Records/interface/CaloGeometryRecord.h"
+#include "Geometry/CaloGeometry/interface/CaloSubdetectorGeometry.h"
+
+#include "Geometry/CaloGeometry/interface/CaloGeometry.h"
+#include "Geometry/EcalAlgo/interface/EcalBarrelGeometry.h"
+#include "Geometry/EcalAlgo/interface/EcalEndcapGeometry.h"
+#include "Geometry/CaloGeometry/interface/CaloCellGeometry.h"
+#include <iostream>
+
+#include "DataFormats/EcalRecHit/interface/EcalRecHit.h"
+#include "DataFormats/EcalRecHit/interface/EcalRecHitCollections.h"
+#include "FastSimulation/CaloGeometryTools/interface/CaloGeometryHelper.h"
+#include "SimDataFormats/SLHC/interface/L1EGCrystalCluster.h"
+#include "Geometry/CaloTopology/interface/CaloTopology.h"
+
+#include "Geometry/CommonDetUnit/interface/GeomDet.h"
+#include "Geometry/Records/interface/TrackerDigiGeometryRecord.h"
+#include "SimDataFormats/CaloTest/interface/HcalTestNumbering.h"
+#include "DataFormats/HcalDetId/interface/HcalSubdetector.h"
+#include "DataFormats/HcalDetId/interface/HcalDetId.h"
+
+#include "DataFormats/HepMCCandidate/interface/GenParticle.h"
+#include "DataFormats/HepMCCandidate/interface/GenParticleFwd.h"
+
+#include "DataFormats/HcalRecHit/interface/HcalRecHitCollections.h"
+#include "DataFormats/HcalRecHit/interface/HcalSourcePositionData.h"
+
+#include "DataFormats/EgammaReco/interface/SuperCluster.h"
+#include "DataFormats/EgammaReco/interface/SuperClusterFwd.h"
+
+#include "CommonTools/UtilAlgos/interface/TFileService.h"
+#include "TTree.h"
+#include "TH1.h"
+#include "TH2.h"
+#include "TVector3.h"
+#include "TRandom3.h"
+
+#include "FastSimulation/BaseParticlePropagator/interface/BaseParticlePropagator.h"
+#include "FastSimulation/Particle/interface/ParticleTable.h"
+
+#include "DataFormats/EcalDigi/interface/EcalDigiCollections.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/DeltaRMatching.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/DiagnosticLog.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/EBTriggerTowerMap.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/HeatmapReservoir.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/CrystalHitStore.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/L1EGEventContext.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/QuantileSketch.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ScratchArena.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/TruthMatching.h"
+//
+// class declaration
+//
+
+class L1EGCrystalsHeatMap : public edm::EDAnalyzer {
+   public:
+      explicit L1EGCrystalsHeatMap(const edm::ParameterSet&);
+      ~L1EGCrystalsHeatMap();
+
+      static void fillDescriptions(edm::ConfigurationDescriptions& descriptions);
+
+
+   private:
+      typedef l1eg::CaloHit SimpleCaloHit;
+      virtual void beginJob() ;
+      virtual void analyze(const edm::Event&, const edm::EventSetup&);
+      virtual void endJob() ;
+
+      virtual void beginRun(edm::Run const&, edm::EventSetup const&);
+      void fillHeatmap(std::string name, const SimpleCaloHit &centerHit);
+      const SimpleCaloHit& findClosestHit(const reco::Candidate &cluster);
+      const SimpleCaloHit& findClosestHit(const l1slhc::L1EGCrystalCluster &cluster);
+
+      // ----------member data ---------------------------
+      int range_;
+      bool useEndcap;
+      bool useOfflineClusters;
+      bool kDebug;
+      bool kUseGenMatch;
+      bool kSaveAllClusters;
+      double kClusterPtCut; 
+      edm::InputTag L1CrystalClustersInputTag;
+      edm::InputTag L1EGContextInputTag;
+      std::vector<edm::InputTag> L1EGammaOtherAlgs;
+      std::map<std::string, TH2F*> heatmaps_;
+      TH1I * fakeStatus;
+      TH2F * crystalTowerComparison;
+      std::map<std::string, int> heatmap_nevents_;
+      // Bounded sample of saveAllClusters windows (see HeatmapReservoir.h)
+      std::unique_ptr<l1eg::HeatmapReservoir> allClusters_;
+      // Points into the current event's l1eg::EventContext
+      const l1eg::CrystalHitStore * ecalhits_ = nullptr;
+      // Per-event scratch memory, reset at the start of each event
+      l1eg::ScratchArena scratch_;
+      // Batched dR matching, buffers reused across events
+      l1eg::EtaPhiArray clusterEtaPhi_;
+      l1eg::EtaPhiArray otherAlgEtaPhi_;
+      l1eg::EtaPhiArray hitEtaPhi_;
+      l1eg::DeltaRMatcher matcher_;
+      // Truth particles in acceptance and their one-to-one cluster match
+      std::vector<reco::Candidate::PolarLorentzVector> trueParticles_;
+      l1eg::EtaPhiArray trueEtaPhi_;
+      l1eg::OneToOneMatcher oneToOne_;
+      // Event-keyed debug records, written by a background thread (see DiagnosticLog.h)
+      enum DiagnosticCategory { kFindMe, kFakeNoOldAlgMatch, kFakeTower, kFakeTowerHit, kFakeTowerSum };
+      l1eg::DiagnosticLog diagnostics_;
+      std::string diagnosticsFile_;
+      std::vector<std::string> diagnosticsCategories_;
+      unsigned diagnosticsPrescale_;
+      unsigned diagnosticsMaxPerCategory_;
+      // Quantile sketches of crystalTowerComparison's axes (see QuantileSketch.h)
+      l1eg::QuantileSketchSet sketches_;
+      std::unique_ptr<TRandom3> rng;
+};
+
+//
+// constants, enums and typedefs
+//
+
+//
+// static data member definitions
+//
+
+//
+// constructors and destructor
+//
+L1EGCrystalsHeatMap::L1EGCrystalsHeatMap(const edm::ParameterSet& iConfig):
+   range_(iConfig.getUntrackedParameter<int>("range", 10)),
+   useEndcap(iConfig.getUntrackedParameter<bool>("useEndcap", false)),
+   useOfflineClusters(iConfig.getUntrackedParameter<bool>("useOfflineClusters", false)),
+   kDebug(iConfig.getUntrackedParameter<bool>("debug", false)),
+   kUseGenMatch(iConfig.getUntrackedParameter<bool>("useGenMatch", true)),
+   kSaveAllClusters(iConfig.getUntrackedParameter<bool>("saveAllClusters", false)),
+   kClusterPtCut(iConfig.getUntrackedParameter<double>("clusterPtCut", 10.)),
+   diagnostics_({"findMe", "fakeNoOldAlgMatch", "fakeTower", "fakeTowerHit", "fakeTowerSum"}),
+   diagnosticsFile_(iConfig.getUntrackedParameter<std::string>("diagnosticsFile", "")),
+   diagnosticsCategories_(iConfig.getUntrackedParameter<std::vector<std::string>>("diagnosticsCategories", std::vector<std::string>())),
+   diagnosticsPrescale_(iConfig.getUntrackedParameter<unsigned>("diagnosticsPrescale", 1)),
+   diagnosticsMaxPerCategory_(iConfig.getUntrackedParameter<unsigned>("diagnosticsMaxPerCategory", 0)),
+   sketches_(iConfig.getUntrackedParameter<unsigned>("quantileSketchSize", 200))
+{
+   if ( kDebug && diagnosticsFile_.empty() ) diagnosticsFile_ = "L1EGCrystalsHeatMap_diagnostics.jsonl";
+   L1CrystalClustersInputTag = iConfig.getParameter<edm::InputTag>("L1CrystalClustersInputTag");
+   L1EGContextInputTag = iConfig.getParameter<edm::InputTag>("L1EGContextInputTag");
+   L1EGammaOtherAlgs = iConfig.getParameter<std::vector<edm::InputTag>>("L1EGammaOtherAlgs");
+   edm::Service<TFileService> fs;
+   fakeStatus = fs->make<TH1I>("fakeStatus", "Fake statuses", 10, 0, 9);
+   crystalTowerComparison = fs->make<TH2F>("crystalTowerComparison", "Crystal cluster pt vs. nearest tower pt;Cluster pT (GeV);Tower ET (GeV)", 50, 0., 50., 50, 0., 50.);
+   sketches_.track(crystalTowerComparison);
+   if ( kSaveAllClusters )
+      allClusters_.reset(new l1eg::HeatmapReservoir(range_,
+               iConfig.getUntrackedParameter<unsigned>("saveAllClustersSamples", 200),
+               iConfig.getUntrackedParameter<std::vector<double>>("saveAllClustersPtBins", {15., 20., 30., 50.}),
+               iConfig.getUntrackedParameter<std::vector<double>>("saveAllClustersBremBins", std::vector<double>())));
+   rng= std::move(std::unique_ptr<TRandom3>(new TRandom3()));
+ }
+
+
+L1EGCrystalsHeatMap::~L1EGCrystalsHeatMap()
+{
+ 
+   // do anything here that needs to be done at desctruction time
+   // (e.g. close files, deallocate resources etc.)
+
+}
+
+
+//
+// member functions
+//
+
+// ------------ method called for each event  ------------
+void
+L1EGCrystalsHeatMap::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+   using namespace edm;
+   scratch_.reset();
+   diagnostics_.setEvent(iEvent.id().run(), iEvent.id().luminosityBlock(), iEvent.id().event());
+
+   // Shared event context: cluster features, EG candidates, hits with geometry, truth
+   edm::Handle<l1eg::EventContext> contextHandle;
+   iEvent.getByLabel(L1EGContextInputTag, contextHandle);
+   const l1eg::EventContext& context = *contextHandle.product();
+   ecalhits_ = &context.ecalHits;
+
+   // Load EG Crystal clusters
+   edm::Handle<l1slhc::L1EGCrystalClusterCollection> crystalClustersHandle;      
+   iEvent.getByLabel(L1CrystalClustersInputTag,crystalClustersHandle);
+   const l1slhc::L1EGCrystalClusterCollection& crystalClusters = *crystalClustersHandle.product();
+
+   clusterEtaPhi_.clear();
+   for(const auto& features : context.clusterFeatures) clusterEtaPhi_.push_back(features.eta, features.phi);
+
+   // Other algorithm products, only their directions are needed
+   otherAlgEtaPhi_.clear();
+   for(const auto& tag : L1EGammaOtherAlgs)
+   {
+      if ( const auto * collection = context.egCollection(tag.encode()) )
+         for(const auto& candidate : *collection) otherAlgEtaPhi_.push_back(candidate.eta(), candidate.phi());
+   }
+
+   reco::Candidate::PolarLorentzVector trueElectron;
+   if (kUseGenMatch) {
+      // Generated electrons' positions upon entering ECal
+      trueEtaPhi_.clear();
+      trueParticles_.clear();
+      for(const auto& truth : context.truth)
+      {
+         // Don't consider generated electrons in the endcap
+         if ( !useEndcap && fabs(truth.ecal.eta()) > 1.479 ) continue;
+         trueParticles_.push_back(truth.ecal);
+         trueEtaPhi_.push_back(truth.ecal.eta(), truth.ecal.phi());
+      }
+
+      const auto& assignment = oneToOne_.match(trueEtaPhi_, clusterEtaPhi_, 0.1);
+      for(size_t t=0; t<trueParticles_.size(); ++t)
+      {
+         if ( assignment[t] < 0 ) continue;
+         trueElectron = trueParticles_[t];
+         const auto& cluster = crystalClusters[assignment[t]];
+         const auto& features = context.clusterFeatures[assignment[t]];
+         if ( cluster.pt() < 20. && trueElectron.pt() > 20. )
+         {
+            diagnostics_.log(kFindMe, "clusterPt genPt", {float(cluster.pt()), float(trueElectron.pt())});
+            fillHeatmap("cluster_pt<20,gen_pt>20", findClosestHit(cluster));
+         }
+         if ( cluster.pt() < 20. && trueElectron.pt() > 20. && trueElectron.pt() < 30. )
+            fillHeatmap("cluster_pt<20,20<gen_pt<30", findClosestHit(cluster));
+         if ( kSaveAllClusters && (features.param(l1eg::ClusterFeatures::kUncorrectedPt)/trueElectron.pt() < 0.6) && cluster.pt() > 15. )
+         {
+            allClusters_->beginSample();
+            ecalhits_->forEachInWindow(findClosestHit(cluster), range_, [this](const SimpleCaloHit& ecalhit, int di, int dj) {
+               allClusters_->add(di, dj, ecalhit.pt());
+            });
+            l1eg::HeatmapReservoir::Sample sample;
+            sample.run = iEvent.id().run();
+            sample.lumi = iEvent.id().luminosityBlock();
+            sample.event = iEvent.id().event();
+            sample.pt = cluster.pt();
+            sample.genPt = trueElectron.pt();
+            sample.deltaR = std::sqrt(l1eg::deltaR2(features.eta, features.phi, trueElectron.eta(), trueElectron.phi()));
+            sample.crystalCount = features.param(l1eg::ClusterFeatures::kCrystalCount);
+            sample.bremStrength = features.bremStrength;
+            allClusters_->commit(sample);
+         }
+      }
+   }
+   else // !kUseGenMatch
+   {
+      for(unsigned clusterIndex : l1eg::ptOrdered(context.clusterFeatures, scratch_))
+      {
+         const auto& cluster = crystalClusters[clusterIndex];
+         const auto& features = context.clusterFeatures[clusterIndex];
+         if ( cluster.pt() < kClusterPtCut ) continue;
+         matcher_.compute(otherAlgEtaPhi_, features.eta, features.phi);
+         bool otherAlgMatchFound = matcher_.anyWithin(0.25);
+         if ( features.passes(l1eg::ClusterFeatures::kHeatMap) && !otherAlgMatchFound )
+         {
+            trueElectron = cluster.polarP4();
+            diagnostics_.log(kFakeNoOldAlgMatch, "pt eta phi", {float(cluster.pt()), float(cluster.eta()), float(cluster.phi())});
+
+            // Look at tpgs
+            edm::Handle<EcalTrigPrimDigiCollection> tpgH;
+            iEvent.getByLabel(edm::InputTag("ecalDigis:EcalTriggerPrimitives"), tpgH);
+            const EcalTrigPrimDigiCollection& tpgs = *tpgH.product();
+            auto &seedHit = findClosestHit(cluster);
+            for(const auto& tpg : tpgs)
+            {
+               // Tower lookup is only implemented for the barrel
+               if ( tpg.id().subDet() != EcalBarrel || !seedHit.isBarrel() ) continue;
+               if ( seedHit.tower() == l1eg::eb::towerIndex(tpg.id().ieta(), tpg.id().iphi()) )
+               {
+                  diagnostics_.log(kFakeTower, "towerEt", {float(tpg.compressedEt()*0.5)});
+                  sketches_.fill(crystalTowerComparison, cluster.pt(), tpg.compressedEt()*0.5);
+                  if ( tpg.compressedEt() == 0 )
+                  {
+                     fillHeatmap("crystal_notowerEt", seedHit);
+                     fakeStatus->Fill(1);
+                  }
+                  else
+                  {
+                     fillHeatmap("crystal_towerEt", seedHit);
+                     fakeStatus->Fill(2);
+                  }
+                  double etSum = 0.;
+                  for(const auto& hit : ecalhits_->hits())
+                  {
+                     if ( hit.isBarrel() && hit.tower() == seedHit.tower() )
+                     {
+                        etSum += hit.pt();
+                        diagnostics_.log(kFakeTowerHit, "et", {float(hit.pt())});
+                     }
+                  }
+                  diagnostics_.log(kFakeTowerSum, "etSum", {float(etSum)});
+               }
+            }
+            break;
+         }
+      }
+   }
+}
+
+// ------------ method called once each job just before starting event loop  ------------
+void 
+L1EGCrystalsHeatMap::beginJob()
+{
+   diagnostics_.open(diagnosticsFile_, diagnosticsCategories_, diagnosticsPrescale_, diagnosticsMaxPerCategory_);
+}
+
+// ------------ method called once each job just after ending the event loop  ------------
+void 
+L1EGCrystalsHeatMap::endJob() 
+{
+   std::cout << "L1EGCrystalsHeatMap scratch memory: " << scratch_.summary() << std::endl;
+   diagnostics_.close();
+   if ( !diagnosticsFile_.empty() )
+      std::cout << "L1EGCrystalsHeatMap diagnostics: " << diagnostics_.written() << " records written to " << diagnosticsFile_
+                << ", " << diagnostics_.dropped() << " dropped" << std::endl;
+
+   // Scale heatmaps_ by # events added
+   for(auto& pair : heatmaps_)
+   {
+      auto& name = pair.first;
+      std::cout << "Heatmap " << name << " has " << heatmap_nevents_[name] << " events." << std::endl;
+      if ( heatmap_nevents_[name] > 0 )
+         heatmaps_[name]->Scale(1./heatmap_nevents_[name]);
+   }
+
+   edm::Service<TFileService> fs;
+   sketches_.write(fs->getBareDirectory());
+   if ( allClusters_ )
+   {
+      std::cout << "saveAllClusters reservoir: kept " << allClusters_->kept() << " of " << allClusters_->seen() << " cluster windows in "
+                << allClusters_->strata() << " strata, " << allClusters_->bytes() << " bytes" << std::endl;
+      allClusters_->write(fs->getBareDirectory());
+   }
+}
+
+// ------------ method called when starting to processes a run  ------------
+void 
+L1EGCrystalsHeatMap::beginRun(edm::Run const& iRun, edm::EventSetup const& es)
+{
+   edm::ESHandle<HepPDT::ParticleDataTable> pdt;
+   es.getData(pdt);
+   if ( !ParticleTable::instance() ) ParticleTable::instance(&(*pdt));
+}
+
+void
+L1EGCrystalsHeatMap::fillHeatmap(std::string name, const SimpleCaloHit &centerHit)
+{
+   if ( heatmap_nevents_[name] == 0)
+   {
+      edm::Service<TFileService> fs;
+      heatmaps_[name] = fs->make<TH2F>(name.c_str(), name.c_str(), 2*range_+1, -range_-.5, range_+.5, 2*range_+1, -range_-.5, range_+.5);
+   }
+   heatmap_nevents_[name]++;
+   // (dieta, diphi) in the barrel, (dix, diy) in the endcap
+   TH2F * heatmap = heatmaps_[name];
+   ecalhits_->forEachInWindow(centerHit, range_, [heatmap](const SimpleCaloHit& ecalhit, int di, int dj) {
+      heatmap->Fill(di, dj, ecalhit.pt());
+   });
+}
+
+const L1EGCrystalsHeatMap::SimpleCaloHit&
+L1EGCrystalsHeatMap::findClosestHit(const reco::Candidate &cluster)
+{
+   hitEtaPhi_.clear();
+   for(const auto& ecalhit : ecalhits_->hits()) hitEtaPhi_.push_back(ecalhit.position.eta(), ecalhit.position.phi());
+   matcher_.compute(hitEtaPhi_, cluster.eta(), cluster.phi());
+   const int closest = matcher_.best(999.);
+   const SimpleCaloHit *centerhit = &ecalhits_->hits()[(closest >= 0) ? closest : 0];
+   // centerhit should never be null as long as ecalhits_ has entries
+   return *centerhit;
+}
+
+const L1EGCrystalsHeatMap::SimpleCaloHit&
+L1EGCrystalsHeatMap::findClosestHit(const l1slhc::L1EGCrystalCluster &cluster)
+{
+   const SimpleCaloHit *centerhit = ecalhits_->find(cluster.seedCrystal());
+   if ( centerhit == nullptr ) centerhit = &ecalhits_->hits()[0];
+   // centerhit should never be null as long as ecalhits_ has entries
+   return *centerhit;
+}
+
+// ------------ method fills 'descriptions' with the allowed parameters for the module  ------------
+void
+L1EGCrystalsHeatMap::fillDescriptions(edm::ConfigurationDescriptions& descriptions) {
+  //The following says we do not know what parameters are allowed so do no validation
+  // Please change this to state exactly what you do use, even if it is no parameters
+  edm::ParameterSetDescription desc;
+  desc.setUnknown();
+  descriptions.addDefault(desc);
+}
+
+//define this as a plug-in
+DEFINE_FWK_MODULE(L1EGCrystalsHeatMap);
@@ -0,0 +1,472 @@
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+// Class:      L1EGEventContextProducer
+//
+/**\class L1EGEventContextProducer L1EGEventContextProducer.cc SLHCUpgradeSimulations/L1EGRateStudies/plugins/L1EGEventContextProducer.cc
+
+ Description: Builds the per-event l1eg::EventContext shared by the analyzers
+
+ Implementation:
+     Everything here used to be done independently in each analyzer:
+     reading the cluster experimental params and evaluating the cuts, merging the
+     Run 1 / UCT iso and non-iso collections, resolving rec hit positions
+     and propagating the gen electron to the ECAL.  With helixPropagator the
+     gen particles of an event are propagated together by
+     l1eg::HelixPropagator instead of one BaseParticlePropagator each;
+     helixPropagatorTolerance > 0 runs both and reports where they disagree.
+     Per-particle debug records (helix disagreements, propagated truth) go
+     to a DiagnosticLog file, diagnosticsFile or with debug alone
+     L1EGEventContextProducer_diagnostics.jsonl, not to the terminal.
+     The context is a new product every event, owned by the framework once
+     put, so its containers are still allocated per event: the cluster
+     features, the EG candidate copies and their names, the ECAL and HCAL
+     hits and the truth particles, each reserved up front where its size
+     is known.  The crystal slot table of the ECAL hit builder, the helix
+     batch and the truth inputs are reused across events.
+*/
+//
+// Original Author:  Nick Smith
+//
+//
+
+
+// system include files
+#include <memory>
+
+// user include files
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/EDProducer.h"
+
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/Framework/interface/ESHandle.h"
+#include "FWCore/Framework/interface/EventSetup.h"
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+
+#include "DataFormats/HepMCCandidate/interface/GenParticle.h"
+#include "DataFormats/HepMCCandidate/interface/GenParticleFwd.h"
+#include "SimDataFormats/SLHC/interface/L1EGCrystalCluster.h"
+
+#include "DataFormats/EcalRecHit/interface/EcalRecHit.h"
+#include "DataFormats/EcalRecHit/interface/EcalRecHitCollections.h"
+#include "DataFormats/HcalRecHit/interface/HcalRecHitCollections.h"
+
+#include "Geometry/CaloEventSetup/interface/CaloTopologyRecord.h"
+#include "Geometry/Records/interface/CaloGeometryRecord.h"
+#include "Geometry/CaloGeometry/interface/CaloGeometry.h"
+#include "Geometry/CaloGeometry/interface/CaloSubdetectorGeometry.h"
+#include "Geometry/CaloTopology/interface/CaloTopology.h"
+#include "FastSimulation/CaloGeometryTools/interface/CaloGeometryHelper.h"
+
+#include "FastSimulation/BaseParticlePropagator/interface/BaseParticlePropagator.h"
+#include "FastSimulation/Particle/interface/ParticleTable.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ClusterFeatureExtractor.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/DiagnosticLog.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/L1EGEventContext.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/FixedPointCuts.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/HelixPropagator.h"
+
+//
+// class declaration
+//
+
+class L1EGEventContextProducer : public edm::EDProducer {
+   public:
+      explicit L1EGEventContextProducer(const edm::ParameterSet&);
+      ~L1EGEventContextProducer();
+
+      static void fillDescriptions(edm::ConfigurationDescriptions& descriptions);
+
+   private:
+      virtual void beginJob();
+      virtual void produce(edm::Event&, const edm::EventSetup&);
+      virtual void endJob();
+      virtual void beginRun(edm::Run const&, edm::EventSetup const&);
+
+      void fillCaloHits(const edm::Event&, const edm::EventSetup&, l1eg::EventContext& context);
+      void fillTruth(const edm::Event&, l1eg::EventContext& context);
+      void addTruth(const reco::GenParticle&, l1eg::EventContext& context);
+      void addTruthBatch(l1eg::EventContext& context);
+      BaseParticlePropagator makePropagator(const reco::GenParticle&);
+
+      // ----------member data ---------------------------
+      bool debug;
+      bool makeCaloHits;
+      bool useEndcap;
+      bool doTruth;
+      bool truthAllParticles;
+      double truthMinPt;
+      double truthMaxEta;
+      edm::InputTag L1CrystalClustersInputTag;
+      std::vector<edm::InputTag> L1EGammaInputTags;
+      // Encoded input tags, and the merged "<label>:All" collection each one also goes to ("" if none)
+      std::vector<std::string> egInputNames;
+      std::vector<std::string> egMergedNames;
+      // Events without each input collection, reported on the first one and at the end of the job
+      std::vector<uint64_t> egMissingEvents;
+      CaloGeometryHelper geometryHelper;
+      // Builds the ecalHits store of every event, its slot table reused (see CrystalHitStore.h)
+      l1eg::CrystalHitStoreBuilder ecalHitBuilder;
+      std::unique_ptr<l1eg::ClusterFeatureExtractor> featureExtractor;
+      bool fixedPointEmulation;
+      l1eg::FixedPointCuts::Config fixedPointConfig;
+      std::unique_ptr<l1eg::FixedPointCuts> fixedPointCuts;
+      // Batched gen particle propagation (see HelixPropagator.h)
+      bool helixPropagator;
+      double helixPropagatorTolerance;
+      l1eg::HelixPropagator helix;
+      l1eg::HelixPropagator::Batch helixBatch;
+      std::vector<const reco::GenParticle *> truthInputs;
+      // Comparisons with BaseParticlePropagator: count, beyond tolerance, largest distance (cm)
+      uint64_t helixCompared = 0;
+      uint64_t helixDisagreed = 0;
+      double helixMaxDistance = 0.;
+
+      // Event-keyed debug records, written by a background thread (see DiagnosticLog.h)
+      enum DiagnosticCategory { kHelixDisagreement, kTruthPropagation };
+      l1eg::DiagnosticLog diagnostics;
+      std::string diagnosticsFile;
+      std::vector<std::string> diagnosticsCategories;
+      unsigned diagnosticsPrescale;
+      unsigned diagnosticsMaxPerCategory;
+};
+
+//
+// constructors and destructor
+//
+L1EGEventContextProducer::L1EGEventContextProducer(const edm::ParameterSet& iConfig) :
+   debug(iConfig.getUntrackedParameter<bool>("debug", false)),
+   makeCaloHits(iConfig.getUntrackedParameter<bool>("makeCaloHits", false)),
+   useEndcap(iConfig.getUntrackedParameter<bool>("useEndcap", false)),
+   doTruth(iConfig.getUntrackedParameter<bool>("doTruth", true)),
+   truthAllParticles(iConfig.getUntrackedParameter<bool>("truthAllParticles", false)),
+   truthMinPt(iConfig.getUntrackedParameter<double>("truthMinPt", 5.)),
+   truthMaxEta(iConfig.getUntrackedParameter<double>("truthMaxEta", 3.)),
+   fixedPointEmulation(iConfig.getUntrackedParameter<bool>("fixedPointEmulation", false)),
+   helixPropagator(iConfig.getUntrackedParameter<bool>("helixPropagator", false)),
+   helixPropagatorTolerance(iConfig.getUntrackedParameter<double>("helixPropagatorTolerance", 0.)),
+   diagnostics({"helixDisagreement", "truthPropagation"}),
+   diagnosticsFile(iConfig.getUntrackedParameter<std::string>("diagnosticsFile", "")),
+   diagnosticsCategories(iConfig.getUntrackedParameter<std::vector<std::string>>("diagnosticsCategories", std::vector<std::string>())),
+   diagnosticsPrescale(iConfig.getUntrackedParameter<unsigned>("diagnosticsPrescale", 1)),
+   diagnosticsMaxPerCategory(iConfig.getUntrackedParameter<unsigned>("diagnosticsMaxPerCategory", 0))
+{
+   // debug alone still gets the diagnostics, in a file instead of the terminal
+   if ( debug && diagnosticsFile.empty() ) diagnosticsFile = "L1EGEventContextProducer_diagnostics.jsonl";
+   const l1eg::FixedPointCuts::Config defaults;
+   fixedPointConfig.ptLSB = iConfig.getUntrackedParameter<double>("fixedPointPtLSB", defaults.ptLSB);
+   fixedPointConfig.ptBits = iConfig.getUntrackedParameter<unsigned>("fixedPointPtBits", defaults.ptBits);
+   fixedPointConfig.ratioLSB = iConfig.getUntrackedParameter<double>("fixedPointRatioLSB", defaults.ratioLSB);
+   fixedPointConfig.ratioBits = iConfig.getUntrackedParameter<unsigned>("fixedPointRatioBits", defaults.ratioBits);
+   fixedPointConfig.lutPtLSB = iConfig.getUntrackedParameter<double>("fixedPointLutPtLSB", defaults.lutPtLSB);
+   fixedPointConfig.lutBits = iConfig.getUntrackedParameter<unsigned>("fixedPointLutBits", defaults.lutBits);
+   fixedPointConfig.shapeFractionBits = iConfig.getUntrackedParameter<unsigned>("fixedPointShapeFractionBits", defaults.shapeFractionBits);
+
+   L1CrystalClustersInputTag = iConfig.getParameter<edm::InputTag>("L1CrystalClustersInputTag");
+   L1EGammaInputTags = iConfig.getParameter<std::vector<edm::InputTag>>("L1EGammaInputTags");
+   for(const auto& inputTag : L1EGammaInputTags)
+   {
+      const std::string name = inputTag.encode();
+      egInputNames.push_back(name);
+      // Special case: Run 1, UCT alg. iso/niso are exclusive, we want to make inclusive EGamma available too
+      if ( name.find("l1extraParticlesUCT") != std::string::npos )
+         egMergedNames.push_back("l1extraParticlesUCT:All");
+      else if ( name.find("l1extraParticles") != std::string::npos )
+         egMergedNames.push_back("l1extraParticles:All");
+      else
+         egMergedNames.push_back("");
+   }
+   egMissingEvents.assign(L1EGammaInputTags.size(), 0);
+   produces<l1eg::EventContext>();
+}
+
+
+L1EGEventContextProducer::~L1EGEventContextProducer()
+{
+}
+
+
+//
+// member functions
+//
+
+// ------------ method called once each job just before starting event loop  ------------
+void
+L1EGEventContextProducer::beginJob()
+{
+   featureExtractor.reset(new l1eg::ClusterFeatureExtractor);
+   // Cut tables are filled once here, not per event
+   if ( fixedPointEmulation ) fixedPointCuts.reset(new l1eg::FixedPointCuts(fixedPointConfig));
+   diagnostics.open(diagnosticsFile, diagnosticsCategories, diagnosticsPrescale, diagnosticsMaxPerCategory);
+}
+
+// ------------ method called once each job just after ending the event loop  ------------
+void
+L1EGEventContextProducer::endJob()
+{
+   for(size_t i=0; i<egInputNames.size(); ++i)
+      if ( egMissingEvents[i] > 0 )
+         std::cout << "L1EGEventContextProducer: no product of type " << egInputNames[i] << " in " << egMissingEvents[i] << " events" << std::endl;
+   if ( helixPropagator && helixPropagatorTolerance > 0. )
+      std::cout << "L1EGEventContextProducer helix propagator: " << helixDisagreed << " of " << helixCompared
+                << " gen particles differ from BaseParticlePropagator by more than " << helixPropagatorTolerance
+                << " cm (or reach another surface), largest distance " << helixMaxDistance << " cm" << std::endl;
+   diagnostics.close();
+   if ( !diagnosticsFile.empty() )
+      std::cout << "L1EGEventContextProducer diagnostics: " << diagnostics.written() << " records written to " << diagnosticsFile
+                << ", " << diagnostics.dropped() << " dropped" << std::endl;
+}
+
+// ------------ method called to produce the data  ------------
+void
+L1EGEventContextProducer::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+   std::auto_ptr<l1eg::EventContext> context(new l1eg::EventContext);
+   diagnostics.setEvent(iEvent.id().run(), iEvent.id().luminosityBlock(), iEvent.id().event());
+
+   // Crystal clusters, left in input order (analyzers walk them with l1eg::ptOrdered)
+   edm::Handle<l1slhc::L1EGCrystalClusterCollection> crystalClustersHandle;
+   iEvent.getByLabel(L1CrystalClustersInputTag, crystalClustersHandle);
+   const auto& crystalClusters = *crystalClustersHandle.product();
+   featureExtractor->extract(crystalClusters, context->clusterFeatures);
+   if ( fixedPointCuts )
+   {
+      for(auto& f : context->clusterFeatures) f.emulatedPassBits = fixedPointCuts->passBits(f);
+      context->emulatedCuts = true;
+   }
+
+   // EG candidates of other algorithms, at most one collection per input tag plus the two merged ones
+   context->egNames.reserve(L1EGammaInputTags.size() + 2);
+   context->egCandidates.reserve(L1EGammaInputTags.size() + 2);
+   auto collection = [&context](const std::string& name) -> l1extra::L1EmParticleCollection& {
+      for(size_t i=0; i<context->egNames.size(); ++i)
+         if ( context->egNames[i] == name ) return context->egCandidates[i];
+      context->egNames.push_back(name);
+      context->egCandidates.emplace_back();
+      return context->egCandidates.back();
+   };
+   for(size_t i=0; i<L1EGammaInputTags.size(); ++i)
+   {
+      edm::Handle<l1extra::L1EmParticleCollection> handle;
+      iEvent.getByLabel(L1EGammaInputTags[i], handle);
+      if ( handle.product() == nullptr )
+      {
+         if ( egMissingEvents[i]++ == 0 )
+            std::cout << "There is no product of type " << egInputNames[i] << " (reported once, see the end of job count)" << std::endl;
+         continue;
+      }
+      auto& own = collection(egInputNames[i]);
+      own.insert(end(own), begin(*handle.product()), end(*handle.product()));
+      if ( !egMergedNames[i].empty() )
+      {
+         auto& all = collection(egMergedNames[i]);
+         all.insert(end(all), begin(*handle.product()), end(*handle.product()));
+      }
+   }
+
+   if ( makeCaloHits ) fillCaloHits(iEvent, iSetup, *context);
+   if ( doTruth ) fillTruth(iEvent, *context);
+
+   iEvent.put(context);
+}
+
+void
+L1EGEventContextProducer::fillCaloHits(const edm::Event& iEvent, const edm::EventSetup& iSetup, l1eg::EventContext& context)
+{
+   if ( geometryHelper.getEcalBarrelGeometry() == nullptr )
+   {
+      edm::ESHandle<CaloTopology> theCaloTopology;
+      iSetup.get<CaloTopologyRecord>().get(theCaloTopology);
+      edm::ESHandle<CaloGeometry> pG;
+      iSetup.get<CaloGeometryRecord>().get(pG);
+      double bField000 = 4.;
+      geometryHelper.setupGeometry(*pG);
+      geometryHelper.setupTopology(*theCaloTopology);
+      geometryHelper.initialize(bField000);
+   }
+
+   // Retrieve the ecal barrel (and endcap) hits
+   // using RecHits (https://cmssdt.cern.ch/SDT/doxygen/CMSSW_6_1_2_SLHC6/doc/html/d8/dc9/classEcalRecHit.html)
+   edm::Handle<EcalRecHitCollection> pcalohits;
+   iEvent.getByLabel("ecalRecHit","EcalRecHitsEB",pcalohits);
+   ecalHitBuilder.reserve(pcalohits->size());
+   for(const auto& hit : *pcalohits.product())
+   {
+      if(hit.energy() > 0.2)
+      {
+         auto cell = geometryHelper.getEcalBarrelGeometry()->getGeometry(hit.id());
+         ecalHitBuilder.add(hit.id(), cell->getPosition(), hit.energy());
+      }
+   }
+   if ( useEndcap )
+   {
+      edm::Handle<EcalRecHitCollection> pcalohitsEE;
+      iEvent.getByLabel("ecalRecHit","EcalRecHitsEE",pcalohitsEE);
+      for(const auto& hit : *pcalohitsEE.product())
+      {
+         if(hit.energy() > 0.2)
+         {
+            auto cell = geometryHelper.getEcalEndcapGeometry()->getGeometry(hit.id());
+            ecalHitBuilder.add(hit.id(), cell->getPosition(), hit.energy());
+         }
+      }
+   }
+
+   context.ecalHits = ecalHitBuilder.build();
+
+   // Retrive hcal hits
+   edm::Handle<HBHERecHitCollection> hbhecoll;
+   iEvent.getByLabel("hbheprereco", hbhecoll);
+   context.hcalHits.reserve(hbhecoll->size());
+   for (const auto& hit : *hbhecoll.product())
+   {
+      if ( hit.energy() > 0.1 )
+      {
+         auto cell = geometryHelper.getHcalGeometry()->getGeometry(hit.id());
+         l1eg::CaloHit hhit;
+         hhit.id = hit.id();
+         hhit.position = cell->getPosition();
+         hhit.energy = hit.energy();
+         context.hcalHits.push_back(hhit);
+      }
+   }
+}
+
+void
+L1EGEventContextProducer::fillTruth(const edm::Event& iEvent, l1eg::EventContext& context)
+{
+   edm::Handle<reco::GenParticleCollection> genParticleHandle;
+   iEvent.getByLabel("genParticles", genParticleHandle);
+   if ( !genParticleHandle.isValid() || genParticleHandle->size() == 0 ) return;
+
+   truthInputs.clear();
+   if ( !truthAllParticles )
+   {
+      // Only one particle is produced in single particle gun files
+      truthInputs.push_back(&genParticleHandle->at(0));
+   }
+   else
+   {
+      for(const auto& genParticle : *genParticleHandle)
+      {
+         const int id = std::abs(genParticle.pdgId());
+         if ( genParticle.status() == 1 && (id == 11 || id == 22)
+              && genParticle.pt() > truthMinPt && fabs(genParticle.eta()) < truthMaxEta )
+            truthInputs.push_back(&genParticle);
+      }
+   }
+
+   context.truth.reserve(truthInputs.size());
+   if ( helixPropagator ) addTruthBatch(context);
+   else for(const auto * genParticle : truthInputs) addTruth(*genParticle, context);
+}
+
+void
+L1EGEventContextProducer::addTruthBatch(l1eg::EventContext& context)
+{
+   helixBatch.clear();
+   for(const auto * genParticle : truthInputs)
+      helixBatch.push_back(genParticle->vertex().x(), genParticle->vertex().y(), genParticle->vertex().z(),
+                           genParticle->px(), genParticle->py(), genParticle->pz(), genParticle->charge());
+   helix.propagate(helixBatch);
+
+   for(size_t i=0; i<truthInputs.size(); ++i)
+   {
+      const auto& genParticle = *truthInputs[i];
+      l1eg::TruthParticle truth;
+      truth.pdgId = genParticle.pdgId();
+      truth.gen = genParticle.polarP4();
+      truth.propagated = helixBatch.surface[i] != l1eg::HelixPropagator::kFailed;
+      if ( truth.propagated )
+      {
+         const double eta = helixBatch.exitEta(i);
+         truth.ecal = reco::Candidate::PolarLorentzVector(genParticle.energy()/std::cosh(eta), eta, helixBatch.exitPositionPhi(i), 0.);
+      }
+      else
+      {
+         truth.ecal = genParticle.polarP4();
+      }
+
+      if ( helixPropagatorTolerance > 0. )
+      {
+         // Same particle through BaseParticlePropagator, compared at the ECAL entrance
+         BaseParticlePropagator reference(makePropagator(genParticle));
+         reference.propagateToEcalEntrance();
+         double distance = 0.;
+         if ( truth.propagated && reference.getSuccess() != 0 )
+            distance = std::sqrt(std::pow(reference.vertex().x() - helixBatch.exitX[i], 2)
+                                 + std::pow(reference.vertex().y() - helixBatch.exitY[i], 2)
+                                 + std::pow(reference.vertex().z() - helixBatch.exitZ[i], 2));
+         helixCompared++;
+         if ( reference.getSuccess() != helixBatch.surface[i] || distance > helixPropagatorTolerance )
+         {
+            helixDisagreed++;
+            diagnostics.log(kHelixDisagreement, "pdgId surface referenceSurface distance eta phi",
+                  {float(genParticle.pdgId()), float(helixBatch.surface[i]), float(reference.getSuccess()), float(distance),
+                   float(reference.vertex().eta()), float(reference.vertex().phi())});
+         }
+         helixMaxDistance = std::max(helixMaxDistance, distance);
+      }
+      context.truth.push_back(truth);
+   }
+}
+
+void
+L1EGEventContextProducer::addTruth(const reco::GenParticle& genParticle, l1eg::EventContext& context)
+{
+   l1eg::TruthParticle truth;
+   truth.pdgId = genParticle.pdgId();
+   truth.gen = genParticle.polarP4();
+
+   // Get the particle position upon entering ECal
+   BaseParticlePropagator prop(makePropagator(genParticle));
+   prop.propagateToEcalEntrance();
+   if(prop.getSuccess()!=0)
+   {
+      truth.propagated = true;
+      truth.ecal = reco::Candidate::PolarLorentzVector(prop.E()*sin(prop.vertex().theta()), prop.vertex().eta(), prop.vertex().phi(), 0.);
+      diagnostics.log(kTruthPropagation, "pdgId genPt ecalPt ecalEta ecalPhi ecalZ",
+            {float(genParticle.pdgId()), float(genParticle.pt()), float(truth.ecal.pt()), float(truth.ecal.eta()), float(truth.ecal.phi()), float(prop.vertex().z())});
+   }
+   else
+   {
+      // something failed?
+      truth.ecal = genParticle.polarP4();
+   }
+   context.truth.push_back(truth);
+}
+
+BaseParticlePropagator
+L1EGEventContextProducer::makePropagator(const reco::GenParticle& genParticle)
+{
+   RawParticle particle(genParticle.p4());
+   particle.setVertex(genParticle.vertex().x(), genParticle.vertex().y(), genParticle.vertex().z(), 0.);
+   particle.setID(genParticle.pdgId());
+   return BaseParticlePropagator(particle, 0., 0., helix.config().bField);
+}
+
+// ------------ method called when starting to processes a run  ------------
+void
+L1EGEventContextProducer::beginRun(edm::Run const& iRun, edm::EventSetup const& es)
+{
+   edm::ESHandle<HepPDT::ParticleDataTable> pdt;
+   es.getData(pdt);
+   if ( !ParticleTable::instance() ) ParticleTable::instance(&(*pdt));
+}
+
+// ------------ method fills 'descriptions' with the allowed parameters for the module  ------------
+void
+L1EGEventContextProducer::fillDescriptions(edm::ConfigurationDescriptions& descriptions) {
+  //The following says we do not know what parameters are allowed so do no validation
+  // Please change this to state exactly what you do use, even if it is no parameters
+  edm::ParameterSetDescription desc;
+  desc.setUnknown();
+  descriptions.addDefault(desc);
+}
+
+//define this as a plug-in
+DEFINE_FWK_MODULE(L1EGEventContextProducer);
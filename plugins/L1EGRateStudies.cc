@@ -0,0 +1,1189 @@
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+// Class:      L1EGRateStudies
+// 
+/**\class L1EGRateStudies L1EGRateStudies.cc SLHCUpgradeSimulations/L1EGRateStudies/plugins/L1EGRateStudies.cc
+
+ Description: [one line class summary]
+
+ Implementation:
+     [Notes on implementation]
+*/
+//
+// Original Author:  Nick Smith
+//         Created:  Mon Mar 10 13:27:23 CDT 2014
+// $Id$
+//
+//
+
+
+// system include files
+#include <algorithm>
+#include <memory>
+#include <array>
+
+// user include files
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/EDAnalyzer.h"
+
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/Framework/interface/ESHandle.h"
+#include "FWCore/Framework/interface/EventSetup.h"
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/ParameterSet/interface/Registry.h"
+#include "FWCore/ServiceRegistry/interface/Service.h"
+#include "FWCore/Utilities/interface/Exception.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+#include "CommonTools/UtilAlgos/interface/TFileService.h"
+#include "TH1.h"
+#include "TH2.h"
+#include "TTree.h"
+#include "TNamed.h"
+
+#include "DataFormats/Math/interface/deltaR.h"
+#include "DataFormats/Candidate/interface/Candidate.h"
+#include "DataFormats/HepMCCandidate/interface/GenParticle.h"
+#include "DataFormats/HepMCCandidate/interface/GenParticleFwd.h"
+#include "SimDataFormats/GeneratorProducts/interface/HepMCProduct.h"
+#include "SimDataFormats/SLHC/interface/L1EGCrystalCluster.h"
+
+#include "DataFormats/EgammaReco/interface/SuperCluster.h"
+#include "DataFormats/EgammaReco/interface/SuperClusterFwd.h"
+
+#include "DataFormats/L1Trigger/interface/L1EmParticle.h"
+#include "DataFormats/L1Trigger/interface/L1EmParticleFwd.h"
+
+#include "SimDataFormats/SLHC/interface/StackedTrackerTypes.h"
+#include "DataFormats/L1TrackTrigger/interface/TTTypes.h"
+#include "SLHCUpgradeSimulations/L1TrackTrigger/interface/L1TkElectronTrackMatchAlgo.h"
+
+#include "DataFormats/EcalDigi/interface/EcalDigiCollections.h"
+#include "DataFormats/EcalRecHit/interface/EcalRecHit.h"
+#include "DataFormats/EcalRecHit/interface/EcalRecHitCollections.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/AnalysisCore.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/AsyncTreeWriter.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/Checkpoint.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/DeltaRMatching.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/DiagnosticLog.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/EBTriggerTowerMap.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/EventSummary.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/L1EGEventContext.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/PackedColumns.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/QuantileSketch.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ScratchArena.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ShowerShapes.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/TrackIsolation.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/TruthMatching.h"
+//
+// class declaration
+//
+class L1EGRateStudies : public edm::EDAnalyzer {
+   typedef std::vector<TTTrack<Ref_PixelDigi_>> L1TkTrackCollectionType;
+
+   public:
+      explicit L1EGRateStudies(const edm::ParameterSet&);
+      ~L1EGRateStudies();
+
+      static void fillDescriptions(edm::ConfigurationDescriptions& descriptions);
+
+
+   private:
+      virtual void beginJob() ;
+      virtual void analyze(const edm::Event&, const edm::EventSetup&);
+      virtual void endJob() ;
+
+      //virtual void beginRun(edm::Run const&, edm::EventSetup const&);
+      //virtual void endRun(edm::Run const&, edm::EventSetup const&);
+      //virtual void beginLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&);
+      //virtual void endLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&);
+
+      // -- user functions
+      void analyzeEvent(const edm::Event&, const edm::EventSetup&);
+      void integrateDown(TH1F *);
+      void integrateDown(TH2F *);
+      void fill_tree(const l1eg::ClusterFeatures& features);
+      bool passesCuts(const l1eg::ClusterFeatures& features) const;
+      bool checkTowerExists(const l1slhc::L1EGCrystalCluster &cluster) const;
+      void checkRecHitsFlags(const l1slhc::L1EGCrystalCluster &cluster, const l1eg::ClusterFeatures& features, const EcalRecHitCollection &ecalRecHitsEB, const EcalRecHitCollection &ecalRecHitsEE);
+      void doTrackMatching(const l1slhc::L1EGCrystalClusterCollection& clusters, size_t clusterIndex, edm::Handle<L1TkTrackCollectionType> l1trackHandle);
+      const std::pair<int, double>& nearestTrack(const l1slhc::L1EGCrystalClusterCollection& clusters, size_t clusterIndex, edm::Handle<L1TkTrackCollectionType> l1trackHandle);
+      
+      // ----------member data ---------------------------
+      bool doEfficiencyCalc;
+      bool useOfflineClusters;
+      bool debug;
+      bool useEndcap;
+      // Select with the fixed-point emulated cuts (see FixedPointCuts.h), when the context has them
+      bool useEmulatedCuts;
+      bool emulatedCutsThisEvent = false;
+      
+      double genMatchDeltaRcut;
+      double genMatchRelPtcut;
+      double trackMatchDeltaRcut;
+      unsigned multiObjectMaxCandidates;
+      
+      int eventCount;
+      std::vector<edm::InputTag> L1EGammaInputTags;
+      edm::InputTag L1CrystalClustersInputTag;
+      edm::InputTag L1EGContextInputTag;
+      edm::InputTag offlineRecoClusterInputTag;
+      edm::InputTag L1TrackInputTag;
+            
+      int nHistBins, nHistEtaBins;
+      double histLow;
+      double histHigh;
+      double histetaLow;
+      double histetaHigh;
+      TH1F * efficiency_denominator_hist;
+      TH1F * efficiency_denominator_eta_hist;
+      TH1F * efficiency_denominator_reco_hist;
+
+      TH1F * dyncrystal_efficiency_hist;
+      std::map<double, TH1F *> dyncrystal_efficiency_reco_hists; // Turn-on thresholds
+      std::map<double, TH1F *> dyncrystal_efficiency_gen_hists; // Turn-on thresholds
+      TH1F * dyncrystal_efficiency_bremcut_hist;
+      TH1F * dyncrystal_efficiency_eta_hist;
+      TH1F * dyncrystal_deltaR_hist;
+      TH1F * dyncrystal_deltaR_bremcut_hist;
+      TH1F * dyncrystal_deta_hist;
+      TH1F * dyncrystal_dphi_hist;
+      TH1F * dyncrystal_dphi_bremcut_hist;
+      TH1F * dyncrystal_rate_hist;
+      TH2F * dyncrystal_2DdeltaR_hist;
+
+      // Multi-object rates: subleading candidate above threshold (double EG), leading and
+      // subleading above their own thresholds (asymmetric double EG), and track-matched crystal clusters
+      TH1F * dyncrystal_doubleRate_hist;
+      TH2F * dyncrystal_doubleRateGrid_hist;
+      TH1F * dyncrystal_trackMatched_rate_hist;
+      TH1F * dyncrystal_trackMatched_doubleRate_hist;
+      TH2F * dyncrystal_trackMatched_doubleRateGrid_hist;
+      TH2F * dyncrystal_trackMatchedPlusEG_rateGrid_hist;
+
+      std::map<std::string, TH1F *> EGalg_efficiency_hists;
+      std::map<std::string, std::map<double, TH1F *>> EGalg_efficiency_reco_hists;
+      std::map<std::string, std::map<double, TH1F *>> EGalg_efficiency_gen_hists;
+      std::map<std::string, TH1F *> EGalg_efficiency_eta_hists;
+      std::map<std::string, TH1F *> EGalg_deltaR_hists;
+      std::map<std::string, TH1F *> EGalg_deta_hists;
+      std::map<std::string, TH1F *> EGalg_dphi_hists;
+      std::map<std::string, TH1F *> EGalg_rate_hists;
+      std::map<std::string, TH1F *> EGalg_doubleRate_hists;
+      std::map<std::string, TH2F *> EGalg_doubleRateGrid_hists;
+      std::map<std::string, TH2F *> EGalg_2DdeltaR_hists;
+      std::map<std::string, TH2F *> EGalg_reco_gen_pt_hists;
+
+      // Per-event scratch memory, reset at the start of each event
+      l1eg::ScratchArena scratch;
+
+      // Event-keyed debug records, written by a background thread (see DiagnosticLog.h)
+      enum DiagnosticCategory { kOfflineMatch, kClusterMatch, kEGMatch, kPassedCuts, kSeedFlag, kTrackMatch };
+      l1eg::DiagnosticLog diagnostics;
+      std::string diagnosticsFile;
+      std::vector<std::string> diagnosticsCategories;
+      unsigned diagnosticsPrescale;
+      unsigned diagnosticsMaxPerCategory;
+
+      // Rate selection shared with bin/l1egStandalone (see AnalysisCore.h), its input reused across events
+      std::unique_ptr<l1eg::AnalysisCore> rateCore;
+      l1eg::FlatEvent flatEvent;
+      l1eg::AnalysisCore::EventRates eventRates;
+
+      // Leading candidates of every algorithm per event, for offline rate studies (see EventSummary.h)
+      unsigned summaryTopN;
+      l1eg::EventSummary summary;
+
+      // Periodic snapshot of the histograms, tree and eventCount, to resume preempted jobs (see Checkpoint.h)
+      l1eg::Checkpoint checkpoint;
+      // Module parameters, completed with the source (input files, event range) in beginJob
+      std::string checkpointFingerprint;
+      TDirectory * checkpointDirectory = nullptr;
+      const EcalRecHitCollection noRecHits;
+
+      // Batched dR matching, buffers reused across events
+      l1eg::EtaPhiArray matchEtaPhi;
+      l1eg::DeltaRMatcher matcher;
+
+      // Truth particles entering the efficiency denominator, and their
+      // one-to-one assignment to the clusters and EG candidates
+      struct EfficiencyDenominator {
+         const l1eg::TruthParticle * truth = nullptr;
+         reco::Candidate::PolarLorentzVector p4; // at the ECAL entrance, or the offline reco match
+         float recoPt = 0.;
+         bool recoFound = false;
+      };
+      std::vector<EfficiencyDenominator> denominators;
+      l1eg::EtaPhiArray trueEtaPhi;
+      l1eg::OneToOneMatcher oneToOne;
+
+      // L1 track directions and momenta, cached once per event, and the isolation
+      // sums for every cone size, inner veto and pt floor (see TrackIsolation.h)
+      l1eg::EtaPhiArray trackEtaPhi;
+      std::vector<float> trackPt;
+      std::vector<float> trackP;
+      l1eg::TrackIsolation trackIsolation;
+      // (track index, dR) of the nearest track by cluster index, computed on first use in the event
+      // (the summary, the rate candidates and the crystal tree all ask for it), index kNotComputed before
+      enum { kNotComputed = -2 };
+      std::vector<std::pair<int, double>> nearestTracks;
+
+      // Quantile sketches of the resolution and kinematic histograms, to pick
+      // their ranges after the fact (see QuantileSketch.h, test/sketchHistograms.py)
+      l1eg::QuantileSketchSet sketches;
+
+      // Barrel trigger primitive compressed Et by dense tower index (see EBTriggerTowerMap.h), -1 if no TP
+      std::vector<int> towerCompressedEt;
+
+      // Float vs. fixed-point emulated rate study cuts, filled when the context has both
+      TH2I * cutEmulationAgreementHist;
+      TH1F * cutEmulationMismatchPtHist;
+
+      // EcalRecHits flags
+      TH1I * RecHitFlagsTowerHist;
+      TH1I * RecHitFlagsNoTowerHist;
+
+      // Crystal pt stuff
+      TTree * crystal_tree;
+      struct CrystalTreeRecord {
+         std::array<float, 6> crystal_pt;
+         int   crystalCount;
+         float cluster_pt;
+         float cluster_energy;
+         float eta;
+         float hovere;
+         float iso;
+         float bremStrength;
+         float deltaR = 0.;
+         float deltaPhi = 0.;
+         float gen_pt = 0.;
+         float E_gen = 0.;
+         float denom_pt = 0.;
+         float reco_pt = 0.;
+         bool  passed = false;
+         int   nthCandidate = -1;
+         bool  endcap = false;
+         float uslPt = 0.;
+         float lslPt = 0.;
+         float corePt = 0.;
+         float E_core = 0.;
+         float phiStripContiguous0;
+         float phiStripOneHole0;
+         float phiStripContiguous3p;
+         float phiStripOneHole3p;
+         float trackDeltaR;
+         float trackDeltaPhi;
+         float trackP;
+         float trackRInv;         
+         float trackChi2;
+         float trackIsoConeTrackCount;
+         float trackIsoConePtSum;
+         std::vector<float> trackIsoCount; // indexed by TrackIsolation::index(veto, floor, cone)
+         std::vector<float> trackIsoPtSum;
+         std::vector<float> showerShapes; // one per showerShapes definition
+      } treeinfo;
+      // Fills crystal_tree, from its own thread with asyncTreeWriter
+      l1eg::AsyncTreeWriter<CrystalTreeRecord> crystalTreeWriter;
+      bool asyncTreeWriter;
+      unsigned asyncTreeCapacity;
+      // Storage precision of each crystal_tree column, reduced with packCrystalTree
+      l1eg::PackedColumns crystalTreeColumns;
+      // Extra crystal_tree shape variables, recomputed from the context's rec hits (see ShowerShapes.h)
+      l1eg::ShowerShapeEngine showerShapes;
+
+      // (pt_reco-pt_gen)/pt_gen plot
+      TH2F * reco_gen_pt_hist;
+
+      // dphi vs. brem
+      TH2F * brem_dphi_hist;
+};
+
+//
+// constants, enums and typedefs
+//
+
+//
+// static data member definitions
+//
+
+//
+// constructors and destructor
+//
+L1EGRateStudies::L1EGRateStudies(const edm::ParameterSet& iConfig) :
+   doEfficiencyCalc(iConfig.getUntrackedParameter<bool>("doEfficiencyCalc", false)),
+   useOfflineClusters(iConfig.getUntrackedParameter<bool>("useOfflineClusters", false)),
+   debug(iConfig.getUntrackedParameter<bool>("debug", false)),
+   useEndcap(iConfig.getUntrackedParameter<bool>("useEndcap", false)),
+   useEmulatedCuts(iConfig.getUntrackedParameter<bool>("useEmulatedCuts", false)),
+   genMatchDeltaRcut(iConfig.getUntrackedParameter<double>("genMatchDeltaRcut", 0.1)),
+   genMatchRelPtcut(iConfig.getUntrackedParameter<double>("genMatchRelPtcut", 0.5)),
+   trackMatchDeltaRcut(iConfig.getUntrackedParameter<double>("trackMatchDeltaRcut", 0.1)),
+   multiObjectMaxCandidates(iConfig.getUntrackedParameter<unsigned>("multiObjectMaxCandidates", 6)),
+   nHistBins(iConfig.getUntrackedParameter<int>("histogramBinCount", 10)),
+   nHistEtaBins(iConfig.getUntrackedParameter<int>("histogramEtaBinCount", 20)),
+   histLow(iConfig.getUntrackedParameter<double>("histogramRangeLow", 0.)),
+   histHigh(iConfig.getUntrackedParameter<double>("histogramRangeHigh", 50.)),
+   histetaLow(iConfig.getUntrackedParameter<double>("histogramRangeetaLow", -2.5)),
+   histetaHigh(iConfig.getUntrackedParameter<double>("histogramRangeetaHigh", 2.5)),
+   diagnostics({"offlineMatch", "clusterMatch", "egMatch", "passedCuts", "seedFlag", "trackMatch"}),
+   diagnosticsFile(iConfig.getUntrackedParameter<std::string>("diagnosticsFile", "")),
+   diagnosticsCategories(iConfig.getUntrackedParameter<std::vector<std::string>>("diagnosticsCategories", std::vector<std::string>())),
+   diagnosticsPrescale(iConfig.getUntrackedParameter<unsigned>("diagnosticsPrescale", 1)),
+   diagnosticsMaxPerCategory(iConfig.getUntrackedParameter<unsigned>("diagnosticsMaxPerCategory", 0)),
+   summaryTopN(iConfig.getUntrackedParameter<unsigned>("summaryTopN", 0)),
+   checkpoint(iConfig.getUntrackedParameter<std::string>("checkpointFile", ""), iConfig.getUntrackedParameter<unsigned>("checkpointInterval", 1000)),
+   checkpointFingerprint(iConfig.dump()),
+   trackIsolation(iConfig.getUntrackedParameter<std::vector<double>>("trackIsoCones", {0.1, 0.2, 0.3, 0.4, 0.5}),
+                  iConfig.getUntrackedParameter<std::vector<double>>("trackIsoVetoes", {0., 0.01, 0.03}),
+                  iConfig.getUntrackedParameter<std::vector<double>>("trackIsoPtFloors", {0., 1., 2., 3.})),
+   sketches(iConfig.getUntrackedParameter<unsigned>("quantileSketchSize", 200)),
+   asyncTreeWriter(iConfig.getUntrackedParameter<bool>("asyncTreeWriter", false)),
+   asyncTreeCapacity(iConfig.getUntrackedParameter<unsigned>("asyncTreeCapacity", 4096)),
+   crystalTreeColumns(iConfig.getUntrackedParameter<bool>("packCrystalTree", false),
+                      iConfig.getUntrackedParameter<std::vector<std::string>>("crystalTreePrecision", std::vector<std::string>())),
+   showerShapes(iConfig.getUntrackedParameter<std::vector<std::string>>("showerShapes", std::vector<std::string>()))
+{
+   // The writer thread writes crystal_tree baskets into the TFileService file, nothing
+   // else may write to that file during the event loop (ROOT does not allow concurrent
+   // writes to one TFile), and event_summary is filled on the event thread
+   if ( asyncTreeWriter && summaryTopN > 0 )
+      throw cms::Exception("Configuration") << "L1EGRateStudies: asyncTreeWriter cannot be combined with summaryTopN > 0, "
+                                            << "event_summary is filled on the event thread into the same file as crystal_tree";
+   // debug alone still gets the diagnostics, in a file instead of the terminal
+   if ( debug && diagnosticsFile.empty() ) diagnosticsFile = "L1EGRateStudies_diagnostics.jsonl";
+   eventCount = 0;
+   L1EGammaInputTags = iConfig.getParameter<std::vector<edm::InputTag>>("L1EGammaInputTags");
+   L1EGammaInputTags.push_back(edm::InputTag("l1extraParticles:All"));
+   L1EGammaInputTags.push_back(edm::InputTag("l1extraParticlesUCT:All"));
+   L1CrystalClustersInputTag = iConfig.getParameter<edm::InputTag>("L1CrystalClustersInputTag");
+   L1EGContextInputTag = iConfig.getParameter<edm::InputTag>("L1EGContextInputTag");
+   L1TrackInputTag = iConfig.getParameter<edm::InputTag>("L1TrackInputTag");
+   
+   edm::Service<TFileService> fs;
+   
+   // If using offline-reco clusters, label dR & related hists appropriately
+   std::string drLabel("(Gen-Reco);Counts");
+   if ( useOfflineClusters ) drLabel = "(vs. Offline Reco.);Counts";
+
+   // Make a set of histograms to fill, depending on if we are doing rate or efficiency
+   if ( doEfficiencyCalc )
+   {
+      auto thresholds = iConfig.getUntrackedParameter<std::vector<int>>("turnOnThresholds");
+      offlineRecoClusterInputTag = iConfig.getParameter<edm::InputTag>("OfflineRecoClustersInputTag");
+
+      dyncrystal_efficiency_hist = fs->make<TH1F>("dyncrystalEG_efficiency_pt", "Dynamic Crystal Trigger;Gen. pT (GeV);Efficiency", nHistBins, histLow, histHigh);
+      dyncrystal_efficiency_bremcut_hist = fs->make<TH1F>("dyncrystalEG_efficiency_bremcut_pt", "Dynamic Crystal Trigger;Gen. pT (GeV);Efficiency", nHistBins, histLow, histHigh);
+      dyncrystal_efficiency_eta_hist = fs->make<TH1F>("dyncrystalEG_efficiency_eta", "Dynamic Crystal Trigger;Gen. #eta;Efficiency", nHistEtaBins, histetaLow, histetaHigh);
+      // Implicit conversion from int to double
+      for(int threshold : thresholds)
+      {
+         dyncrystal_efficiency_reco_hists[threshold] = fs->make<TH1F>(("dyncrystalEG_threshold"+std::to_string(threshold)+"_efficiency_reco_pt").c_str(), "Dynamic Crystal Trigger;Offline reco. pT (GeV);Efficiency", nHistBins, histLow, histHigh);
+         dyncrystal_efficiency_gen_hists[threshold] = fs->make<TH1F>(("dyncrystalEG_threshold"+std::to_string(threshold)+"_efficiency_gen_pt").c_str(), "Dynamic Crystal Trigger;Gen. pT (GeV);Efficiency", nHistBins, histLow, histHigh);
+      }
+      dyncrystal_deltaR_hist = fs->make<TH1F>("dyncrystalEG_deltaR", ("Dynamic Crystal Trigger;#Delta R "+drLabel).c_str(), 50, 0., genMatchDeltaRcut);
+      dyncrystal_deltaR_bremcut_hist = fs->make<TH1F>("dyncrystalEG_deltaR_bremcut", ("Dynamic Crystal Trigger;#Delta R "+drLabel).c_str(), 50, 0., genMatchDeltaRcut);
+      dyncrystal_deta_hist = fs->make<TH1F>("dyncrystalEG_deta", ("Dynamic Crystal Trigger;d#eta "+drLabel).c_str(), 50, -0.1, 0.1);
+      dyncrystal_dphi_hist = fs->make<TH1F>("dyncrystalEG_dphi", ("Dynamic Crystal Trigger;d#phi "+drLabel).c_str(), 50, -0.1, 0.1);
+      dyncrystal_dphi_bremcut_hist = fs->make<TH1F>("dyncrystalEG_dphi_bremcut", ("Dynamic Crystal Trigger;d#phi "+drLabel).c_str(), 50, -0.1, 0.1);
+      dyncrystal_2DdeltaR_hist = fs->make<TH2F>("dyncrystalEG_2DdeltaR_hist", "Dynamic Crystal Trigger;d#eta;d#phi;Counts", 50, -0.05, 0.05, 50, -0.05, 0.05);
+
+      for(auto& inputTag : L1EGammaInputTags)
+      {
+         const std::string &name = inputTag.encode();
+         EGalg_efficiency_hists[name] = fs->make<TH1F>((name+"_efficiency_pt").c_str(), (name+";Gen. pT (GeV);Efficiency").c_str(), nHistBins, histLow, histHigh);
+         EGalg_efficiency_eta_hists[name] = fs->make<TH1F>((name+"_efficiency_eta").c_str(), (name+";Gen. #eta;Efficiency").c_str(), nHistEtaBins, histetaLow, histetaHigh);
+         // Implicit conversion from int to double
+         for(int threshold : thresholds)
+         {
+            EGalg_efficiency_reco_hists[name][threshold] = fs->make<TH1F>((name+"_threshold"+std::to_string(threshold)+"_efficiency_reco_pt").c_str(), (name+";Offline reco. pT (GeV);Efficiency").c_str(), nHistBins, histLow, histHigh);
+            EGalg_efficiency_gen_hists[name][threshold] = fs->make<TH1F>((name+"_threshold"+std::to_string(threshold)+"_efficiency_gen_pt").c_str(), (name+";Gen. pT (GeV);Efficiency").c_str(), nHistBins, histLow, histHigh);
+         }
+         EGalg_deltaR_hists[name] = fs->make<TH1F>((name+"_deltaR").c_str(), (name+";#Delta R "+drLabel).c_str(), 50, 0., genMatchDeltaRcut);
+         EGalg_deta_hists[name] = fs->make<TH1F>((name+"_deta").c_str(), (name+";d#eta "+drLabel).c_str(), 50, -0.1, 0.1);
+         EGalg_dphi_hists[name] = fs->make<TH1F>((name+"_dphi").c_str(), (name+";d#phi "+drLabel).c_str(), 50, -0.1, 0.1);
+         EGalg_2DdeltaR_hists[name] = fs->make<TH2F>((name+"_2DdeltaR").c_str(), ";d#eta;d#phi;Counts", 50, -0.05, 0.05, 50, -0.05, 0.05);
+         EGalg_reco_gen_pt_hists[name] = fs->make<TH2F>((name+"_reco_gen_pt").c_str(), (name+";Gen. pT (GeV);(reco-gen)/gen;Counts").c_str(), 40, 0., 50., 40, -0.3, 0.3); 
+      }
+
+      reco_gen_pt_hist = fs->make<TH2F>("reco_gen_pt" , "EG relative momentum error;Gen. pT (GeV);(reco-gen)/gen;Counts", 40, 0., 50., 40, -0.3, 0.3); 
+      brem_dphi_hist = fs->make<TH2F>("brem_dphi_hist" , "Brem. strength vs. d#phi;Brem. Strength;d#phi;Counts", 40, 0., 2., 40, -0.05, 0.05); 
+
+      efficiency_denominator_hist = fs->make<TH1F>("gen_pt", "Gen. pt;Gen. pT (GeV); Counts", nHistBins, histLow, histHigh);
+      efficiency_denominator_reco_hist = fs->make<TH1F>("reco_pt", "Offline reco. pt;Gen. pT (GeV); Counts", nHistBins, histLow, histHigh);
+      efficiency_denominator_eta_hist = fs->make<TH1F>("gen_eta", "Gen. #eta;Gen. #eta; Counts", nHistEtaBins, histetaLow, histetaHigh);
+
+      for(TH1 * hist : std::initializer_list<TH1 *>{dyncrystal_deltaR_hist, dyncrystal_deltaR_bremcut_hist, dyncrystal_deta_hist, dyncrystal_dphi_hist, dyncrystal_dphi_bremcut_hist,
+                                                    dyncrystal_2DdeltaR_hist, reco_gen_pt_hist, brem_dphi_hist,
+                                                    efficiency_denominator_hist, efficiency_denominator_reco_hist, efficiency_denominator_eta_hist})
+         sketches.track(hist);
+      for(auto& inputTag : L1EGammaInputTags)
+      {
+         const std::string &name = inputTag.encode();
+         for(TH1 * hist : std::initializer_list<TH1 *>{EGalg_deltaR_hists[name], EGalg_deta_hists[name], EGalg_dphi_hists[name], EGalg_2DdeltaR_hists[name], EGalg_reco_gen_pt_hists[name]})
+            sketches.track(hist);
+      }
+   }
+   else
+   {
+      dyncrystal_rate_hist = fs->make<TH1F>("dyncrystalEG_rate" , "Dynamic Crystal Trigger;ET Threshold (GeV);Rate (kHz)", nHistBins, histLow, histHigh);
+      dyncrystal_doubleRate_hist = fs->make<TH1F>("dyncrystalEG_rate_double" , "Dynamic Crystal Trigger, double EG;Subleading ET Threshold (GeV);Rate (kHz)", nHistBins, histLow, histHigh);
+      dyncrystal_doubleRateGrid_hist = fs->make<TH2F>("dyncrystalEG_rate_doubleGrid" , "Dynamic Crystal Trigger, double EG;Leading ET Threshold (GeV);Subleading ET Threshold (GeV);Rate (kHz)", nHistBins, histLow, histHigh, nHistBins, histLow, histHigh);
+      dyncrystal_trackMatched_rate_hist = fs->make<TH1F>("dyncrystalEG_trackMatched_rate" , "Dynamic Crystal Trigger, track-matched;ET Threshold (GeV);Rate (kHz)", nHistBins, histLow, histHigh);
+      dyncrystal_trackMatched_doubleRate_hist = fs->make<TH1F>("dyncrystalEG_trackMatched_rate_double" , "Dynamic Crystal Trigger, track-matched double EG;Subleading ET Threshold (GeV);Rate (kHz)", nHistBins, histLow, histHigh);
+      dyncrystal_trackMatched_doubleRateGrid_hist = fs->make<TH2F>("dyncrystalEG_trackMatched_rate_doubleGrid" , "Dynamic Crystal Trigger, track-matched double EG;Leading ET Threshold (GeV);Subleading ET Threshold (GeV);Rate (kHz)", nHistBins, histLow, histHigh, nHistBins, histLow, histHigh);
+      dyncrystal_trackMatchedPlusEG_rateGrid_hist = fs->make<TH2F>("dyncrystalEG_trackMatched_rate_plusEGGrid" , "Dynamic Crystal Trigger, track-matched EG + EG;Track-matched ET Threshold (GeV);Other EG ET Threshold (GeV);Rate (kHz)", nHistBins, histLow, histHigh, nHistBins, histLow, histHigh);
+      for(auto& inputTag : L1EGammaInputTags)
+      {
+         const std::string &name = inputTag.encode();
+         EGalg_rate_hists[name] = fs->make<TH1F>((name+"_rate").c_str() , (name+";ET Threshold (GeV);Rate (kHz)").c_str(), nHistBins, histLow, histHigh);
+         EGalg_doubleRate_hists[name] = fs->make<TH1F>((name+"_rate_double").c_str() , (name+", double EG;Subleading ET Threshold (GeV);Rate (kHz)").c_str(), nHistBins, histLow, histHigh);
+         EGalg_doubleRateGrid_hists[name] = fs->make<TH2F>((name+"_rate_doubleGrid").c_str() , (name+", double EG;Leading ET Threshold (GeV);Subleading ET Threshold (GeV);Rate (kHz)").c_str(), nHistBins, histLow, histHigh, nHistBins, histLow, histHigh);
+         // Sketches the leading candidate pt, before the rate integration
+         sketches.track(EGalg_rate_hists[name]);
+      }
+      sketches.track(dyncrystal_rate_hist);
+      sketches.track(dyncrystal_trackMatched_rate_hist);
+   }
+   cutEmulationAgreementHist = fs->make<TH2I>("cutEmulationAgreement", "Rate study cuts, all clusters;Float passes;Fixed-point passes;Counts", 2, -0.5, 1.5, 2, -0.5, 1.5);
+   cutEmulationMismatchPtHist = fs->make<TH1F>("cutEmulationMismatch_pt", "Clusters where float and fixed-point cuts disagree;Cluster pT (GeV);Counts", nHistBins, histLow, histHigh);
+   RecHitFlagsTowerHist = fs->make<TH1I>("recHitFlags_tower", "EcalRecHit status flags when tower exists;Flag;Counts", 20, 0, 19);
+   RecHitFlagsNoTowerHist = fs->make<TH1I>("recHitFlags_notower", "EcalRecHit status flags when tower exists;Flag;Counts", 20, 0, 19);
+
+   l1eg::AnalysisCore::Config rateConfig;
+   rateConfig.useEndcap = useEndcap;
+   rateConfig.useEmulatedCuts = useEmulatedCuts;
+   rateConfig.trackMatchDeltaRcut = trackMatchDeltaRcut;
+   rateConfig.multiObjectMaxCandidates = multiObjectMaxCandidates;
+   for(const auto& inputTag : L1EGammaInputTags) rateConfig.egNames.push_back(inputTag.encode());
+   rateCore.reset(new l1eg::AnalysisCore(rateConfig));
+
+   if ( summaryTopN > 0 )
+   {
+      const auto& egNames = rateConfig.egNames;
+      summary.book(fs->make<TTree>("event_summary", "Leading L1 EG candidates per event"), summaryTopN, egNames);
+   }
+
+   crystal_tree = fs->make<TTree>("crystal_tree", "Crystal cluster individual crystal pt values");
+   treeinfo.trackIsoCount.resize(trackIsolation.size());
+   treeinfo.trackIsoPtSum.resize(trackIsolation.size());
+   treeinfo.showerShapes.resize(showerShapes.size());
+   // The branches read the writer's copy, treeinfo is only staged into it
+   crystalTreeWriter.book(crystal_tree, treeinfo, [this]() { crystalTreeColumns.pack(); });
+   CrystalTreeRecord& branches = crystalTreeWriter.buffer();
+   // Precisions apply with packCrystalTree, see PackedColumns.h; the cut studies need a few per mille
+   l1eg::PackedColumns& columns = crystalTreeColumns;
+   columns.add("pt", branches.crystal_pt.data(), "mantissa:10", 6, "1:2:3:4:5:6");
+   columns.add("crystalCount", &branches.crystalCount, "int:8");
+   columns.add("cluster_pt", &branches.cluster_pt, "mantissa:12");
+   columns.add("cluster_energy", &branches.cluster_energy, "mantissa:12");
+   columns.add("eta", &branches.eta, "fixed:-3:3:12");
+   columns.add("cluster_hovere", &branches.hovere, "mantissa:10");
+   columns.add("cluster_iso", &branches.iso, "mantissa:10");
+   columns.add("bremStrength", &branches.bremStrength, "fixed:0:1:10");
+   columns.add("deltaR", &branches.deltaR, "mantissa:10");
+   columns.add("deltaPhi", &branches.deltaPhi, "mantissa:10");
+   columns.add("gen_pt", &branches.gen_pt, "mantissa:12");
+   columns.add("E_gen", &branches.E_gen, "mantissa:12");
+   columns.add("denom_pt", &branches.denom_pt, "mantissa:12");
+   columns.add("reco_pt", &branches.reco_pt, "mantissa:12");
+   columns.add("passed", &branches.passed, "flag");
+   columns.add("nthCandidate", &branches.nthCandidate, "int:16");
+   columns.add("endcap", &branches.endcap, "flag");
+   columns.add("uslPt", &branches.uslPt, "mantissa:10");
+   columns.add("lslPt", &branches.lslPt, "mantissa:10");
+   columns.add("corePt", &branches.corePt, "mantissa:12");
+   columns.add("E_core", &branches.E_core, "mantissa:12");
+   columns.add("phiStripContiguous0", &branches.phiStripContiguous0, "mantissa:8");
+   columns.add("phiStripOneHole0", &branches.phiStripOneHole0, "mantissa:8");
+   columns.add("phiStripContiguous3p", &branches.phiStripContiguous3p, "mantissa:8");
+   columns.add("phiStripOneHole3p", &branches.phiStripOneHole3p, "mantissa:8");
+   columns.add("trackDeltaR", &branches.trackDeltaR, "mantissa:10");
+   columns.add("trackDeltaPhi", &branches.trackDeltaPhi, "mantissa:10");
+   columns.add("trackP", &branches.trackP, "mantissa:12");
+   columns.add("trackRInv", &branches.trackRInv, "mantissa:12");
+   columns.add("trackChi2", &branches.trackChi2, "mantissa:8");
+   columns.add("trackIsoConeTrackCount", &branches.trackIsoConeTrackCount, "int:16");
+   columns.add("trackIsoConePtSum", &branches.trackIsoConePtSum, "mantissa:10");
+   columns.add("trackIsoCount", branches.trackIsoCount.data(), "int:16", trackIsolation.size());
+   columns.add("trackIsoPtSum", branches.trackIsoPtSum.data(), "mantissa:10", trackIsolation.size());
+   for(size_t i=0; i<showerShapes.size(); ++i)
+      columns.add(showerShapes.variable(i).name, &branches.showerShapes[i], showerShapes.precision(i));
+   columns.book(crystal_tree);
+   // Ladder of the trackIso arrays, flat index (veto*nFloors + floor)*nCones + cone
+   std::string ladder = "cones";
+   for(float c : trackIsolation.cones()) ladder += " " + std::to_string(c);
+   ladder += "; vetoes";
+   for(float v : trackIsolation.vetoes()) ladder += " " + std::to_string(v);
+   ladder += "; ptFloors";
+   for(float f : trackIsolation.ptFloors()) ladder += " " + std::to_string(f);
+   fs->make<TNamed>("trackIsoLadder", ladder.c_str());
+}
+
+
+L1EGRateStudies::~L1EGRateStudies()
+{
+   // do anything here that needs to be done at desctruction time
+   // (e.g. close files, deallocate resources etc.)
+}
+
+
+//
+// member functions
+//
+
+// ------------ method called for each event  ------------
+void
+L1EGRateStudies::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+   // Events already in a restored checkpoint are skipped
+   const edm::EventID& id = iEvent.id();
+   if ( checkpoint.done(id.run(), id.luminosityBlock(), id.event()) ) return;
+   analyzeEvent(iEvent, iSetup);
+   // The snapshot copies crystal_tree, which has to be complete and idle
+   if ( checkpoint.saveDue() ) crystalTreeWriter.sync();
+   checkpoint.eventDone(checkpointDirectory, id.run(), id.luminosityBlock(), id.event());
+}
+
+void
+L1EGRateStudies::analyzeEvent(const edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+   using namespace edm;
+   eventCount++;
+   scratch.reset();
+   diagnostics.setEvent(iEvent.id().run(), iEvent.id().luminosityBlock(), iEvent.id().event());
+
+   // Shared event context: cluster features, EG candidates of the other algorithms, truth
+   edm::Handle<l1eg::EventContext> contextHandle;
+   iEvent.getByLabel(L1EGContextInputTag, contextHandle);
+   const l1eg::EventContext& context = *contextHandle.product();
+   emulatedCutsThisEvent = useEmulatedCuts && context.emulatedCuts;
+   // Needs makeCaloHits in the context producer, the shapes are zero otherwise
+   showerShapes.setHits(context.ecalHits);
+   if ( context.emulatedCuts )
+   {
+      for(const auto& f : context.clusterFeatures)
+      {
+         const bool floatPass = f.passes(l1eg::ClusterFeatures::kRateStudies);
+         const bool fixedPass = f.passesEmulated(l1eg::ClusterFeatures::kRateStudies);
+         cutEmulationAgreementHist->Fill(floatPass, fixedPass);
+         if ( floatPass != fixedPass ) cutEmulationMismatchPtHist->Fill(f.pt);
+      }
+   }
+
+   // electron candidate extra info from Sacha's algorithm
+   edm::Handle<l1slhc::L1EGCrystalClusterCollection> crystalClustersHandle;      
+   iEvent.getByLabel(L1CrystalClustersInputTag,crystalClustersHandle);
+   const l1slhc::L1EGCrystalClusterCollection& crystalClusters = *crystalClustersHandle.product();
+
+   // Trigger tower info (trigger primitives)
+   edm::Handle<EcalTrigPrimDigiCollection> tpH;
+   iEvent.getByLabel(edm::InputTag("ecalDigis:EcalTriggerPrimitives"), tpH);
+   const EcalTrigPrimDigiCollection& triggerPrimitives = *tpH.product();
+   towerCompressedEt.assign(l1eg::eb::kTowers, -1);
+   for(const auto& tp : triggerPrimitives)
+   {
+      if ( tp.id().subDet() != EcalBarrel ) continue;
+      int& et = towerCompressedEt[l1eg::eb::towerIndex(tp.id().ieta(), tp.id().iphi())];
+      // First TP wins, as when searching the collection
+      if ( et < 0 ) et = tp.compressedEt();
+   }
+
+   // EcalRecHits for looking at flags in the cluster seed crystal
+   edm::Handle<EcalRecHitCollection> pcalohits;
+   iEvent.getByLabel("ecalRecHit","EcalRecHitsEB",pcalohits);
+   const EcalRecHitCollection& ecalRecHits = *pcalohits.product();
+   edm::Handle<EcalRecHitCollection> pcalohitsEE;
+   if ( useEndcap ) iEvent.getByLabel("ecalRecHit","EcalRecHitsEE",pcalohitsEE);
+   const EcalRecHitCollection& ecalRecHitsEE = ( useEndcap ) ? *pcalohitsEE.product() : noRecHits;
+
+   // L1 Tracks
+   edm::Handle<L1TkTrackCollectionType> l1trackHandle;
+   iEvent.getByLabel(L1TrackInputTag, l1trackHandle);
+   trackEtaPhi.clear();
+   trackPt.clear();
+   trackP.clear();
+   if ( l1trackHandle.isValid() )
+   {
+      trackEtaPhi.reserve(l1trackHandle->size());
+      for(const auto& track : *l1trackHandle)
+      {
+         const auto momentum = track.getMomentum();
+         trackEtaPhi.push_back(momentum.eta(), momentum.phi());
+         trackPt.push_back(momentum.perp());
+         trackP.push_back(momentum.mag());
+      }
+   }
+   nearestTracks.assign(crystalClusters.size(), std::make_pair(int(kNotComputed), 999.));
+
+   if ( summaryTopN > 0 )
+   {
+      summary.fill(iEvent.id().run(), iEvent.id().luminosityBlock(), iEvent.id().event(), context, scratch, [&](unsigned i) {
+         return float(nearestTrack(crystalClusters, i, l1trackHandle).second);
+      });
+   }
+
+
+   int clusterCount = 0;
+   if ( doEfficiencyCalc )
+   {
+      // Get offline cluster info
+      edm::Handle<reco::SuperClusterCollection> offlineRecoClustersHandle;
+      iEvent.getByLabel(offlineRecoClusterInputTag, offlineRecoClustersHandle);
+      const reco::SuperClusterCollection& offlineRecoClusters = *offlineRecoClustersHandle.product();
+      matchEtaPhi.clear();
+      for(auto& cluster : offlineRecoClusters) matchEtaPhi.push_back(cluster.position().eta(), cluster.position().phi());
+
+      // Every generated electron (photon) we look for in the reconstructed data
+      // within some deltaR cut, and some relative pt error cut,
+      // and if we find it, it goes in the numerator
+      denominators.clear();
+      for(const auto& truth : context.truth)
+      {
+         const auto& genElectron = truth.gen;
+         EfficiencyDenominator denominator;
+         denominator.truth = &truth;
+
+         // Find the cluster corresponding to generated electron
+         matcher.compute(matchEtaPhi, genElectron.eta(), genElectron.phi());
+         for(size_t i=0; i<offlineRecoClusters.size(); ++i)
+         {
+            const auto& cluster = offlineRecoClusters[i];
+            if ( !matcher.within(i, 0.1) ) continue;
+            reco::Candidate::PolarLorentzVector p4;
+            p4.SetPt(cluster.energy()*sin(cluster.position().theta()));
+            p4.SetEta(cluster.position().eta());
+            p4.SetPhi(cluster.position().phi());
+            p4.SetM(0.);
+            if ( fabs(p4.pt() - genElectron.pt()) < genMatchRelPtcut*genElectron.pt() )
+            {
+               if ( useOfflineClusters )
+                  denominator.p4 = p4;
+               denominator.recoPt = p4.pt();
+               denominator.recoFound = true;
+               diagnostics.log(kOfflineMatch, "pt eta phi (pt-genPt)/genPt",
+                     {float(p4.pt()), float(p4.eta()), float(p4.phi()), float((denominator.recoPt-genElectron.pt())/genElectron.pt())});
+               break;
+            }
+         }
+         // if we can't offline reconstruct the generated electron, 
+         // it might as well have not existed.
+         if ( useOfflineClusters && !denominator.recoFound ) continue;
+
+         if ( !useOfflineClusters )
+         {
+            // Position upon entering ECal
+            denominator.p4 = truth.ecal;
+         }
+
+         // but only if in the barrel!
+         if ( !useEndcap && fabs(denominator.p4.eta()) > 1.479 ) continue;
+         denominators.push_back(denominator);
+      }
+      if ( denominators.empty() )
+      {
+         eventCount--;
+         return;
+      }
+
+      // One-to-one assignment of the crystal clusters to the denominator particles
+      trueEtaPhi.clear();
+      for(const auto& denominator : denominators) trueEtaPhi.push_back(denominator.p4.eta(), denominator.p4.phi());
+      matchEtaPhi.clear();
+      for(const auto& features : context.clusterFeatures) matchEtaPhi.push_back(features.eta, features.phi);
+      const auto& clusterAssignment = oneToOne.match(trueEtaPhi, matchEtaPhi, genMatchDeltaRcut, [&](unsigned t, unsigned c){
+         return fabs(context.clusterFeatures[c].pt-denominators[t].p4.pt())/denominators[t].p4.pt() < genMatchRelPtcut;
+      });
+
+      for(size_t t=0; t<denominators.size(); ++t)
+      {
+         const auto& genElectron = denominators[t].truth->gen;
+         const auto& trueElectron = denominators[t].p4;
+         const bool offlineRecoFound = denominators[t].recoFound;
+         const float reco_electron_pt = denominators[t].recoPt;
+
+         sketches.fill(efficiency_denominator_hist, trueElectron.pt());
+         treeinfo.gen_pt = genElectron.pt();
+         treeinfo.E_gen = genElectron.pt()*cosh(genElectron.eta());
+         treeinfo.denom_pt = trueElectron.pt();
+         if ( fabs(trueElectron.eta()) > 1.479 )
+            treeinfo.endcap = true;
+         else
+            treeinfo.endcap = false;
+         sketches.fill(efficiency_denominator_eta_hist, trueElectron.eta());
+         if ( offlineRecoFound ) {
+            treeinfo.reco_pt = reco_electron_pt;
+            sketches.fill(efficiency_denominator_reco_hist, reco_electron_pt);
+         }
+         else
+         {
+            treeinfo.reco_pt = 0.;
+         }
+
+         if ( clusterAssignment[t] < 0 ) continue;
+         const unsigned clusterIndex = clusterAssignment[t];
+         const auto& cluster = crystalClusters[clusterIndex];
+         const auto& features = context.clusterFeatures[clusterIndex];
+         const float clusterDeltaR = std::sqrt(l1eg::deltaR2(features.eta, features.phi, trueElectron.eta(), trueElectron.phi()));
+         // Rank of the cluster in pt
+         clusterCount = 1 + std::count_if(begin(context.clusterFeatures), end(context.clusterFeatures), [&features](const l1eg::ClusterFeatures& f){return f.pt > features.pt;});
+
+         diagnostics.log(kClusterMatch, "dr pt rank", {clusterDeltaR, features.pt, float(clusterCount)});
+         doTrackMatching(crystalClusters, clusterIndex, l1trackHandle);
+         treeinfo.nthCandidate = clusterCount;
+         treeinfo.deltaR = clusterDeltaR;
+         treeinfo.deltaPhi = reco::deltaPhi(cluster, trueElectron);
+         
+         fill_tree(features);
+         checkRecHitsFlags(cluster, features, ecalRecHits, ecalRecHitsEE);
+
+         if ( passesCuts(features) )
+         {
+            dyncrystal_efficiency_hist->Fill(trueElectron.pt());
+            dyncrystal_efficiency_eta_hist->Fill(trueElectron.eta());
+            if ( offlineRecoFound )
+            {
+               for(auto& pair : dyncrystal_efficiency_reco_hists)
+               {
+                  // (threshold, histogram)
+                  if (cluster.pt() > pair.first)
+                     pair.second->Fill(reco_electron_pt);
+               }
+            }
+            for(auto& pair : dyncrystal_efficiency_gen_hists)
+            {
+               // (threshold, histogram)
+               if (cluster.pt() > pair.first)
+                  pair.second->Fill(trueElectron.pt());
+            }
+            sketches.fill(dyncrystal_deltaR_hist, clusterDeltaR);
+            sketches.fill(dyncrystal_deta_hist, trueElectron.eta()-cluster.eta());
+            sketches.fill(dyncrystal_dphi_hist, reco::deltaPhi(cluster.phi(), trueElectron.phi()));
+            if ( cluster.bremStrength() < 0.2 )
+            {
+               dyncrystal_efficiency_bremcut_hist->Fill(trueElectron.pt());
+               sketches.fill(dyncrystal_deltaR_bremcut_hist, clusterDeltaR);
+               sketches.fill(dyncrystal_dphi_bremcut_hist, reco::deltaPhi(cluster.phi(), trueElectron.phi()));
+            }
+            sketches.fill(dyncrystal_2DdeltaR_hist, trueElectron.eta()-cluster.eta(), reco::deltaPhi(cluster, trueElectron));
+
+            sketches.fill(reco_gen_pt_hist, trueElectron.pt(), (cluster.pt() - trueElectron.pt())/trueElectron.pt() );
+            sketches.fill(brem_dphi_hist, cluster.bremStrength(), reco::deltaPhi(cluster, trueElectron) );
+         }
+      }
+      
+      for(const auto& inputTag : L1EGammaInputTags)
+      {
+         const std::string &name = inputTag.encode();
+         const auto * eGammaCollection = context.egCollection(name);
+         if ( eGammaCollection == nullptr ) continue;
+         matchEtaPhi.assign(*eGammaCollection);
+         const auto& assignment = oneToOne.match(trueEtaPhi, matchEtaPhi, genMatchDeltaRcut, [&](unsigned t, unsigned c){
+            return fabs((*eGammaCollection)[c].pt()-denominators[t].p4.pt())/denominators[t].p4.pt() < genMatchRelPtcut;
+         });
+         for(size_t t=0; t<denominators.size(); ++t)
+         {
+            if ( assignment[t] < 0 ) continue;
+            const auto& trueElectron = denominators[t].p4;
+            const auto& EGCandidate = (*eGammaCollection)[assignment[t]];
+            diagnostics.log(kEGMatch, name.c_str(), {float(EGCandidate.pt()), float(trueElectron.pt())});
+            EGalg_efficiency_hists[name]->Fill(trueElectron.pt());
+            EGalg_efficiency_eta_hists[name]->Fill(trueElectron.eta());
+            if ( denominators[t].recoFound )
+            {
+               for(auto& pair : EGalg_efficiency_reco_hists[name])
+               {
+                  // (threshold, histogram)
+                  if (EGCandidate.pt() > pair.first)
+                     pair.second->Fill(denominators[t].recoPt);
+               }
+            }
+            for(auto& pair : EGalg_efficiency_gen_hists[name])
+            {
+               // (threshold, histogram)
+               if (EGCandidate.pt() > pair.first)
+                  pair.second->Fill(trueElectron.pt());
+            }
+            sketches.fill(EGalg_deltaR_hists[name], std::sqrt(l1eg::deltaR2(EGCandidate.eta(), EGCandidate.phi(), trueElectron.eta(), trueElectron.phi())));
+            sketches.fill(EGalg_deta_hists[name], trueElectron.eta()-EGCandidate.eta());
+            sketches.fill(EGalg_dphi_hists[name], reco::deltaPhi(EGCandidate.phi(), trueElectron.phi()));
+            sketches.fill(EGalg_reco_gen_pt_hists[name], trueElectron.pt(), (EGCandidate.pt() - trueElectron.pt())/trueElectron.pt() );
+            sketches.fill(EGalg_2DdeltaR_hists[name], trueElectron.eta()-EGCandidate.eta(), reco::deltaPhi(EGCandidate, trueElectron));
+         }
+      }
+   }
+   else // !doEfficiencyCalc
+   {
+      // The crystal tree gets every cluster, in pt order, up to the leading one passing the cuts
+      for(unsigned clusterIndex : l1eg::ptOrdered(context.clusterFeatures, scratch))
+      {
+         const auto& cluster = crystalClusters[clusterIndex];
+         const auto& features = context.clusterFeatures[clusterIndex];
+         if ( !useEndcap && fabs(cluster.eta()) >= 1.479 ) continue;
+         doTrackMatching(crystalClusters, clusterIndex, l1trackHandle);
+         clusterCount++;
+         treeinfo.nthCandidate = clusterCount;
+         if ( fabs(cluster.eta()) > 1.479 )
+            treeinfo.endcap = true;
+         else
+            treeinfo.endcap = false;
+         fill_tree(features);
+         checkRecHitsFlags(cluster, features, ecalRecHits, ecalRecHitsEE);
+         if ( passesCuts(features) ) break;
+      }
+
+      // Single, double and track-matched rates, selected as in bin/l1egStandalone.  Only
+      // the passing clusters in acceptance can be rate candidates, so only they get a track dR
+      flatEvent.clusters.assign(context.clusterFeatures.begin(), context.clusterFeatures.end());
+      flatEvent.emulatedCuts = context.emulatedCuts;
+      flatEvent.clusterTrackDeltaR.clear();
+      if ( l1trackHandle.isValid() )
+      {
+         for(size_t i=0; i<flatEvent.clusters.size(); ++i)
+         {
+            const auto& f = flatEvent.clusters[i];
+            const bool candidate = rateCore->inAcceptance(f.eta) && rateCore->passesCuts(flatEvent, f);
+            flatEvent.clusterTrackDeltaR.push_back(candidate ? nearestTrack(crystalClusters, i, l1trackHandle).second : 999.);
+         }
+      }
+      const auto& egNames = rateCore->config().egNames;
+      flatEvent.eg.resize(egNames.size());
+      for(size_t alg=0; alg<egNames.size(); ++alg)
+      {
+         auto& candidates = flatEvent.eg[alg];
+         candidates.clear();
+         const auto * eGammaCollection = context.egCollection(egNames[alg]);
+         if ( eGammaCollection == nullptr ) continue;
+         for(const auto& candidate : *eGammaCollection)
+            candidates.push_back(l1eg::FlatCandidate{float(candidate.pt()), float(candidate.eta()), float(candidate.phi())});
+      }
+      rateCore->rates(flatEvent, scratch, eventRates);
+
+      const auto& passing = eventRates.crystal;
+      const auto& trackMatched = eventRates.trackMatched;
+      if ( passing.n > 0 ) sketches.fill(dyncrystal_rate_hist, passing.pt[0]);
+      if ( passing.n > 1 )
+      {
+         dyncrystal_doubleRate_hist->Fill(passing.pt[1]);
+         dyncrystal_doubleRateGrid_hist->Fill(passing.pt[0], passing.pt[1]);
+      }
+      if ( trackMatched.n > 0 ) sketches.fill(dyncrystal_trackMatched_rate_hist, trackMatched.pt[0]);
+      if ( eventRates.trackMatchedPlusEG ) dyncrystal_trackMatchedPlusEG_rateGrid_hist->Fill(trackMatched.pt[0], eventRates.trackMatchedPlusEGOtherPt);
+      if ( trackMatched.n > 1 )
+      {
+         dyncrystal_trackMatched_doubleRate_hist->Fill(trackMatched.pt[1]);
+         dyncrystal_trackMatched_doubleRateGrid_hist->Fill(trackMatched.pt[0], trackMatched.pt[1]);
+      }
+
+      for(size_t alg=0; alg<egNames.size(); ++alg)
+      {
+         const std::string &name = egNames[alg];
+         const auto& leading = eventRates.eg[alg];
+         if ( leading.n > 0 ) sketches.fill(EGalg_rate_hists[name], leading.pt[0]);
+         if ( leading.n > 1 )
+         {
+            EGalg_doubleRate_hists[name]->Fill(leading.pt[1]);
+            EGalg_doubleRateGrid_hists[name]->Fill(leading.pt[0], leading.pt[1]);
+         }
+      }
+   }
+}
+
+// ------------ method called once each job just before starting event loop  ------------
+void 
+L1EGRateStudies::beginJob()
+{
+   diagnostics.open(diagnosticsFile, diagnosticsCategories, diagnosticsPrescale, diagnosticsMaxPerCategory);
+
+   // Everything is booked by now, merge in the state of a preempted previous attempt
+   edm::Service<TFileService> fs;
+   checkpointDirectory = fs->getBareDirectory();
+   checkpoint.addCounter("eventCount", &eventCount);
+   checkpoint.addState([this](TDirectory * out) { sketches.write(out); }, [this](TDirectory * in) { sketches.read(in); });
+   // Only a snapshot of the same job (parameters and input) is merged
+   const edm::ParameterSet& processParameters = edm::getProcessParameterSet();
+   if ( processParameters.existsAs<edm::ParameterSet>("@main_input") )
+      checkpointFingerprint += processParameters.getParameterSet("@main_input").dump();
+   checkpoint.setFingerprint(checkpointFingerprint);
+   checkpoint.restore(checkpointDirectory);
+   crystalTreeWriter.open(asyncTreeCapacity, asyncTreeWriter);
+}
+
+// ------------ method called once each job just after ending the event loop  ------------
+void 
+L1EGRateStudies::endJob() 
+{
+   crystalTreeWriter.close();
+   if ( asyncTreeWriter )
+      std::cout << "L1EGRateStudies crystal_tree writer: " << crystalTreeWriter.filled() << " entries, "
+                << crystalTreeWriter.stalls() << " fills waited on a full queue" << std::endl;
+   std::cout << "L1EGRateStudies scratch memory: " << scratch.summary() << std::endl;
+   diagnostics.close();
+   if ( !diagnosticsFile.empty() )
+      std::cout << "L1EGRateStudies diagnostics: " << diagnostics.written() << " records written to " << diagnosticsFile
+                << ", " << diagnostics.dropped() << " dropped" << std::endl;
+
+   // Rate or efficiency study?
+   if ( !doEfficiencyCalc )
+   {
+      // We currently have a rate pdf, we want cdf, so we integrate (downward in pt is inclusive)
+      // We normalize to 30MHz as this will be the crossing rate of filled bunches in SLHC
+      // (in parallel processing mode, fill dummy hist with event counts so they can be added later)
+      edm::Service<TFileService> fs;
+      TH1F* event_count = fs->make<TH1F>("eventCount", "Event Count", 1, -1, 1);
+      event_count->SetBinContent(1, eventCount);
+      integrateDown(dyncrystal_rate_hist);
+      integrateDown(dyncrystal_doubleRate_hist);
+      integrateDown(dyncrystal_doubleRateGrid_hist);
+      integrateDown(dyncrystal_trackMatched_rate_hist);
+      integrateDown(dyncrystal_trackMatched_doubleRate_hist);
+      integrateDown(dyncrystal_trackMatched_doubleRateGrid_hist);
+      integrateDown(dyncrystal_trackMatchedPlusEG_rateGrid_hist);
+      for(auto& hist : EGalg_rate_hists)
+      {
+         integrateDown(hist.second);
+      }
+      for(auto& hist : EGalg_doubleRate_hists)
+      {
+         integrateDown(hist.second);
+      }
+      for(auto& hist : EGalg_doubleRateGrid_hists)
+      {
+         integrateDown(hist.second);
+      }
+   }
+
+   // hadd concatenates the sketch trees of parallel jobs, see test/sketchHistograms.py
+   edm::Service<TFileService> fs;
+   sketches.write(fs->getBareDirectory());
+
+   // The job ran to completion, the TFileService output supersedes the snapshot
+   checkpoint.remove();
+}
+
+// ------------ method called when starting to processes a run  ------------
+/*
+void 
+L1EGRateStudies::beginRun(edm::Run const&, edm::EventSetup const&)
+{
+}
+*/
+
+// ------------ method called when ending the processing of a run  ------------
+/*
+void 
+L1EGRateStudies::endRun(edm::Run const&, edm::EventSetup const&)
+{
+}
+*/
+
+// ------------ method called when starting to processes a luminosity block  ------------
+/*
+void 
+L1EGRateStudies::beginLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&)
+{
+}
+*/
+
+// ------------ method called when ending the processing of a luminosity block  ------------
+/*
+void 
+L1EGRateStudies::endLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&)
+{
+}
+*/
+
+// ------------ method fills 'descriptions' with the allowed parameters for the module  ------------
+void
+L1EGRateStudies::fillDescriptions(edm::ConfigurationDescriptions& descriptions) {
+  //The following says we do not know what parameters are allowed so do no validation
+  // Please change this to state exactly what you do use, even if it is no parameters
+  edm::ParameterSetDescription desc;
+  desc.setUnknown();
+  descriptions.addDefault(desc);
+}
+
+// ------------ user methods (ncsmith)
+void 
+L1EGRateStudies::integrateDown(TH1F * hist) {
+   // integral includes overflow and underflow bins
+   double integral=0.;
+   for(int i=hist->GetNbinsX()+1; i>=0; i--)
+   {
+      integral += hist->GetBinContent(i);
+      hist->SetBinContent(i, integral);
+   }
+}
+
+void 
+L1EGRateStudies::integrateDown(TH2F * hist) {
+   // Cumulative in both axes from the top right, over and underflow included,
+   // so each bin holds the count with x and y above its lower edges
+   for(int i=hist->GetNbinsX()+1; i>=0; i--)
+   {
+      for(int j=hist->GetNbinsY()+1; j>=0; j--)
+      {
+         double integral = hist->GetBinContent(i, j);
+         if ( i <= hist->GetNbinsX() ) integral += hist->GetBinContent(i+1, j);
+         if ( j <= hist->GetNbinsY() ) integral += hist->GetBinContent(i, j+1);
+         if ( i <= hist->GetNbinsX() && j <= hist->GetNbinsY() ) integral -= hist->GetBinContent(i+1, j+1);
+         hist->SetBinContent(i, j, integral);
+      }
+   }
+}
+
+void
+L1EGRateStudies::fill_tree(const l1eg::ClusterFeatures& features) {
+   typedef l1eg::ClusterFeatures F;
+   treeinfo.crystal_pt = features.crystalPt;
+   treeinfo.cluster_pt = features.pt;
+   treeinfo.crystalCount = features.param(F::kCrystalCount);
+   treeinfo.cluster_energy = features.energy;
+   treeinfo.eta = features.eta;
+   treeinfo.hovere = features.hovere;
+   treeinfo.iso = features.iso;
+   treeinfo.bremStrength = features.bremStrength;
+   treeinfo.passed = passesCuts(features);
+   treeinfo.uslPt = features.param(F::kUpperSideLobePt);
+   treeinfo.lslPt = features.param(F::kLowerSideLobePt);
+   treeinfo.corePt = features.param(F::kUncorrectedPt);
+   treeinfo.E_core = features.param(F::kUncorrectedE);
+   treeinfo.phiStripContiguous0 = features.param(F::kPhiStripContiguous0);
+   treeinfo.phiStripOneHole0 = features.param(F::kPhiStripOneHole0);
+   treeinfo.phiStripContiguous3p = features.param(F::kPhiStripContiguous3p);
+   treeinfo.phiStripOneHole3p = features.param(F::kPhiStripOneHole3p);
+   showerShapes.compute(features.seedIndex, treeinfo.showerShapes.data());
+   // Gen and reco pt get filled earlier
+   crystalTreeWriter.fill(treeinfo);
+}
+
+bool
+L1EGRateStudies::passesCuts(const l1eg::ClusterFeatures& features) const {
+   if ( emulatedCutsThisEvent ) return features.passesEmulated(l1eg::ClusterFeatures::kRateStudies);
+   return features.passes(l1eg::ClusterFeatures::kRateStudies);
+}
+
+bool
+L1EGRateStudies::checkTowerExists(const l1slhc::L1EGCrystalCluster &cluster) const {
+   if ( cluster.seedCrystal().subdetId() != EcalBarrel ) return false;
+   return towerCompressedEt[l1eg::eb::tower(EBDetId(cluster.seedCrystal()).hashedIndex())] > 0;
+}
+
+void
+L1EGRateStudies::checkRecHitsFlags(const l1slhc::L1EGCrystalCluster &cluster, const l1eg::ClusterFeatures& features, const EcalRecHitCollection &ecalRecHitsEB, const EcalRecHitCollection &ecalRecHitsEE) {
+   if ( passesCuts(features) )
+   {
+      const bool towerExists = checkTowerExists(cluster);
+      diagnostics.log(kPassedCuts, "pt towerExists", {float(cluster.pt()), float(towerExists)});
+      // The seed is looked up directly in the sorted collection of its own subdetector
+      const EcalRecHitCollection& ecalRecHits = ( cluster.seedCrystal().subdetId() == EcalEndcap ) ? ecalRecHitsEE : ecalRecHitsEB;
+      auto seedHit = ecalRecHits.find(cluster.seedCrystal());
+      if ( seedHit != ecalRecHits.end() )
+      {
+         const EcalRecHit& hit = *seedHit;
+         // See EcalRecHit.h for the meaning of each flag
+         static const int flags[] = {
+            EcalRecHit::kGood, EcalRecHit::kPoorReco, EcalRecHit::kOutOfTime, EcalRecHit::kFaultyHardware,
+            EcalRecHit::kNoisy, EcalRecHit::kPoorCalib, EcalRecHit::kSaturated, EcalRecHit::kLeadingEdgeRecovered,
+            EcalRecHit::kNeighboursRecovered, EcalRecHit::kTowerRecovered, EcalRecHit::kDead, EcalRecHit::kKilled,
+            EcalRecHit::kTPSaturated, EcalRecHit::kL1SpikeFlag, EcalRecHit::kWeird, EcalRecHit::kDiWeird,
+            EcalRecHit::kHasSwitchToGain6, EcalRecHit::kHasSwitchToGain1
+         };
+         for(int flag : flags)
+         {
+            if ( hit.checkFlag(flag) )
+            {
+               diagnostics.log(kSeedFlag, "flag towerExists", {float(flag), float(towerExists)});
+
+               if ( towerExists )
+                  RecHitFlagsTowerHist->Fill(flag);
+               else
+                  RecHitFlagsNoTowerHist->Fill(flag);
+            }
+         }
+      }
+   }
+}
+
+void
+L1EGRateStudies::doTrackMatching(const l1slhc::L1EGCrystalClusterCollection& clusters, size_t clusterIndex, edm::Handle<L1TkTrackCollectionType> l1trackHandle)
+{
+  const auto& cluster = clusters[clusterIndex];
+  // Without a matched track (or track collection) the entry gets the sentinels of
+  // nearestTrack(), not the track of the previous cluster
+  treeinfo.trackDeltaR = 999.;
+  treeinfo.trackDeltaPhi = 999.;
+  treeinfo.trackP = 0.;
+  treeinfo.trackRInv = 0.;
+  treeinfo.trackChi2 = 0.;
+  treeinfo.trackIsoConeTrackCount = 0.;
+  treeinfo.trackIsoConePtSum = 0.;
+  std::fill(begin(treeinfo.trackIsoCount), end(treeinfo.trackIsoCount), 0.f);
+  std::fill(begin(treeinfo.trackIsoPtSum), end(treeinfo.trackIsoPtSum), 0.f);
+
+  // track matching stuff
+  if ( l1trackHandle.isValid() )
+  {
+     const auto caloPosition = L1TkElectronTrackMatchAlgo::calorimeterPosition(cluster.phi(), cluster.eta(), cluster.energy());
+     const auto nearest = nearestTrack(clusters, clusterIndex, l1trackHandle);
+     const int matched_index = nearest.first;
+     const double min_track_dr = nearest.second;
+     if ( matched_index < 0 ) return;
+     edm::Ptr<TTTrack<Ref_PixelDigi_>> matched_track(l1trackHandle, matched_index);
+
+     // Isolation around the matched track, from the per-event track cache
+     trackIsolation.compute(trackEtaPhi, trackPt, trackEtaPhi.eta()[matched_index], trackEtaPhi.phi()[matched_index], matched_index);
+     std::copy(begin(trackIsolation.count()), end(trackIsolation.count()), begin(treeinfo.trackIsoCount));
+     std::copy(begin(trackIsolation.ptSum()), end(trackIsolation.ptSum()), begin(treeinfo.trackIsoPtSum));
+
+     // dR cone of .3, momentum at least 1GeV, as before the cone ladder
+     float isoConeTrackCount(-1); // matched track will be in deltaR cone
+     float isoConePtSum(-1*trackPt[matched_index]);
+     const auto& dr2 = trackIsolation.dr2();
+     for(size_t track_index=0; track_index<dr2.size(); ++track_index)
+     {
+        if ( dr2[track_index] < 0.3*0.3 && trackP[track_index] > 1. )
+        {
+          isoConeTrackCount++;
+          isoConePtSum += trackPt[track_index];
+        }
+     }
+     treeinfo.trackDeltaR = min_track_dr;
+     treeinfo.trackDeltaPhi = L1TkElectronTrackMatchAlgo::deltaPhi(caloPosition, matched_track);
+     treeinfo.trackP = trackP[matched_index];
+     treeinfo.trackRInv = matched_track->getRInv();
+     treeinfo.trackChi2 = matched_track->getChi2();
+     treeinfo.trackIsoConeTrackCount = isoConeTrackCount;
+     treeinfo.trackIsoConePtSum = isoConePtSum;
+     diagnostics.log(kTrackMatch, "dr chi2 dp", {float(min_track_dr), treeinfo.trackChi2, float((treeinfo.trackP-cluster.energy())/cluster.energy())});
+  }
+}
+
+const std::pair<int, double>&
+L1EGRateStudies::nearestTrack(const l1slhc::L1EGCrystalClusterCollection& clusters, size_t clusterIndex, edm::Handle<L1TkTrackCollectionType> l1trackHandle)
+{
+  auto& nearest = nearestTracks[clusterIndex];
+  if ( nearest.first != kNotComputed ) return nearest;
+  double min_track_dr = 999.;
+  int matched_index = -1;
+  nearest = std::make_pair(matched_index, min_track_dr);
+  if ( !l1trackHandle.isValid() ) return nearest;
+  const auto& cluster = clusters[clusterIndex];
+  const auto caloPosition = L1TkElectronTrackMatchAlgo::calorimeterPosition(cluster.phi(), cluster.eta(), cluster.energy());
+  for(size_t track_index=0; track_index<l1trackHandle->size(); ++track_index)
+  {
+     edm::Ptr<TTTrack<Ref_PixelDigi_>> ptr(l1trackHandle, track_index);
+     double dr = L1TkElectronTrackMatchAlgo::deltaR(caloPosition, ptr);
+     if ( dr < min_track_dr )
+     {
+        min_track_dr = dr;
+        matched_index = track_index;
+     }
+  }
+  nearest = std::make_pair(matched_index, min_track_dr);
+  return nearest;
+}
+//define this as a plug-in
+DEFINE_FWK_MODULE(L1EGRateStudies);
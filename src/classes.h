@@ -0,0 +1,9 @@
+#include "DataFormats/Common/interface/Wrapper.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/L1EGEventContext.h"
+
+namespace {
+   struct dictionary {
+      l1eg::EventContext context;
+      edm::Wrapper<l1eg::EventContext> wrappedContext;
+   };
+}
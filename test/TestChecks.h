@@ -0,0 +1,48 @@
+#ifndef SLHCUpgradeSimulations_L1EGRateStudies_TestChecks_h
+#define SLHCUpgradeSimulations_L1EGRateStudies_TestChecks_h
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+/**\file TestChecks.h SLHCUpgradeSimulations/L1EGRateStudies/test/TestChecks.h
+
+ Description: Failure counting shared by the test/test*.cpp programs
+
+ Implementation:
+     check() counts every failed check and prints the first kMaxPrinted of
+     them, enough to diagnose without flooding the log when a whole table
+     or sample is off.  Each test prints its own summary line with
+     failures() and returns exitStatus() from main.
+*/
+//
+
+#include <cstdio>
+#include <string>
+
+namespace l1eg {
+namespace test {
+
+   constexpr int kMaxPrinted = 20;
+
+   inline int& failureCount()
+   {
+      static int n = 0;
+      return n;
+   };
+
+   inline int failures() { return failureCount(); };
+
+   inline void check(bool ok, const std::string& what)
+   {
+      if ( ok ) return;
+      if ( ++failureCount() <= kMaxPrinted ) std::printf("FAILED: %s\n", what.c_str());
+      else if ( failureCount() == kMaxPrinted+1 ) std::printf("FAILED: ... (further failures only counted)\n");
+   };
+
+   // 0 if every check passed
+   inline int exitStatus() { return failures() == 0 ? 0 : 1; };
+
+} // namespace test
+} // namespace l1eg
+
+#endif
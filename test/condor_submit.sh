@@ -1,4 +1,5 @@
 #!/bin/bash
+# One job per input file; for uniform event-range shards on local cores see localScheduler.py
 
 # Never forget to build again!
 pushd $CMSSW_BASE/src
@@ -10,8 +11,12 @@ doeff=true
 dorate=true
 dofakes=false
 rmold=true
-while getopts ":trefj:" opt; do
+docheckpoint=false
+while getopts ":trefcj:" opt; do
   case $opt in
+    c)
+      docheckpoint=true
+      ;;
     j)
       jobopts="$jobopts --job-count=$OPTARG"
       ;;
@@ -41,15 +46,43 @@ while getopts ":trefj:" opt; do
   esac
 done
 
+# farmoutAnalysisJobs, with -c through a copy of the cfg that turns on the
+# L1EGRateStudies checkpoint (interface/Checkpoint.h) in the job's scratch
+# directory.  Condor then has to transfer that directory back when a job is
+# evicted, not only when it exits, so that the restarted job finds its
+# snapshot: the jobs are created with --no-submit, the submit files get
+# when_to_transfer_output = ON_EXIT_OR_EVICT, and the dags are submitted here.
+farmout() {
+    local jobname=$1 cfg=$2
+    shift 2
+    if ! $docheckpoint; then
+        farmoutAnalysisJobs "$@" $jobname $CMSSW_BASE $cfg
+        return
+    fi
+    local checkpointcfg=${cfg%_cfg.py}_checkpoint_cfg.py
+    cp $cfg $checkpointcfg
+    echo '' >> $checkpointcfg
+    echo '# condor_submit.sh -c' >> $checkpointcfg
+    echo "if process.analyzer.type_() == 'L1EGRateStudies' :" >> $checkpointcfg
+    echo '  process.analyzer.checkpointFile = cms.untracked.string("L1EGRateStudies_checkpoint.root")' >> $checkpointcfg
+    farmoutAnalysisJobs --no-submit "$@" $jobname $CMSSW_BASE $checkpointcfg
+    for submitfile in $(grep -rl '^[Qq]ueue' /nfs_scratch/nsmith/${jobname}*); do
+        sed -i '/^when_to_transfer_output/Id' $submitfile
+        sed -i '0,/^[Qq]ueue/s//when_to_transfer_output = ON_EXIT_OR_EVICT\n&/' $submitfile
+    done
+    for dag in $(find /nfs_scratch/nsmith/${jobname}* -type f -name '*dag'); do
+        condor_submit_dag $dag
+    done
+}
+
 if $doeff; then
     if $rmold; then
         rm /nfs_scratch/nsmith/egalg_eff* -r
         gsido rm /hdfs/store/user/nsmith/egalg_eff* -r
     fi
-    farmoutAnalysisJobs \
+    farmout egalg_eff_hists eff_hists_cfg.py \
         --input-dir=/store/mc/TTI2023Upg14D/SingleElectronFlatPt0p2To50/GEN-SIM-DIGI-RAW/PU140bx25_PH2_1K_FB_V3-v2/00000 \
-        --input-files-per-job=1 $jobopts \
-        egalg_eff_hists $CMSSW_BASE eff_hists_cfg.py
+        --input-files-per-job=1 $jobopts
 fi
 
 if $dorate; then
@@ -57,10 +90,9 @@ if $dorate; then
         rm /nfs_scratch/nsmith/egalg_rate* -r
         gsido rm /hdfs/store/user/nsmith/egalg_rate* -r
     fi
-    farmoutAnalysisJobs \
+    farmout egalg_rate_hists rate_hists_cfg.py \
         --input-dir=/store/mc/TTI2023Upg14D/Neutrino_Pt2to20_gun/GEN-SIM-DIGI-RAW/PU140bx25_PH2_1K_FB_V3-v2/00000 \
-        --input-files-per-job=1 $jobopts \
-        egalg_rate_hists $CMSSW_BASE rate_hists_cfg.py
+        --input-files-per-job=1 $jobopts
 fi
 
 if $dofakes; then
@@ -68,9 +100,8 @@ if $dofakes; then
         rm /nfs_scratch/nsmith/egalg_fakes* -r
         gsido rm /hdfs/store/user/nsmith/egalg_fakes* -r
     fi
-    farmoutAnalysisJobs \
+    farmout egalg_fakes fake_heatmap_cfg.py \
         --input-dir=/store/mc/TTI2023Upg14D/Neutrino_Pt2to20_gun/GEN-SIM-DIGI-RAW/PU140bx25_PH2_1K_FB_V3-v2/00000 \
-        --input-files-per-job=1 $jobopts \
-        egalg_fakes $CMSSW_BASE fake_heatmap_cfg.py
+        --input-files-per-job=1 $jobopts
 fi
 
@@ -97,9 +97,12 @@ process.pTracking = cms.Path( process.ElectronTrackingSequence )
 
 # ----------------------------------------------------------------------------------------------
 # 
-# Analyzer starts here
+# Per-event context shared by the analyzers (sorted clusters, EG candidates, calo hits, truth)
+# In memory only: an output module added to this process needs
+# 'drop *_L1EGEventContext_*_*' in its outputCommands
 
-process.analyzer = cms.EDAnalyzer('L1EGRateStudies',
+process.L1EGEventContext = cms.EDProducer("L1EGEventContextProducer",
+   L1CrystalClustersInputTag = cms.InputTag("L1EGammaCrystalsProducer","EGCrystalCluster"),
    L1EGammaInputTags = cms.VInputTag(
       # Old stage-2 trigger
       cms.InputTag("SLHCL1ExtraParticles","EGamma"),
@@ -114,10 +117,58 @@ process.analyzer = cms.EDAnalyzer('L1EGRateStudies',
       # Crystal-level algo.
       cms.InputTag("L1EGammaCrystalsProducer","EGammaCrystal")
    ),
+   makeCaloHits = cms.untracked.bool(True),
+   useEndcap = cms.untracked.bool(False),
+   # False: first gen particle only (particle gun samples)
+   # True: every status 1 electron and photon with pt > truthMinPt, |eta| < truthMaxEta
+   truthAllParticles = cms.untracked.bool(False),
+   truthMinPt = cms.untracked.double(5.),
+   truthMaxEta = cms.untracked.double(3.),
+   # Closed-form helix propagation of the gen particles to the ECAL, checked
+   # against BaseParticlePropagator (report at the end of the job) when tolerance > 0 (cm).
+   # The check propagates every particle twice, test/testHelixPropagator covers it offline
+   helixPropagator = cms.untracked.bool(True),
+   helixPropagatorTolerance = cms.untracked.double(0.),
+   # Integer emulation of the crystal EG cuts, compared to the float ones in the analyzer
+   fixedPointEmulation = cms.untracked.bool(True)
+)
+
+
+# ----------------------------------------------------------------------------------------------
+# 
+# Analyzer starts here
+
+process.analyzer = cms.EDAnalyzer('L1EGRateStudies',
+   L1EGammaInputTags = process.L1EGEventContext.L1EGammaInputTags,
    L1CrystalClustersInputTag = cms.InputTag("L1EGammaCrystalsProducer","EGCrystalCluster"),
+   L1EGContextInputTag = cms.InputTag("L1EGEventContext"),
    OfflineRecoClustersInputTag = cms.InputTag("correctedHybridSuperClusters"),
    L1TrackInputTag = cms.InputTag("TTTracksFromPixelDigisLargerPhi","Level1TTTracks"),
    doEfficiencyCalc = cms.untracked.bool(True),
+   # Snapshots to resume preempted jobs are off by default (checkpointFile empty),
+   # condor_submit.sh -c and localScheduler.py --checkpoint turn them on per job
+   checkpointInterval = cms.untracked.uint32(1000),
+   # Fill (and compress) crystal_tree on a separate thread; only safe when nothing else
+   # writes to the TFileService file during the event loop, see AsyncTreeWriter.h
+   asyncTreeWriter = cms.untracked.bool(False),
+   # Reduced-precision crystal_tree columns (PackedColumns.h), opt-in: rounding to 8-12
+   # mantissa bits costs up to 0.1 per mille relative on the cluster and gen pt, 0.5 on
+   # crystal pt, H/E, iso and the track dR, 2 on the strip sums and chi2; eta is quantised
+   # to 12 bits over [-3, 3] and the counts saturate at their int:8/int:16 limits.
+   # crystalTreePrecision = ["gen_pt=full"] overrides single columns
+   packCrystalTree = cms.untracked.bool(False),
+   # Extra crystal_tree columns recomputed from the barrel rec hits around the seed, see ShowerShapes.h
+   showerShapes = cms.untracked.vstring(
+      "e5x5=sum:-2:2:-2:2",
+      "e2x5max=maxsum:-1:1:-2:2:2:5",
+      "e1x5=sum:0:0:-2:2",
+      "e2x5OverE5x5=ratio:e2x5max:e5x5",
+      "e1x5OverE5x5=ratio:e1x5:e5x5",
+      "upperLobe=sum:-1:1:3:7",
+      "lowerLobe=sum:-1:1:-7:-3",
+      "secondCrystalPt=rank:-1:1:-2:2:2",
+      "phiStripRun=run:-1:1:8:0.5",
+   ),
    useOfflineClusters = cms.untracked.bool(False),
    useEndcap = cms.untracked.bool(False),
    turnOnThresholds = cms.untracked.vint32(20, 30, 16),
@@ -131,7 +182,11 @@ process.analyzer = cms.EDAnalyzer('L1EGRateStudies',
 
 process.load("SLHCUpgradeSimulations.L1EGRateStudies.L1EGCrystalsHeatMap_cff")
 process.L1EGCrystalsHeatMap.saveAllClusters = cms.untracked.bool(True)
-process.panalyzer = cms.Path(process.analyzer+process.L1EGCrystalsHeatMap)
+# Keep a bounded sample of those windows, per pt bin
+process.L1EGCrystalsHeatMap.saveAllClustersSamples = cms.untracked.uint32(200)
+process.L1EGCrystalsHeatMap.saveAllClustersPtBins = cms.untracked.vdouble(15, 20, 30, 50)
+process.L1EGCrystalsHeatMap.L1EGContextInputTag = cms.InputTag("L1EGEventContext")
+process.panalyzer = cms.Path(process.L1EGEventContext+process.analyzer+process.L1EGCrystalsHeatMap)
 
 process.TFileService = cms.Service("TFileService", 
    fileName = cms.string("$outputFileName"), 
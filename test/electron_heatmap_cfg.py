@@ -77,21 +77,43 @@ process.load('RecoEcal.Configuration.RecoEcal_cff')
 process.ecalClusters = cms.Path(process.ecalClustersNoPFBox)
 
 
+# ----------------------------------------------------------------------------------------------
+# 
+# Per-event context shared by the analyzers (sorted clusters, EG candidates, calo hits, truth)
+# In memory only: an output module added to this process needs
+# 'drop *_L1EGEventContext_*_*' in its outputCommands
+
+process.L1EGEventContext = cms.EDProducer("L1EGEventContextProducer",
+   L1CrystalClustersInputTag = cms.InputTag("L1EGammaCrystalsProducer","EGCrystalCluster"),
+   L1EGammaInputTags = cms.VInputTag(
+   ),
+   makeCaloHits = cms.untracked.bool(True),
+   useEndcap = cms.untracked.bool(False),
+   # False: first gen particle only (particle gun samples)
+   # True: every status 1 electron and photon with pt > truthMinPt, |eta| < truthMaxEta
+   truthAllParticles = cms.untracked.bool(False),
+   truthMinPt = cms.untracked.double(5.),
+   truthMaxEta = cms.untracked.double(3.),
+   # Closed-form helix propagation of the gen particles to the ECAL
+   helixPropagator = cms.untracked.bool(True)
+)
+
+
 # ----------------------------------------------------------------------------------------------
 # 
 # Analyzer starts here
 
 process.analyzer = cms.EDAnalyzer('L1EGCrystalsHeatMap',
    L1CrystalClustersInputTag = cms.InputTag("L1EGammaCrystalsProducer","EGCrystalCluster"),
-   L1EGammaOtherAlgs = cms.VInputTag(
-   ),
+   L1EGContextInputTag = cms.InputTag("L1EGEventContext"),
+   L1EGammaOtherAlgs = process.L1EGEventContext.L1EGammaInputTags,
    debug = cms.untracked.bool(False),
    useOfflineClusters = cms.untracked.bool(False),
    range = cms.untracked.int32(20),
    clusterPtCut = cms.untracked.double(15.)
 )
 
-process.panalyzer = cms.Path(process.analyzer)
+process.panalyzer = cms.Path(process.L1EGEventContext+process.analyzer)
 
 process.TFileService = cms.Service("TFileService", 
    fileName = cms.string("electronHeatmap.root"), 
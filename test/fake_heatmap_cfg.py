@@ -80,22 +80,41 @@ process.ecalClusters = cms.Path(process.ecalClustersNoPFBox)
 
 # ----------------------------------------------------------------------------------------------
 # 
-# Analyzer starts here
+# Per-event context shared by the analyzers (sorted clusters, EG candidates, calo hits, truth)
+# In memory only: an output module added to this process needs
+# 'drop *_L1EGEventContext_*_*' in its outputCommands
 
-process.analyzer = cms.EDAnalyzer('L1EGCrystalsHeatMap',
+process.L1EGEventContext = cms.EDProducer("L1EGEventContextProducer",
    L1CrystalClustersInputTag = cms.InputTag("L1EGammaCrystalsProducer","EGCrystalCluster"),
-   L1EGammaOtherAlgs = cms.VInputTag(
+   L1EGammaInputTags = cms.VInputTag(
       cms.InputTag("l1extraParticles", "Isolated"),
       cms.InputTag("l1extraParticles", "NonIsolated")
    ),
+   makeCaloHits = cms.untracked.bool(True),
+   useEndcap = cms.untracked.bool(False),
+   doTruth = cms.untracked.bool(False)
+)
+
+
+# ----------------------------------------------------------------------------------------------
+# 
+# Analyzer starts here
+
+process.analyzer = cms.EDAnalyzer('L1EGCrystalsHeatMap',
+   L1CrystalClustersInputTag = cms.InputTag("L1EGammaCrystalsProducer","EGCrystalCluster"),
+   L1EGContextInputTag = cms.InputTag("L1EGEventContext"),
+   L1EGammaOtherAlgs = process.L1EGEventContext.L1EGammaInputTags,
    debug = cms.untracked.bool(False),
+   # JSON lines record of each fake candidate and its trigger tower, empty to disable
+   diagnosticsFile = cms.untracked.string("fake_diagnostics.jsonl"),
+   diagnosticsMaxPerCategory = cms.untracked.uint32(10000),
    useGenMatch = cms.untracked.bool(False),
    useOfflineClusters = cms.untracked.bool(False),
    range = cms.untracked.int32(20),
    clusterPtCut = cms.untracked.double(25.)
 )
 
-process.panalyzer = cms.Path(process.analyzer)
+process.panalyzer = cms.Path(process.L1EGEventContext+process.analyzer)
 
 process.TFileService = cms.Service("TFileService", 
    fileName = cms.string("$outputFileName"), 
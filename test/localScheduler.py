@@ -0,0 +1,317 @@
+#!/usr/bin/env python
+# Event-range scheduler for a local pool of cmsRun or l1egStandalone jobs
+#
+#   python localScheduler.py -j 8 --events-per-shard 2000 rate_hists_cfg.py /path/to/*.root
+#   python localScheduler.py -j 8 --standalone --events-per-shard 50000 -o summaryRates.root egTriggerRates_*.root
+#
+# Instead of one job per input file (condor_submit.sh), the event count of
+# every input is indexed once (cached in a json file next to the work
+# directory, keyed on path, size and mtime) and the whole input is cut into
+# shards of the same number of events; a shard may span the end of one file
+# and the start of the next (PoolSource skipEvents/maxEvents, l1egStandalone
+# --skip/--events).  Shards are dealt to the workers in contiguous blocks so
+# neighbouring ranges of a file stay on one worker; a worker that runs out
+# steals the back half of the longest remaining queue, so the tail is at most
+# one shard long.  Failed shards are retried, and when everything is done the
+# shard outputs are hadd-ed into the file the drawing and normalisation
+# macros expect (egTriggerRates.root, egTriggerEff.root, ...).
+#
+# Every job runs in its own <workdir>/shard_NNNN directory.  With --checkpoint
+# the shard cfg turns on the L1EGRateStudies checkpoint in that directory, so
+# concurrent jobs never pick up each other's snapshot and a rerun of a failed
+# shard resumes from its own.
+#
+# With --stage-cache the inputs of each shard are staged into a local
+# stagingCache.py directory before the job starts, and the inputs of the
+# worker's next shard are prefetched while it runs.
+#
+# --command replaces the job with any shell command, with {files} {skip}
+# {events} {output} {shard} substituted, e.g. to try the scheduling on one
+# machine without CMSSW:
+#   python localScheduler.py --index test.json --command 'sleep 1; touch {output}' --no-merge x.root
+from __future__ import print_function
+import os
+import sys
+import json
+import time
+import shlex
+import argparse
+import threading
+import subprocess
+import collections
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import stagingCache
+
+Shard = collections.namedtuple("Shard", ["number", "files", "skip", "events"])
+
+# Merged output names as condor_combine.sh / normalizeParallelJobs.C use them
+mergedNames = {
+  "rate_hists_cfg.py" : "egTriggerRates.root",
+  "eff_hists_cfg.py" : "egTriggerEff.root",
+  "fake_heatmap_cfg.py" : "fakesHeatmap.root",
+}
+
+def indexEvents(files, treeName, cacheFile) :
+  '''Entries of treeName in each file, reusing cached counts of unchanged files'''
+  cache = {}
+  if os.path.exists(cacheFile) :
+    with open(cacheFile) as f :
+      cache = json.load(f)
+  counts = []
+  opened = 0
+  for name in files :
+    key = "%s:%s" % (os.path.abspath(name), treeName)
+    stat = os.stat(name) if os.path.exists(name) else None
+    entry = cache.get(key)
+    if entry is None or (stat is not None and (entry["size"] != stat.st_size or entry["mtime"] != int(stat.st_mtime))) :
+      entry = {"events" : countEntries(name, treeName), "size" : stat.st_size if stat else 0, "mtime" : int(stat.st_mtime) if stat else 0}
+      cache[key] = entry
+      opened += 1
+    counts.append(entry["events"])
+  if opened > 0 :
+    with open(cacheFile, "w") as f :
+      json.dump(cache, f, indent=1, sort_keys=True)
+  print("Indexed %d files (%d opened), %d events" % (len(files), opened, sum(counts)))
+  return counts
+
+def countEntries(name, treeName) :
+  import ROOT
+  f = ROOT.TFile.Open(name)
+  if not f or f.IsZombie() :
+    raise IOError("cannot open %s" % name)
+  tree = f.Get(treeName)
+  n = int(tree.GetEntries()) if tree else 0
+  f.Close()
+  return n
+
+def makeShards(files, counts, eventsPerShard) :
+  '''Uniform event ranges over the files taken in order'''
+  shards = []
+  total = sum(counts)
+  starts = [sum(counts[:i]) for i in range(len(counts))]
+  for first in range(0, total, eventsPerShard) :
+    last = min(total, first+eventsPerShard)
+    used = [i for i in range(len(files)) if counts[i] > 0 and starts[i] < last and starts[i]+counts[i] > first]
+    shards.append(Shard(len(shards), [files[i] for i in used], first-starts[used[0]], last-first))
+  return shards
+
+class WorkQueues :
+  '''Per-worker deques of shards, an empty worker steals the back half of the longest'''
+  def __init__(self, shards, nWorkers) :
+    self.lock = threading.Lock()
+    self.queues = [collections.deque() for w in range(nWorkers)]
+    for i, shard in enumerate(shards) :
+      self.queues[i*nWorkers//max(len(shards), 1)].append(shard)
+    self.steals = 0
+
+  def peek(self, worker) :
+    with self.lock :
+      return self.queues[worker][0] if len(self.queues[worker]) > 0 else None
+
+  def next(self, worker) :
+    with self.lock :
+      own = self.queues[worker]
+      if len(own) == 0 :
+        victim = max(self.queues, key=len)
+        n = (len(victim)+1)//2
+        for i in range(n) :
+          own.appendleft(victim.pop())
+        self.steals += n
+      return own.popleft() if len(own) > 0 else None
+
+  def retry(self, worker, shard) :
+    with self.lock :
+      self.queues[worker].append(shard)
+
+class Scheduler :
+  def __init__(self, args, shards, cache=None) :
+    self.args = args
+    self.cache = cache
+    self.queues = WorkQueues(shards, args.jobs)
+    self.attempts = collections.Counter()
+    self.outputs = {}
+    self.failed = []
+    self.durations = []
+    self.printLock = threading.Lock()
+
+  def output(self, shard) :
+    return os.path.join(self.args.workdir, "shard_%04d.root" % shard.number)
+
+  def shardDir(self, shard) :
+    '''Working directory of the shard's job'''
+    return os.path.join(self.args.workdir, "shard_%04d" % shard.number)
+
+  def command(self, shard) :
+    args = self.args
+    if args.command :
+      return args.command.format(files=" ".join(shard.files), skip=shard.skip, events=shard.events,
+                                 output=self.output(shard), shard=shard.number)
+    if args.standalone :
+      return " ".join([args.standalone_exe, "-j", str(args.threads), "--skip", str(shard.skip), "--events", str(shard.events),
+                       "-o", self.output(shard)] + args.standalone_args + shard.files)
+    return "cmsRun %s" % self.writeConfig(shard)
+
+  def writeConfig(self, shard) :
+    '''Copy of the farmout cfg for one shard: files, output name and event range filled in'''
+    with open(self.args.config) as f :
+      cfg = f.read()
+    cfg = cfg.replace("$inputFileNames", ", ".join('"%s"' % fileName(name) for name in shard.files))
+    cfg = cfg.replace("$outputFileName", self.output(shard))
+    cfg += "\n# localScheduler.py shard %d\n" % shard.number
+    cfg += "process.source.skipEvents = cms.untracked.uint32(%d)\n" % shard.skip
+    cfg += "process.maxEvents.input = cms.untracked.int32(%d)\n" % shard.events
+    if self.args.checkpoint :
+      cfg += "if hasattr(process, 'analyzer') and process.analyzer.type_() == 'L1EGRateStudies' :\n"
+      cfg += "  process.analyzer.checkpointFile = cms.untracked.string(%r)\n" % os.path.join(self.shardDir(shard), "L1EGRateStudies_checkpoint.root")
+    name = os.path.join(self.args.workdir, "shard_%04d_cfg.py" % shard.number)
+    with open(name, "w") as f :
+      f.write(cfg)
+    return name
+
+  def work(self, worker) :
+    while True :
+      shard = self.queues.next(worker)
+      if shard is None :
+        return
+      self.attempts[shard.number] += 1
+      log = os.path.join(self.args.workdir, "shard_%04d.log" % shard.number)
+      if not os.path.isdir(self.shardDir(shard)) :
+        os.makedirs(self.shardDir(shard))
+      start = time.time()
+      # Only the files acquired so far are released, a staging error counts
+      # as a failure of the shard and goes through the retries below
+      acquired = []
+      error = None
+      status = -1
+      try :
+        staged = shard
+        if self.cache is not None :
+          for name in shard.files :
+            acquired.append((name, self.cache.acquire(name)))
+          staged = shard._replace(files=[local for name, local in acquired])
+          following = self.queues.peek(worker)
+          if following is not None :
+            self.cache.prefetch(following.files)
+        with open(log, "w") as out :
+          status = subprocess.call(self.command(staged), shell=True, stdout=out, stderr=subprocess.STDOUT, cwd=self.shardDir(shard))
+      except Exception as e :
+        error = e
+      finally :
+        for name, local in acquired :
+          self.cache.release(name)
+      duration = time.time()-start
+      ok = error is None and status == 0 and os.path.exists(self.output(shard))
+      if ok :
+        result = "ok"
+      elif error is not None :
+        result = "FAILED (%s)" % error
+      else :
+        result = "FAILED (status %d, see %s)" % (status, log)
+      with self.printLock :
+        self.durations.append(duration)
+        if ok :
+          self.outputs[shard.number] = self.output(shard)
+        print("  shard %4d  worker %2d  %6d events  %7.1fs  %s" % (shard.number, worker, shard.events, duration, result))
+        sys.stdout.flush()
+      if not ok :
+        if self.attempts[shard.number] <= self.args.retries :
+          self.queues.retry(worker, shard)
+        else :
+          with self.printLock :
+            self.failed.append(shard)
+
+  def run(self) :
+    threads = [threading.Thread(target=self.work, args=(w,)) for w in range(self.args.jobs)]
+    for t in threads :
+      t.start()
+    for t in threads :
+      t.join()
+
+def fileName(name) :
+  '''PoolSource wants a LFN (/store/...) or a file: URL'''
+  if name.startswith("/store/") or "://" in name or name.startswith("file:") :
+    return name
+  return "file:" + os.path.abspath(name)
+
+def main() :
+  parser = argparse.ArgumentParser(description="Run a cfg (or l1egStandalone) over uniform event ranges on a local worker pool")
+  parser.add_argument("inputs", nargs="+", help="cfg file followed by the input files (no cfg with --standalone or --command)")
+  parser.add_argument("-j", "--jobs", type=int, default=4, help="Concurrent jobs (default %(default)s)")
+  parser.add_argument("-n", "--events-per-shard", type=int, default=2000, help="Events per shard (default %(default)s)")
+  parser.add_argument("-w", "--workdir", default="localScheduler", help="Shard configs, logs and outputs (default %(default)s)")
+  parser.add_argument("-o", "--output", default=None, help="Merged output (default from the cfg name, see condor_combine.sh)")
+  parser.add_argument("--tree", default=None, help="Tree whose entries are counted (default Events, analyzer/event_summary with --standalone)")
+  parser.add_argument("--index", default=None, help="Event count cache (default <workdir>/index.json)")
+  parser.add_argument("--retries", type=int, default=1, help="Reruns of a failed shard (default %(default)s)")
+  parser.add_argument("--checkpoint", action="store_true", help="Let a rerun of a failed shard resume from the analyzer checkpoint")
+  parser.add_argument("--standalone", action="store_true", help="Run l1egStandalone on event_summary files instead of cmsRun")
+  parser.add_argument("--standalone-exe", default="l1egStandalone")
+  parser.add_argument("--standalone-args", default="", help="Extra l1egStandalone options, e.g. '--efficiency'")
+  parser.add_argument("--threads", type=int, default=1, help="Threads per l1egStandalone job (default %(default)s)")
+  parser.add_argument("--command", default=None, help="Shell command per shard instead of cmsRun, see above")
+  parser.add_argument("--stage-cache", default=None, help="Stage the inputs through this stagingCache.py directory")
+  stagingCache.addArguments(parser, "stage-")
+  parser.add_argument("--no-merge", action="store_true", help="Leave the shard outputs unmerged")
+  parser.add_argument("--dry-run", action="store_true", help="Print the shards and commands only")
+  args = parser.parse_args()
+
+  args.config = None
+  files = args.inputs
+  if not args.standalone and not args.command :
+    args.config, files = os.path.abspath(args.inputs[0]), args.inputs[1:]
+    if not files :
+      parser.error("no input files")
+  # Jobs run in their shard directories, so every path they get is absolute
+  files = [name if name.startswith("/store/") or "://" in name else os.path.abspath(name) for name in files]
+  args.workdir = os.path.abspath(args.workdir)
+  if os.sep in args.standalone_exe :
+    args.standalone_exe = os.path.abspath(args.standalone_exe)
+  args.standalone_args = shlex.split(args.standalone_args)
+  if args.tree is None :
+    args.tree = "analyzer/event_summary" if args.standalone else "Events"
+  if args.output is None :
+    args.output = mergedNames.get(os.path.basename(args.config or ""), "localScheduler.root")
+  if not os.path.isdir(args.workdir) :
+    os.makedirs(args.workdir)
+
+  counts = indexEvents(files, args.tree, args.index or os.path.join(args.workdir, "index.json"))
+  shards = makeShards(files, counts, max(args.events_per_shard, 1))
+  if len(shards) == 0 :
+    print("Nothing to run")
+    return 1
+  args.jobs = max(1, min(args.jobs, len(shards)))
+  cache = stagingCache.fromArguments(args.stage_cache, args, "stage-") if args.stage_cache and not args.dry_run else None
+  scheduler = Scheduler(args, shards, cache)
+  if args.dry_run :
+    for shard in shards :
+      print("%4d: %s" % (shard.number, scheduler.command(shard)))
+    return 0
+
+  print("Running %d shards of up to %d events on %d workers" % (len(shards), args.events_per_shard, args.jobs))
+  start = time.time()
+  scheduler.run()
+  wall = time.time()-start
+  busy = sum(scheduler.durations)
+  print("Done in %.1fs, %.0f%% of the worker time busy, %d shards stolen, %d reruns" % (wall, 100.*busy/max(wall*args.jobs, 1e-9),
+        scheduler.queues.steals, sum(scheduler.attempts.values())-len(scheduler.attempts)))
+  if cache is not None :
+    print(cache.summary())
+  if scheduler.failed :
+    print("Failed shards: %s, not merging" % " ".join(str(s.number) for s in sorted(scheduler.failed)))
+    return 1
+  if args.no_merge :
+    return 0
+
+  missing = [s for s in shards if s.number not in scheduler.outputs]
+  if missing :
+    print("Shards without output: %s, not merging" % " ".join(str(s.number) for s in missing))
+    return 1
+  outputs = [scheduler.outputs[number] for number in sorted(scheduler.outputs)]
+  status = subprocess.call(["hadd", "-f", args.output] + outputs)
+  if status == 0 :
+    print("Merged into %s, next: root -q -b normalizeParallelJobs.C+" % args.output)
+  return status
+
+if __name__ == "__main__" :
+  sys.exit(main())
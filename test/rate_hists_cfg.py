@@ -89,9 +89,12 @@ process.pTracking = cms.Path( process.ElectronTrackingSequence )
 
 # ----------------------------------------------------------------------------------------------
 # 
-# Analyzer starts here
+# Per-event context shared by the analyzers (sorted clusters, EG candidates, calo hits, truth)
+# In memory only: an output module added to this process needs
+# 'drop *_L1EGEventContext_*_*' in its outputCommands
 
-process.analyzer = cms.EDAnalyzer('L1EGRateStudies',
+process.L1EGEventContext = cms.EDProducer("L1EGEventContextProducer",
+   L1CrystalClustersInputTag = cms.InputTag("L1EGammaCrystalsProducer","EGCrystalCluster"),
    L1EGammaInputTags = cms.VInputTag(
       # Old stage-2 trigger
       cms.InputTag("SLHCL1ExtraParticles","EGamma"),
@@ -106,16 +109,46 @@ process.analyzer = cms.EDAnalyzer('L1EGRateStudies',
       # Crystal-level algo.
       cms.InputTag("L1EGammaCrystalsProducer","EGammaCrystal")
    ),
+   makeCaloHits = cms.untracked.bool(False),
+   useEndcap = cms.untracked.bool(False),
+   doTruth = cms.untracked.bool(False),
+   # Integer emulation of the crystal EG cuts, compared to the float ones in the analyzer
+   fixedPointEmulation = cms.untracked.bool(True)
+)
+
+
+# ----------------------------------------------------------------------------------------------
+# 
+# Analyzer starts here
+
+process.analyzer = cms.EDAnalyzer('L1EGRateStudies',
+   L1EGammaInputTags = process.L1EGEventContext.L1EGammaInputTags,
    L1CrystalClustersInputTag = cms.InputTag("L1EGammaCrystalsProducer","EGCrystalCluster"),
+   L1EGContextInputTag = cms.InputTag("L1EGEventContext"),
    L1TrackInputTag = cms.InputTag("TTTracksFromPixelDigisLargerPhi","Level1TTTracks"),
    doEfficiencyCalc = cms.untracked.bool(False),
+   # Snapshots to resume preempted jobs are off by default (checkpointFile empty),
+   # condor_submit.sh -c and localScheduler.py --checkpoint turn them on per job
+   checkpointInterval = cms.untracked.uint32(1000),
+   # Leading 4 candidates of every algorithm per event, for test/summaryRates.py
+   summaryTopN = cms.untracked.uint32(4),
+   # Fill (and compress) crystal_tree on a separate thread; only safe when nothing else
+   # writes to the TFileService file during the event loop, see AsyncTreeWriter.h,
+   # so it is a configuration error together with summaryTopN > 0
+   asyncTreeWriter = cms.untracked.bool(False),
+   # Reduced-precision crystal_tree columns (PackedColumns.h), opt-in: rounding to 8-12
+   # mantissa bits costs up to 0.1 per mille relative on the cluster and gen pt, 0.5 on
+   # crystal pt, H/E, iso and the track dR, 2 on the strip sums and chi2; eta is quantised
+   # to 12 bits over [-3, 3] and the counts saturate at their int:8/int:16 limits.
+   # crystalTreePrecision = ["gen_pt=full"] overrides single columns
+   packCrystalTree = cms.untracked.bool(False),
    useEndcap = cms.untracked.bool(False),
    histogramBinCount = cms.untracked.int32(40),
    histogramRangeLow = cms.untracked.double(0),
    histogramRangeHigh = cms.untracked.double(50)
 )
 
-process.panalyzer = cms.Path(process.analyzer)
+process.panalyzer = cms.Path(process.L1EGEventContext+process.analyzer)
 
 process.TFileService = cms.Service("TFileService", 
    fileName = cms.string("$outputFileName"), 
@@ -0,0 +1,115 @@
+#!/usr/bin/env python
+# Quantiles and automatically ranged histograms from the quantile sketches
+# written by L1EGRateStudies and L1EGCrystalsHeatMap (quantileSketchSize > 0)
+#
+#   python sketchHistograms.py [-d analyzer] [-o out.root] [--tail 0.001] [--bins 50] egTriggerEff.root [more.root ...]
+#
+# Each histogram that has a sketch (see interface/QuantileSketch.h) gets a
+# copy here whose range covers all but a fraction --tail of the entries on
+# each side, so a sample whose distributions fall outside the configured
+# histogram ranges does not have to be reprocessed.  Files can be the hadd
+# output of parallel jobs or the individual job outputs, the sketches merge
+# either way.  The histograms are built from the sketch's weighted values,
+# so their shape has the sketch's resolution (about 1% in rank).  Rate
+# histograms are sketched with the leading candidate pt, before integration.
+import argparse
+import numpy
+import ROOT
+
+class Stream :
+  def __init__(self, name, title) :
+    self.name = name
+    self.title = title
+    self.count = 0
+    self.min = float("inf")
+    self.max = float("-inf")
+    self.values = numpy.zeros(0)
+    self.weights = numpy.zeros(0)
+
+  def quantile(self, q) :
+    '''Approximate q-quantile from the weighted values, exact min and max at the ends'''
+    if self.count == 0 or len(self.values) == 0 :
+      return float("nan")
+    if q <= 0. :
+      return self.min
+    if q >= 1. :
+      return self.max
+    order = numpy.argsort(self.values, kind="mergesort")
+    cumulative = numpy.cumsum(self.weights[order])
+    i = numpy.searchsorted(cumulative, q*cumulative[-1])
+    return self.values[order][min(i, len(order)-1)]
+
+  def histogram(self, tail, nBins) :
+    lo, hi = self.quantile(tail), self.quantile(1.-tail)
+    if hi <= lo :
+      lo, hi = lo-0.5, hi+0.5
+    pad = 0.05*(hi-lo)
+    hist = ROOT.TH1F(self.name, ";"+self.title+";Counts", nBins, lo-pad, hi+pad)
+    for value, weight in zip(self.values, self.weights) :
+      hist.Fill(value, weight)
+    return hist
+
+def draw(tree, columns) :
+  '''Columns of all entries, via TTree::Draw'''
+  tree.SetEstimate(tree.GetEntries()+1)
+  n = tree.Draw(":".join(columns), "", "goff")
+  out = []
+  for getter in [tree.GetV1, tree.GetV2, tree.GetV3, tree.GetV4][:len(columns)] :
+    if n <= 0 :
+      out.append(numpy.zeros(0))
+      continue
+    buf = getter()
+    buf.SetSize(n)
+    out.append(numpy.array(buf, copy=True))
+  return out
+
+def load(files, directory) :
+  '''Streams by name, merged over every job; stream numbers are per job configuration'''
+  streams = {}
+  for fileName in files :
+    f = ROOT.TFile.Open(fileName)
+    streamTree = f.Get(directory+"/quantileSketch_streams")
+    itemTree = f.Get(directory+"/quantileSketch_items")
+    if not streamTree or not itemTree :
+      print("%s: no quantile sketches in %s" % (fileName, directory))
+      continue
+    # One row per stream and job (hadd concatenates them)
+    numberToName = {}
+    for row in streamTree :
+      name = str(row.name)
+      if name not in streams :
+        streams[name] = Stream(name, str(row.title))
+      s = streams[name]
+      s.count += row.count
+      if row.count > 0 :
+        s.min = min(s.min, row.min)
+        s.max = max(s.max, row.max)
+      numberToName[row.stream] = name
+    number, values, weights = draw(itemTree, ["stream", "value", "weight"])
+    number = number.astype(numpy.int64)
+    for n, name in numberToName.items() :
+      sel = number == n
+      s = streams[name]
+      s.values = numpy.r_[s.values, values[sel]]
+      s.weights = numpy.r_[s.weights, weights[sel]]
+    f.Close()
+  return streams
+
+if __name__ == "__main__" :
+  parser = argparse.ArgumentParser(description="Quantiles and auto-ranged histograms from L1EG quantile sketches")
+  parser.add_argument("files", nargs="+")
+  parser.add_argument("-d", "--directory", default="analyzer", help="Analyzer module label (TFileService directory)")
+  parser.add_argument("-o", "--output", default="sketchHistograms.root")
+  parser.add_argument("--tail", type=float, default=0.001, help="Fraction of entries left out on each side of the range")
+  parser.add_argument("--bins", type=int, default=50)
+  args = parser.parse_args()
+
+  streams = load(args.files, args.directory)
+  out = ROOT.TFile(args.output, "recreate")
+  print("%-50s %10s %10s %10s %10s %10s %10s" % ("stream", "count", "min", "q01", "median", "q99", "max"))
+  for name in sorted(streams) :
+    s = streams[name]
+    print("%-50s %10d %10.4g %10.4g %10.4g %10.4g %10.4g" % (name, s.count, s.min, s.quantile(0.01), s.quantile(0.5), s.quantile(0.99), s.max))
+    if s.count > 0 :
+      s.histogram(args.tail, args.bins).Write()
+  out.Close()
@@ -0,0 +1,363 @@
+#!/usr/bin/env python
+# Local staging cache for /store inputs, with read-ahead
+#
+#   python stagingCache.py -c /scratch/$USER/l1egCache --max-size 200 stage /store/mc/TTI2023Upg14D/.../*.root
+#   python stagingCache.py -c /scratch/$USER/l1egCache stats
+#   python localScheduler.py --stage-cache /scratch/$USER/l1egCache ... (stages and prefetches per shard)
+#
+# Staged files are stored under their adler32 checksum and size
+# (objects/ab/abcdef01-123456.root) and index.json maps each source name,
+# with its size and mtime, to the object, so a resubmission or the next cut
+# iteration reads the local copy.  The checksum is computed while copying
+# and again on the staged copy before it is used; a hit is checked against
+# the recorded size (and the full checksum with --verify).  When the cache
+# exceeds --max-size GB the least recently used objects are removed; files
+# in use are kept and trimmed once released.  A file larger than the whole
+# cache is not staged and read from the source instead.
+#
+# A /store name is read from <source-prefix>/store/... when that exists
+# (/hdfs at Wisconsin, or any local directory standing in for remote
+# storage when testing) and with xrdcp from --redirector otherwise.
+#
+# One process uses a cache directory at a time (the index is rewritten,
+# not locked); threads within it share one StagingCache.
+from __future__ import print_function
+import os
+import sys
+import json
+import time
+import zlib
+import shutil
+import argparse
+import tempfile
+import threading
+import subprocess
+import collections
+
+blockSize = 4*1024*1024
+
+def adler32(name) :
+  value = 1
+  with open(name, "rb") as f :
+    while True :
+      block = f.read(blockSize)
+      if not block :
+        break
+      value = zlib.adler32(block, value)
+  return "%08x" % (value & 0xffffffff)
+
+class StagingCache :
+  def __init__(self, directory, maxBytes, sourcePrefix="/hdfs", redirector="root://cmsxrootd.fnal.gov/", verify=False, prefetchStreams=2) :
+    self.directory = directory
+    self.maxBytes = maxBytes
+    self.sourcePrefix = sourcePrefix
+    self.redirector = redirector
+    self.verify = verify
+    self.lock = threading.Condition()
+    # source name -> {object, checksum, size, mtime, lastUsed}
+    self.entries = {}
+    self.objects = collections.Counter()   # object -> number of sources pointing at it
+    self.pinned = collections.Counter()    # object -> users
+    self.held = collections.defaultdict(list)  # source name -> objects pinned by acquire()
+    self.inFlight = set()
+    self.stats = collections.Counter()
+    for sub in ["objects", "tmp"] :
+      if not os.path.isdir(os.path.join(directory, sub)) :
+        os.makedirs(os.path.join(directory, sub))
+    indexName = os.path.join(directory, "index.json")
+    if os.path.exists(indexName) :
+      with open(indexName) as f :
+        self.entries = json.load(f)
+      for source, entry in list(self.entries.items()) :
+        if os.path.exists(self.objectPath(entry["object"])) :
+          self.objects[entry["object"]] += 1
+        else :
+          del self.entries[source]
+    self.prefetchQueue = collections.deque()
+    for i in range(prefetchStreams) :
+      t = threading.Thread(target=self.prefetchLoop)
+      t.daemon = True
+      t.start()
+
+  def objectPath(self, obj) :
+    return os.path.join(self.directory, "objects", obj[:2], obj + ".root")
+
+  def sourcePath(self, name) :
+    '''Readable local path of a source, or None if it has to come through xrootd'''
+    if name.startswith("/store/") :
+      mapped = self.sourcePrefix.rstrip("/") + name
+      return mapped if os.path.exists(mapped) else None
+    return name if os.path.exists(name) else None
+
+  def sourceStat(self, name) :
+    path = self.sourcePath(name)
+    if path is None :
+      return None
+    stat = os.stat(path)
+    return (stat.st_size, int(stat.st_mtime))
+
+  def usedBytes(self) :
+    return sum(self.entries[s]["size"] for s in self.uniqueSources())
+
+  def uniqueSources(self) :
+    seen = {}
+    for source, entry in self.entries.items() :
+      seen.setdefault(entry["object"], source)
+    return seen.values()
+
+  def acquire(self, name) :
+    '''Local path of name, staged if needed; pinned until release(name)'''
+    start = time.time()
+    with self.lock :
+      waited = False
+      while name in self.inFlight :
+        waited = True
+        self.lock.wait()
+      if waited :
+        self.stats["prefetchWaits"] += 1
+      if name in self.prefetchQueue :
+        self.prefetchQueue.remove(name)
+      entry = self.lookup(name)
+      if entry is not None :
+        self.stats["hits"] += 1
+        self.touch(name, entry, pin=True)
+        self.stats["waitSeconds"] += time.time()-start
+        return self.objectPath(entry["object"])
+      self.stats["misses"] += 1
+      self.inFlight.add(name)
+    try :
+      entry = self.fetch(name)
+    finally :
+      with self.lock :
+        self.inFlight.discard(name)
+        self.lock.notify_all()
+    with self.lock :
+      self.stats["waitSeconds"] += time.time()-start
+      if entry is None :
+        self.stats["bypassed"] += 1
+        return name
+      self.touch(name, entry, pin=True)
+      return self.objectPath(entry["object"])
+
+  def release(self, name) :
+    with self.lock :
+      if not self.held[name] :
+        return
+      obj = self.held[name].pop()
+      self.pinned[obj] -= 1
+      # Forgotten while in use
+      if self.pinned[obj] == 0 and self.objects[obj] <= 0 :
+        self.removeObject(obj)
+      # Files in use can hold the cache over its size for a while
+      self.makeRoom(0)
+
+  def prefetch(self, names) :
+    '''Stage names in the background, in order, if they are not there yet'''
+    with self.lock :
+      for name in names :
+        if name not in self.prefetchQueue and name not in self.inFlight and name not in self.entries :
+          self.prefetchQueue.append(name)
+      self.lock.notify_all()
+
+  def prefetchLoop(self) :
+    while True :
+      with self.lock :
+        while not self.prefetchQueue :
+          self.lock.wait()
+        name = self.prefetchQueue.popleft()
+        if name in self.inFlight or self.lookup(name) is not None :
+          continue
+        self.inFlight.add(name)
+      try :
+        entry = self.fetch(name)
+        with self.lock :
+          self.stats["prefetched" if entry is not None else "bypassed"] += 1
+      except Exception as e :
+        print("stagingCache: prefetch of %s failed: %s" % (name, e))
+      finally :
+        with self.lock :
+          self.inFlight.discard(name)
+          self.lock.notify_all()
+
+  def lookup(self, name) :
+    '''Valid entry for name or None, called with the lock held'''
+    entry = self.entries.get(name)
+    if entry is None :
+      return None
+    current = self.sourceStat(name)
+    path = self.objectPath(entry["object"])
+    stale = current is not None and current != (entry["size"], entry["mtime"])
+    if stale or not os.path.exists(path) or os.path.getsize(path) != entry["size"] or (self.verify and not self.checksumMatches(name, entry)) :
+      self.stats["invalidated"] += 1
+      if self.entries.get(name) is entry :
+        self.forget(name)
+      return None
+    return entry
+
+  def checksumMatches(self, name, entry) :
+    '''Full checksum of the staged copy, computed like a copy outside the lock
+    (dropped and taken again); the name is in flight meanwhile so other users
+    wait for the result, and the object is pinned so it is not evicted'''
+    obj = entry["object"]
+    self.inFlight.add(name)
+    self.pinned[obj] += 1
+    self.lock.release()
+    try :
+      checksum = adler32(self.objectPath(obj))
+    finally :
+      self.lock.acquire()
+      self.pinned[obj] -= 1
+      if self.pinned[obj] == 0 and self.objects[obj] <= 0 :
+        self.removeObject(obj)
+      self.inFlight.discard(name)
+      self.lock.notify_all()
+    return checksum == entry["checksum"]
+
+  def touch(self, name, entry, pin) :
+    entry["lastUsed"] = time.time()
+    if pin :
+      self.pinned[entry["object"]] += 1
+      self.held[name].append(entry["object"])
+
+  def forget(self, name) :
+    entry = self.entries.pop(name)
+    self.objects[entry["object"]] -= 1
+    if self.objects[entry["object"]] <= 0 and self.pinned[entry["object"]] == 0 :
+      self.removeObject(entry["object"])
+    self.save()
+
+  def removeObject(self, obj) :
+    del self.objects[obj]
+    path = self.objectPath(obj)
+    if os.path.exists(path) :
+      os.remove(path)
+
+  def fetch(self, name) :
+    '''Copy name into the cache (outside the lock), None if it does not fit'''
+    stat = self.sourceStat(name)
+    if stat is not None and stat[0] > self.maxBytes :
+      return None
+    handle, tmp = tempfile.mkstemp(suffix=".root", dir=os.path.join(self.directory, "tmp"))
+    os.close(handle)
+    try :
+      start = time.time()
+      path = self.sourcePath(name)
+      if path is not None :
+        checksum = self.copy(path, tmp)
+      else :
+        if subprocess.call(["xrdcp", "-f", "-s", self.redirector + name, tmp]) != 0 :
+          raise IOError("xrdcp of %s failed" % name)
+        checksum = adler32(tmp)
+        stat = (os.path.getsize(tmp), 0)
+      # Re-read what landed on disk before anyone uses it
+      if adler32(tmp) != checksum :
+        self.stats["checksumFailures"] += 1
+        raise IOError("checksum mismatch staging %s" % name)
+      size = os.path.getsize(tmp)
+      if size > self.maxBytes :
+        return None
+      with self.lock :
+        self.stats["bytesFetched"] += size
+        self.stats["fetchSeconds"] += time.time()-start
+        if name in self.entries :
+          self.forget(name)
+        self.makeRoom(size)
+        obj = "%s-%d" % (checksum, size)
+        target = self.objectPath(obj)
+        if not os.path.isdir(os.path.dirname(target)) :
+          os.makedirs(os.path.dirname(target))
+        if os.path.exists(target) :
+          self.stats["deduplicated"] += 1
+        else :
+          shutil.move(tmp, target)
+        entry = {"object" : obj, "checksum" : checksum, "size" : size, "mtime" : stat[1], "lastUsed" : time.time()}
+        self.entries[name] = entry
+        self.objects[obj] += 1
+        self.save()
+        return entry
+    finally :
+      if os.path.exists(tmp) :
+        os.remove(tmp)
+
+  def copy(self, source, target) :
+    value = 1
+    with open(source, "rb") as fin :
+      with open(target, "wb") as fout :
+        while True :
+          block = fin.read(blockSize)
+          if not block :
+            break
+          value = zlib.adler32(block, value)
+          fout.write(block)
+    return "%08x" % (value & 0xffffffff)
+
+  def makeRoom(self, size) :
+    '''Evict least recently used unpinned objects, called with the lock held'''
+    used = self.usedBytes()
+    byAge = sorted(self.entries.items(), key=lambda item : item[1]["lastUsed"])
+    for source, entry in byAge :
+      if used+size <= self.maxBytes :
+        break
+      if self.pinned[entry["object"]] > 0 or source not in self.entries :
+        continue
+      sharing = [s for s, e in self.entries.items() if e["object"] == entry["object"]]
+      for s in sharing :
+        self.forget(s)
+      used -= entry["size"]
+      self.stats["evictions"] += 1
+      self.stats["bytesEvicted"] += entry["size"]
+
+  def save(self) :
+    name = os.path.join(self.directory, "index.json")
+    with open(name + ".tmp", "w") as f :
+      json.dump(self.entries, f, indent=1, sort_keys=True)
+    os.rename(name + ".tmp", name)
+
+  def summary(self) :
+    s = self.stats
+    requests = s["hits"] + s["misses"]
+    lines = ["Staging cache %s: %d files, %.2f of %.2f GB" % (self.directory, len(self.objects), self.usedBytes()/1e9, self.maxBytes/1e9)]
+    if requests > 0 :
+      lines.append("  %d requests, %d hits (%.0f%%), %d misses, %d prefetched, %d waited on a prefetch, %d bypassed" % (
+                   requests, s["hits"], 100.*s["hits"]/requests, s["misses"], s["prefetched"], s["prefetchWaits"], s["bypassed"]))
+      lines.append("  %.2f GB fetched in %.1fs, %.1fs waited by jobs, %d evictions (%.2f GB), %d invalidated, %d checksum failures" % (
+                   s["bytesFetched"]/1e9, s["fetchSeconds"], s["waitSeconds"], s["evictions"], s["bytesEvicted"]/1e9,
+                   s["invalidated"], s["checksumFailures"]))
+    return "\n".join(lines)
+
+def addArguments(parser, prefix="") :
+  '''Cache options, shared with localScheduler.py'''
+  parser.add_argument("--%smax-size" % prefix, type=float, default=100., help="Cache size in GB (default %(default)s)")
+  parser.add_argument("--%ssource-prefix" % prefix, default="/hdfs", help="Local mount of /store (default %(default)s)")
+  parser.add_argument("--%sredirector" % prefix, default="root://cmsxrootd.fnal.gov/", help="xrootd redirector when the mount has no copy")
+  parser.add_argument("--%sverify" % prefix, action="store_true", help="Checksum cached files on every hit")
+  parser.add_argument("--%sprefetch-streams" % prefix, type=int, default=2, help="Concurrent prefetches (default %(default)s)")
+
+def fromArguments(directory, args, prefix="") :
+  get = lambda name : getattr(args, prefix.replace("-", "_") + name)
+  return StagingCache(directory, int(get("max_size")*1e9), get("source_prefix"), get("redirector"), get("verify"), get("prefetch_streams"))
+
+def main() :
+  parser = argparse.ArgumentParser(description="Local staging cache for /store inputs")
+  parser.add_argument("-c", "--cache", required=True, help="Cache directory")
+  addArguments(parser)
+  parser.add_argument("command", choices=["stage", "stats", "clean"])
+  parser.add_argument("files", nargs="*")
+  args = parser.parse_args()
+
+  cache = fromArguments(args.cache, args)
+  if args.command == "stage" :
+    # Each file is used right away, the next ones are fetched meanwhile
+    for i, name in enumerate(args.files) :
+      cache.prefetch(args.files[i+1:i+3])
+      print(cache.acquire(name))
+      cache.release(name)
+  elif args.command == "clean" :
+    with cache.lock :
+      for name in list(cache.entries) :
+        cache.forget(name)
+  print(cache.summary())
+  return 0
+
+if __name__ == "__main__" :
+  sys.exit(main())
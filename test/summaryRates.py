@@ -0,0 +1,138 @@
+#!/usr/bin/env python
+# Rate curves from the event_summary tree written by L1EGRateStudies (summaryTopN > 0)
+#
+#   python summaryRates.py [-o out.root] [--all-eta] egTriggerRates.root [more.root ...]
+#
+# The candidates are read once into numpy arrays, after that a rate curve for
+# any rule (barrel only or not, a pass-cut bit, a cut on the stored cluster
+# features, one or two objects) is a few array operations, so new rate
+# questions do not need the chain to be rerun.  Rates are normalised like
+# normalizeParallelJobs.C: 30MHz of filled bunch crossings, in kHz.
+#
+# The summary keeps the summaryTopN leading candidates of every acceptance and
+# working point selection (interface/EventSummary.h), so the barrel or all-eta
+# rates with or without a pass-cut bit are exact for the leading summaryTopN
+# candidates.  A cut on the stored features only sees what those selections kept.
+import time
+import argparse
+import numpy
+import ROOT
+
+crossingRate = 30000. # kHz
+barrelEta = 1.479
+
+# bit numbers of l1eg::ClusterFeatures::WorkingPoint
+kRateStudies = 0
+kHeatMap = 1
+
+class Candidates :
+  '''Every stored candidate of one algorithm, pt-ordered within each event'''
+  def __init__(self, tree, prefix, nEvents) :
+    self.prefix = prefix
+    self.nEvents = nEvents
+    # Draw buffers have to hold every array element of every entry
+    tree.SetEstimate(int(nEvents*max(tree.GetMaximum(prefix+"_n"), 1))+1)
+    columns = ["Entry$", prefix+"_pt", prefix+"_eta", prefix+"_phi"]
+    self.event, self.pt, self.eta, self.phi = draw(tree, columns)
+    if prefix == "crystal" :
+      self.passBits = draw(tree, ["crystal_passBits"])[0].astype(numpy.uint32)
+      self.hovere, self.iso, self.bremStrength, self.ptRatio = draw(tree, ["crystal_hovere", "crystal_iso", "crystal_bremStrength", "crystal_ptRatio"])
+    self.event = self.event.astype(numpy.int64)
+
+  def passes(self, bit) :
+    return (self.passBits & (1 << bit)) != 0
+
+  def barrel(self) :
+    return numpy.abs(self.eta) < barrelEta
+
+  def nthPt(self, mask, n) :
+    '''pt of the n-th (0 = leading) candidate passing mask in each event, 0 if there is none'''
+    idx = numpy.flatnonzero(mask)
+    out = numpy.zeros(self.nEvents)
+    if len(idx) == 0 :
+      return out
+    ev = self.event[idx]
+    first = numpy.r_[True, ev[1:] != ev[:-1]]
+    position = numpy.arange(len(idx))
+    rank = position - numpy.maximum.accumulate(numpy.where(first, position, 0))
+    sel = rank == n
+    out[ev[sel]] = self.pt[idx[sel]]
+    return out
+
+def draw(tree, columns) :
+  '''Columns of all array elements of all entries, via TTree::Draw (at most 4 per call)'''
+  out = []
+  for i in range(0, len(columns), 4) :
+    chunk = columns[i:i+4]
+    n = tree.Draw(":".join(chunk), "", "goff")
+    for getter in [tree.GetV1, tree.GetV2, tree.GetV3, tree.GetV4][:len(chunk)] :
+      buf = getter()
+      if n <= 0 :
+        out.append(numpy.zeros(0))
+        continue
+      buf.SetSize(n)
+      out.append(numpy.array(buf, copy=True))
+  return out
+
+def load(files, treeName="analyzer/event_summary") :
+  chain = ROOT.TChain(treeName)
+  for f in files :
+    chain.Add(f)
+  nEvents = chain.GetEntries()
+  # truth_* holds the generated particles, not trigger candidates
+  prefixes = [b.GetName()[:-2] for b in chain.GetListOfBranches() if b.GetName().endswith("_n") and b.GetName() != "truth_n"]
+  return nEvents, dict((p, Candidates(chain, p, nEvents)) for p in prefixes)
+
+def rateCurve(name, leadingPt, nEvents, nBins=40, lo=0., hi=50.) :
+  '''Rate above each threshold, i.e. the histogram of leadingPt integrated downward (see L1EGRateStudies::integrateDown)'''
+  hist = ROOT.TH1F(name, name+";ET Threshold (GeV);Rate (kHz)", nBins, lo, hi)
+  counts = numpy.histogram(leadingPt[leadingPt > 0], bins=nBins, range=(lo, hi))[0]
+  overflow = numpy.count_nonzero(leadingPt >= hi)
+  cumulative = numpy.cumsum(numpy.r_[counts, overflow][::-1])[::-1]
+  for i, c in enumerate(cumulative) :
+    hist.SetBinContent(i+1, c*crossingRate/max(nEvents, 1))
+  return hist
+
+def rateGrid(name, leadingPt, subleadingPt, nEvents, nBins=25, lo=0., hi=50.) :
+  '''Rate with leading above x and subleading above y, for asymmetric double-object thresholds'''
+  hist = ROOT.TH2F(name, name+";Leading ET Threshold (GeV);Subleading ET Threshold (GeV);Rate (kHz)", nBins, lo, hi, nBins, lo, hi)
+  sel = subleadingPt > 0
+  # Values above the range go in the last bin, so they count for every threshold
+  lead = numpy.minimum(leadingPt[sel], hi-1e-3)
+  sub = numpy.minimum(subleadingPt[sel], hi-1e-3)
+  counts = numpy.histogram2d(lead, sub, bins=nBins, range=((lo, hi), (lo, hi)))[0]
+  cumulative = counts[::-1, ::-1].cumsum(axis=0).cumsum(axis=1)[::-1, ::-1]
+  for i in range(nBins) :
+    for j in range(nBins) :
+      hist.SetBinContent(i+1, j+1, cumulative[i, j]*crossingRate/max(nEvents, 1))
+  return hist
+
+def defaultMask(candidates, allEta) :
+  mask = numpy.ones(len(candidates.pt), dtype=bool)
+  if not allEta :
+    mask &= candidates.barrel()
+  if candidates.prefix == "crystal" :
+    mask &= candidates.passes(kRateStudies)
+  return mask
+
+if __name__ == "__main__" :
+  parser = argparse.ArgumentParser(description="Single and double EG rate curves from the L1EGRateStudies event summary")
+  parser.add_argument("files", nargs="+")
+  parser.add_argument("-o", "--output", default="summaryRates.root")
+  parser.add_argument("--all-eta", action="store_true", help="Do not restrict candidates to the barrel")
+  args = parser.parse_args()
+
+  start = time.time()
+  nEvents, algorithms = load(args.files)
+  loaded = time.time()
+
+  out = ROOT.TFile(args.output, "recreate")
+  for prefix, candidates in sorted(algorithms.items()) :
+    mask = defaultMask(candidates, args.all_eta)
+    leading = candidates.nthPt(mask, 0)
+    subleading = candidates.nthPt(mask, 1)
+    rateCurve(prefix+"_rate", leading, nEvents).Write()
+    rateCurve(prefix+"_doubleRate", subleading, nEvents).Write()
+    rateGrid(prefix+"_doubleRateGrid", leading, subleading, nEvents).Write()
+  out.Close()
+  print("%d events: loaded in %.2fs, %d algorithms' rates in %.3fs" % (nEvents, loaded-start, len(algorithms), time.time()-loaded))
@@ -0,0 +1,129 @@
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+// The geometry-free barrel numbering of EBTriggerTowerMap.h against
+// EBDetId and EcalTrigTowerDetId, for every barrel crystal: hash, ieta,
+// iphi, trigger tower, and the signed eta and phi distances (including
+// the phi wrap-around) against EBDetId::distanceEta() / distancePhi().
+// Then the barrel lookups and windows of CrystalHitStore against a direct
+// scan, on a store that is still read after the builder made the next one.
+//
+//   testEBTriggerTowerMap       exit status 0 if every check passes
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "DataFormats/EcalDetId/interface/EBDetId.h"
+#include "DataFormats/EcalDetId/interface/EcalTrigTowerDetId.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/CrystalHitStore.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/EBTriggerTowerMap.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/test/TestChecks.h"
+
+namespace {
+
+// Called for every crystal, so the message is only built on failure
+void check(bool ok, const char * what, int hash)
+{
+   if ( !ok ) l1eg::test::check(false, std::string(what)+", hash "+std::to_string(hash));
+}
+
+} // namespace
+
+int main()
+{
+   using namespace l1eg;
+   check(eb::kCrystals == EBDetId::kSizeForDenseIndexing, "crystal count", -1);
+
+   std::map<int, uint32_t> towerIds;
+   for(int hash=0; hash<eb::kCrystals; ++hash)
+   {
+      const EBDetId id = EBDetId::unhashIndex(hash);
+      const EcalTrigTowerDetId tower = id.tower();
+      check(id.hashedIndex() == hash, "EBDetId::unhashIndex round trip", hash);
+      check(eb::hashedIndex(id.ieta(), id.iphi()) == hash, "hashedIndex(ieta, iphi)", hash);
+      check(eb::ietaFromHash(hash) == id.ieta() && eb::ieta(hash) == id.ieta(), "ieta", hash);
+      check(eb::iphiFromHash(hash) == id.iphi() && eb::iphi(hash) == id.iphi(), "iphi", hash);
+      check(eb::towerIEta(id.ieta()) == tower.ieta() && id.tower_ieta() == tower.ieta(), "tower ieta", hash);
+      check(eb::towerIPhi(id.iphi()) == tower.iphi() && id.tower_iphi() == tower.iphi(), "tower iphi", hash);
+      check(eb::tower(hash) == eb::towerIndex(tower.ieta(), tower.iphi()) && eb::towerIndexFromHash(hash) == eb::tower(hash), "tower index", hash);
+      check(eb::tower(hash) >= 0 && eb::tower(hash) < eb::kTowers, "tower index range", hash);
+      // One tower index per EcalTrigTowerDetId
+      auto inserted = towerIds.insert(std::make_pair(eb::tower(hash), tower.rawId()));
+      check(inserted.first->second == tower.rawId(), "tower index shared by two towers", hash);
+
+      CaloHit hit;
+      hit.index = crystal::index(id);
+      check(hit.index == hash && hit.isBarrel() && hit.tower() == eb::tower(hash), "CaloHit barrel index and tower", hash);
+   }
+   check(int(towerIds.size()) == eb::kTowers, "every tower index used", -1);
+
+   // Signed distances: a = b + delta, |delta| as EBDetId, phi wrapped into (-180, 180]
+   for(int ieta_a=-eb::kMaxIEta; ieta_a<=eb::kMaxIEta; ++ieta_a)
+   {
+      if ( ieta_a == 0 ) continue;
+      for(int ieta_b=-eb::kMaxIEta; ieta_b<=eb::kMaxIEta; ++ieta_b)
+      {
+         if ( ieta_b == 0 ) continue;
+         const EBDetId a(ieta_a, 1), b(ieta_b, 1);
+         const int delta = eb::deltaIEta(ieta_a, ieta_b);
+         check(std::abs(delta) == EBDetId::distanceEta(a, b) && (delta > 0) == (ieta_a > ieta_b), "deltaIEta", a.hashedIndex());
+      }
+   }
+   for(int iphi_a=1; iphi_a<=eb::kMaxIPhi; ++iphi_a)
+   {
+      for(int iphi_b=1; iphi_b<=eb::kMaxIPhi; ++iphi_b)
+      {
+         const EBDetId a(1, iphi_a), b(1, iphi_b);
+         const int delta = eb::deltaIPhi(iphi_a, iphi_b);
+         check(std::abs(delta) == EBDetId::distancePhi(a, b), "|deltaIPhi|", a.hashedIndex());
+         check(delta > -eb::kMaxIPhi/2 && delta <= eb::kMaxIPhi/2, "deltaIPhi range", a.hashedIndex());
+         check((iphi_b - 1 + delta + eb::kMaxIPhi) % eb::kMaxIPhi + 1 == iphi_a, "deltaIPhi wrap", a.hashedIndex());
+      }
+   }
+
+   // Nothing outside the barrel has a tower
+   CaloHit endcap;
+   endcap.index = eb::kCrystals;
+   check(endcap.tower() == -1, "endcap CaloHit tower", endcap.index);
+   CaloHit hcal;
+   check(hcal.tower() == -1, "non-ECAL CaloHit tower", hcal.index);
+
+   // Two events from one builder, the first store has to stay valid
+   CrystalHitStoreBuilder builder;
+   std::vector<int> firstHashes;
+   for(int hash=0; hash<eb::kCrystals; hash+=7) firstHashes.push_back(hash);
+   for(auto it=firstHashes.rbegin(); it!=firstHashes.rend(); ++it) builder.add(EBDetId::unhashIndex(*it), GlobalPoint(), 1.);
+   builder.add(EBDetId::unhashIndex(firstHashes[0]), GlobalPoint(), 2.);
+   const CrystalHitStore first = builder.build();
+   for(int hash=3; hash<eb::kCrystals; hash+=11) builder.add(EBDetId::unhashIndex(hash), GlobalPoint(), 3.);
+   const CrystalHitStore second = builder.build();
+   check(first.size() == firstHashes.size(), "first store size", -1);
+   check(first.at(firstHashes[0]) != nullptr && first.at(firstHashes[0])->energy == 1., "first hit of a crystal kept", firstHashes[0]);
+   check(second.at(firstHashes[0]) == nullptr && second.at(3) != nullptr, "second store hits", 3);
+   for(int hash=0; hash<eb::kCrystals; hash+=13)
+   {
+      check((first.at(hash) != nullptr) == (hash % 7 == 0), "first store lookup", hash);
+      check(first.find(EBDetId::unhashIndex(hash)) == first.at(hash), "first store find", hash);
+      CaloHit center;
+      center.index = hash;
+      const int range = 2;
+      int found = 0;
+      first.forEachInWindow(center, range, [&](const CaloHit& hit, int di, int dj) {
+         found++;
+         check(di == eb::deltaIEta(eb::ieta(hit.index), eb::ieta(hash)) && dj == eb::deltaIPhi(eb::iphi(hit.index), eb::iphi(hash)), "window offsets", hash);
+      });
+      int expected = 0;
+      for(int other : firstHashes)
+         expected += std::abs(eb::deltaIEta(eb::ieta(other), eb::ieta(hash))) <= range && std::abs(eb::deltaIPhi(eb::iphi(other), eb::iphi(hash))) <= range;
+      check(found == expected, "window hit count", hash);
+   }
+
+   std::printf("testEBTriggerTowerMap: %d failures\n", l1eg::test::failures());
+   return l1eg::test::exitStatus();
+}
@@ -0,0 +1,95 @@
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+// Fixed-point emulation of the crystal EG cuts (FixedPointCuts.h) against
+// the float cuts of ClusterFeatures, at low pt where the isolation and H/E
+// thresholds (40/pt+0.1, 64/pt+0.1 in the endcap) are large: a value
+// clearly below or above the float threshold gets the same decision from
+// both.  Pts are taken at LUT bin centres, where the tabulated threshold is
+// the float one, and values stay a few LSB away from the threshold.
+//
+//   testFixedPointCuts       exit status 0 if every check passes
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/ClusterFeatures.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/FixedPointCuts.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/test/TestChecks.h"
+
+using l1eg::test::check;
+
+namespace {
+
+l1eg::ClusterFeatures cluster(float pt, float eta, float hovere, float iso)
+{
+   l1eg::ClusterFeatures f;
+   f.pt = pt;
+   f.eta = eta;
+   f.hovere = hovere;
+   f.iso = iso;
+   f.crystalPt = {{0.6f*pt, 0.3f*pt, 0.05f*pt, 0.03f*pt, 0.f, 0.f}};
+   f.params.fill(0.);
+   f.params[l1eg::ClusterFeatures::kUncorrectedPt] = pt;
+   f.passBits = (uint32_t(l1eg::ClusterFeatures::passesRateStudiesCuts(f)) << l1eg::ClusterFeatures::kRateStudies)
+                | (uint32_t(l1eg::ClusterFeatures::passesHeatMapCuts(f)) << l1eg::ClusterFeatures::kHeatMap);
+   return f;
+}
+
+std::string describe(const l1eg::ClusterFeatures& f, uint32_t emulated)
+{
+   char text[256];
+   std::snprintf(text, sizeof(text), "pt %g eta %g H/E %g iso %g: float bits %u, emulated bits %u",
+                 f.pt, f.eta, f.hovere, f.iso, f.passBits, emulated);
+   return text;
+}
+
+} // namespace
+
+int main()
+{
+   const l1eg::FixedPointCuts::Config config;
+   const l1eg::FixedPointCuts cuts(config);
+   const double binWidth = config.lutPtLSB;
+   const double margin = 4*config.ratioLSB;
+
+   int compared = 0;
+   for(float eta : {0.5f, -2.f})
+   {
+      const bool endcap = eta < -1.479;
+      // Bin centres from 1.25 to 9.75 GeV
+      for(double pt=2.5*binWidth; pt<10.; pt+=binWidth)
+      {
+         const auto rate = l1eg::ClusterFeatures::rateStudiesThresholds(pt, endcap);
+         const auto heat = l1eg::ClusterFeatures::heatMapThresholds(pt);
+         for(double isoThreshold : {rate.iso, heat.iso})
+         {
+            // Above the old 12 bit range of 4, below and above the threshold, and far out of range
+            for(double iso : {4.5, isoThreshold-margin, isoThreshold+margin, 1000.})
+            {
+               const auto f = cluster(pt, eta, 0., iso);
+               const uint32_t emulated = cuts.passBits(f);
+               check(emulated == f.passBits, describe(f, emulated));
+               compared++;
+            }
+         }
+         for(double hovere : {rate.hovere-margin, rate.hovere+margin, heat.hovere-margin, heat.hovere+margin})
+         {
+            const auto f = cluster(pt, eta, hovere, 0.);
+            const uint32_t emulated = cuts.passBits(f);
+            check(emulated == f.passBits, describe(f, emulated));
+            compared++;
+         }
+      }
+   }
+   // A cluster below every threshold at 5 GeV passes both working points in both
+   const auto loose = cluster(4.75, 0.5, 0.5, 5.);
+   check(loose.passes(l1eg::ClusterFeatures::kRateStudies) && loose.passes(l1eg::ClusterFeatures::kHeatMap), "float cuts at 4.75 GeV, iso 5");
+   check(cuts.passBits(loose) == loose.passBits, "emulated cuts at 4.75 GeV, iso 5");
+
+   std::printf("testFixedPointCuts: %d clusters compared, %d failures\n", compared, l1eg::test::failures());
+   return l1eg::test::exitStatus();
+}
@@ -0,0 +1,108 @@
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+// HelixPropagator.h against BaseParticlePropagator::propagateToEcalEntrance()
+// on a fixed pseudo-random sample of (charge, pt, eta, phi, vertex): same
+// surface (barrel, endcap, failed) and, where both reach the ECAL, the same
+// exit point within tolerance.  The sample spans |eta| < 3.5, past the
+// acceptance and through the barrel corner, pt 1 to 1000 GeV and a
+// displaced vertex.  The charge is set with RawParticle::setCharge(), so no
+// ParticleTable is needed.
+//
+//   testHelixPropagator       exit status 0 if every check passes
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "DataFormats/Math/interface/LorentzVector.h"
+#include "FastSimulation/BaseParticlePropagator/interface/BaseParticlePropagator.h"
+#include "FastSimulation/Particle/interface/RawParticle.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/HelixPropagator.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/test/TestChecks.h"
+
+using l1eg::test::check;
+
+namespace {
+
+// cm, the closed form and the reference differ by rounding only
+const double tolerance = 0.01;
+
+struct Particle {
+   int charge;
+   double pt, eta, phi, x, y, z;
+};
+
+std::string describe(const Particle& p)
+{
+   char text[256];
+   std::snprintf(text, sizeof(text), "charge %d pt %g eta %g phi %g vertex (%g, %g, %g)", p.charge, p.pt, p.eta, p.phi, p.x, p.y, p.z);
+   return text;
+}
+
+} // namespace
+
+int main()
+{
+   const l1eg::HelixPropagator helix;
+   const double electronMass = 0.000511;
+
+   std::mt19937 engine(20150612);
+   std::uniform_int_distribution<int> charge(-1, 1);
+   std::uniform_real_distribution<double> logPt(std::log(1.), std::log(1000.));
+   std::uniform_real_distribution<double> eta(-3.5, 3.5);
+   std::uniform_real_distribution<double> phi(-M_PI, M_PI);
+   std::uniform_real_distribution<double> transverse(-0.5, 0.5);
+   std::uniform_real_distribution<double> longitudinal(-20., 20.);
+
+   std::vector<Particle> sample;
+   for(int i=0; i<20000; ++i)
+      sample.push_back(Particle{charge(engine), std::exp(logPt(engine)), eta(engine), phi(engine), transverse(engine), transverse(engine), longitudinal(engine)});
+   // From the origin, both ways along the beam, either side of the corner and of the acceptance
+   for(int q=-1; q<=1; ++q)
+      for(double e : {0., 1.47, -1.49, 2.9, -2.9, 3.1})
+         sample.push_back(Particle{q, 50., e, 0.3, 0., 0., 0.});
+
+   l1eg::HelixPropagator::Batch batch;
+   for(const auto& p : sample)
+   {
+      const double px = p.pt*std::cos(p.phi), py = p.pt*std::sin(p.phi), pz = p.pt*std::sinh(p.eta);
+      batch.push_back(p.x, p.y, p.z, px, py, pz, p.charge);
+   }
+   helix.propagate(batch);
+
+   int surfaces[3] = {0, 0, 0};
+   double maxDistance = 0.;
+   for(size_t i=0; i<sample.size(); ++i)
+   {
+      const Particle& p = sample[i];
+      const double px = batch.px[i], py = batch.py[i], pz = batch.pz[i];
+      RawParticle particle(math::XYZTLorentzVector(px, py, pz, std::sqrt(px*px + py*py + pz*pz + electronMass*electronMass)));
+      particle.setVertex(p.x, p.y, p.z, 0.);
+      particle.setCharge(p.charge);
+      BaseParticlePropagator reference(particle, 0., 0., helix.config().bField);
+      reference.propagateToEcalEntrance();
+
+      check(reference.getSuccess() == batch.surface[i], "surface "+std::to_string(batch.surface[i])+" instead of "+std::to_string(reference.getSuccess())+", "+describe(p));
+      if ( batch.surface[i] >= 0 && batch.surface[i] <= 2 ) surfaces[batch.surface[i]]++;
+      if ( reference.getSuccess() == 0 || batch.surface[i] == l1eg::HelixPropagator::kFailed ) continue;
+      const double distance = std::sqrt(std::pow(reference.vertex().x() - batch.exitX[i], 2)
+                                        + std::pow(reference.vertex().y() - batch.exitY[i], 2)
+                                        + std::pow(reference.vertex().z() - batch.exitZ[i], 2));
+      check(distance <= tolerance, "exit point "+std::to_string(distance)+" cm away, "+describe(p));
+      maxDistance = std::max(maxDistance, distance);
+   }
+   // The sample has to exercise every surface
+   check(surfaces[l1eg::HelixPropagator::kBarrel] > 0 && surfaces[l1eg::HelixPropagator::kEndcap] > 0 && surfaces[l1eg::HelixPropagator::kFailed] > 0,
+         "sample does not reach every surface");
+
+   std::printf("testHelixPropagator: %zu particles (%d barrel, %d endcap, %d failed), largest distance %g cm, %d failures\n",
+               sample.size(), surfaces[1], surfaces[2], surfaces[0], maxDistance, l1eg::test::failures());
+   return l1eg::test::exitStatus();
+}
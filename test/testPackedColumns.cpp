@@ -0,0 +1,206 @@
+// -*- C++ -*-
+//
+// Package:    L1EGRateStudies
+//
+// Round trip of the crystal_tree column precisions (PackedColumns.h):
+// truncateMantissa, encodeFixed/decodeFixed and saturate against their
+// definitions, then a memory-resident tree booked and filled through
+// PackedColumns, with and without packing, read back by column name with
+// TTreeFormula as the drawing macros do (branches, and the aliases of the
+// fixed and flag columns).
+//
+//   testPackedColumns       exit status 0 if every check passes
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "TTree.h"
+#include "TTreeFormula.h"
+
+#include "SLHCUpgradeSimulations/L1EGRateStudies/interface/PackedColumns.h"
+#include "SLHCUpgradeSimulations/L1EGRateStudies/test/TestChecks.h"
+
+using l1eg::test::check;
+
+namespace {
+
+std::string format(const char * fmt, double a, double b = 0., double c = 0.)
+{
+   char text[256];
+   std::snprintf(text, sizeof(text), fmt, a, b, c);
+   return text;
+}
+
+float fromBits(uint32_t u)
+{
+   float x;
+   std::memcpy(&x, &u, sizeof(x));
+   return x;
+}
+
+void testTruncateMantissa()
+{
+   // Ties go to the even neighbour: 1+2^-11 is halfway between 1 and 1+2^-10
+   check(l1eg::truncateMantissa(1.f + std::ldexp(1.f, -11), 10) == 1.f, "mantissa:10 tie rounds down to even");
+   check(l1eg::truncateMantissa(1.f + 3*std::ldexp(1.f, -11), 10) == 1.f + std::ldexp(1.f, -9), "mantissa:10 tie rounds up to even");
+   check(l1eg::truncateMantissa(1.f + std::ldexp(1.f, -11) + std::ldexp(1.f, -20), 10) == 1.f + std::ldexp(1.f, -10), "mantissa:10 above the tie rounds up");
+   // Carry into the exponent
+   check(l1eg::truncateMantissa(fromBits(0x3fffffff), 10) == 2.f, "mantissa:10 carry into the exponent");
+   check(l1eg::truncateMantissa(-1.5f, 4) == -1.5f, "mantissa:4 exact value");
+   check(l1eg::truncateMantissa(0.f, 8) == 0.f, "mantissa:8 zero");
+   check(std::isinf(l1eg::truncateMantissa(std::numeric_limits<float>::infinity(), 8)), "mantissa:8 infinity");
+   check(std::isnan(l1eg::truncateMantissa(std::numeric_limits<float>::quiet_NaN(), 8)), "mantissa:8 NaN");
+   check(l1eg::truncateMantissa(3.14159f, 23) == 3.14159f, "mantissa:23 unchanged");
+
+   for(unsigned bits : {4u, 8u, 10u, 12u, 16u})
+   {
+      double worst = 0.;
+      bool idempotent = true;
+      bool symmetric = true;
+      for(int i=0; i<100000; ++i)
+      {
+         const float x = std::ldexp(1.f + i/100000.f, i%40 - 20);
+         const float t = l1eg::truncateMantissa(x, bits);
+         worst = std::max(worst, std::fabs(double(t)-x)/x);
+         idempotent = idempotent && l1eg::truncateMantissa(t, bits) == t;
+         symmetric = symmetric && l1eg::truncateMantissa(-x, bits) == -t;
+      }
+      check(worst <= std::ldexp(1., -int(bits)-1), format("mantissa:%g relative error %g above half a step", bits, worst));
+      check(idempotent, format("mantissa:%g not idempotent", bits));
+      check(symmetric, format("mantissa:%g not symmetric in sign", bits));
+   }
+}
+
+void testFixed()
+{
+   for(const char * spec : {"fixed:-3:3:12", "fixed:0:1:10", "fixed:0:255:8", "fixed:-1:1:16"})
+   {
+      const auto p = l1eg::ColumnPrecision::parse(spec);
+      check(p.str() == spec, std::string(spec)+" does not print back as itself");
+      const uint32_t maxCode = (1u << p.bits)-1;
+      check(l1eg::encodeFixed(p.low, p) == 0 && l1eg::decodeFixed(0, p) == p.low, std::string(spec)+" low end");
+      check(l1eg::encodeFixed(p.high, p) == maxCode && std::fabs(l1eg::decodeFixed(maxCode, p) - p.high) < 1e-6*(p.high-p.low), std::string(spec)+" high end");
+      check(l1eg::encodeFixed(p.low - 1.f, p) == 0 && l1eg::encodeFixed(p.high + 1.f, p) == maxCode, std::string(spec)+" clamping");
+      check(l1eg::encodeFixed(std::numeric_limits<float>::quiet_NaN(), p) == 0, std::string(spec)+" NaN");
+      double worst = 0.;
+      bool codes = true;
+      for(int i=0; i<=10000; ++i)
+      {
+         const float x = p.low + (p.high-p.low)*i/10000.;
+         const uint16_t code = l1eg::encodeFixed(x, p);
+         worst = std::max(worst, std::fabs(double(l1eg::decodeFixed(code, p)) - x));
+         codes = codes && l1eg::encodeFixed(l1eg::decodeFixed(code, p), p) == code;
+      }
+      // Half a step, plus the float rounding of the decoded value
+      const double tolerance = p.lsb()/2. + std::max(std::fabs(p.low), std::fabs(p.high))*std::numeric_limits<float>::epsilon();
+      check(worst <= tolerance, std::string(spec)+format(" error %g above half a step %g", worst, p.lsb()/2.));
+      check(codes, std::string(spec)+" decoded values do not encode to the same code");
+   }
+}
+
+void testSaturate()
+{
+   check(l1eg::saturate<int8_t>(200.) == 127 && l1eg::saturate<int8_t>(-200.) == -128, "int:8 saturation");
+   check(l1eg::saturate<int16_t>(1e9) == 32767 && l1eg::saturate<int16_t>(-1e9) == -32768, "int:16 saturation");
+   check(l1eg::saturate<int32_t>(1e12) == std::numeric_limits<int32_t>::max(), "int:32 saturation");
+   check(l1eg::saturate<int8_t>(2.5) == 3 && l1eg::saturate<int8_t>(-2.5) == -2 && l1eg::saturate<int8_t>(-2.6) == -3, "int rounding");
+   check(l1eg::saturate<int8_t>(std::numeric_limits<double>::quiet_NaN()) == 0, "int NaN");
+}
+
+struct Record {
+   float mantissa = 0.;
+   float fixed = 0.;
+   float array[3] = {0., 0., 0.};
+   int count = 0;
+   bool flags[3] = {false, false, false};
+};
+
+double read(TTree& tree, Long64_t entry, const char * expression)
+{
+   TTreeFormula formula("formula", expression, &tree);
+   tree.GetEntry(entry);
+   formula.GetNdata();
+   return formula.EvalInstance();
+}
+
+void testTree(bool packed)
+{
+   const std::string mode = packed ? "packed " : "unpacked ";
+   Record r;
+   l1eg::PackedColumns columns(packed, {"overridden=mantissa:4"});
+   columns.add("mantissa", &r.mantissa, "mantissa:10");
+   columns.add("overridden", &r.mantissa, "full");
+   columns.add("fixed", &r.fixed, "fixed:-3:3:12");
+   columns.add("array", r.array, "mantissa:8", 3);
+   columns.add("count", &r.count, "int:8");
+   columns.add("first", &r.flags[0], "flag");
+   columns.add("second", &r.flags[1], "flag");
+   columns.add("third", &r.flags[2], "flag");
+
+   TTree tree("packed_tree", "PackedColumns round trip");
+   tree.SetDirectory(nullptr);
+   columns.book(&tree);
+
+   std::vector<Record> written;
+   for(int i=0; i<64; ++i)
+   {
+      r.mantissa = 1.f + i*0.01234f;
+      r.fixed = -3.5f + i*0.111f;
+      for(int j=0; j<3; ++j) r.array[j] = 10.f*j + i*0.777f;
+      r.count = 4*i - 100;
+      for(int j=0; j<3; ++j) r.flags[j] = (i >> j) & 1;
+      columns.pack();
+      tree.Fill();
+      written.push_back(r);
+   }
+   check(tree.GetEntries() == Long64_t(written.size()), mode+"entry count");
+
+   const auto fixed = l1eg::ColumnPrecision::parse("fixed:-3:3:12");
+   for(size_t i=0; i<written.size(); ++i)
+   {
+      const Record& w = written[i];
+      const std::string entry = mode+"entry "+std::to_string(i)+": ";
+      const float mantissa = packed ? l1eg::truncateMantissa(w.mantissa, 10) : w.mantissa;
+      const float overridden = packed ? l1eg::truncateMantissa(w.mantissa, 4) : w.mantissa;
+      const double fixedValue = packed ? l1eg::decodeFixed(l1eg::encodeFixed(w.fixed, fixed), fixed) : w.fixed;
+      const int count = packed ? l1eg::saturate<int8_t>(w.count) : w.count;
+      check(float(read(tree, i, "mantissa")) == mantissa, entry+"mantissa");
+      check(float(read(tree, i, "overridden")) == overridden, entry+"override");
+      check(std::fabs(read(tree, i, "fixed") - fixedValue) < 1e-5, entry+"fixed");
+      for(int j=0; j<3; ++j)
+      {
+         const float value = packed ? l1eg::truncateMantissa(w.array[j], 8) : w.array[j];
+         check(float(read(tree, i, ("array["+std::to_string(j)+"]").c_str())) == value, entry+"array");
+      }
+      check(int(read(tree, i, "count")) == count, entry+"count");
+      check((read(tree, i, "first") != 0.) == w.flags[0], entry+"first flag");
+      check((read(tree, i, "second") != 0.) == w.flags[1], entry+"second flag");
+      check((read(tree, i, "third") != 0.) == w.flags[2], entry+"third flag");
+      check((read(tree, i, "first && !third") != 0.) == (w.flags[0] && !w.flags[2]), entry+"flag expression");
+   }
+   // Selections as the drawing macros use them
+   Long64_t selected = 0;
+   for(const auto& w : written) selected += w.flags[1] && w.mantissa > 1.3f;
+   check(tree.Draw("mantissa", "second && mantissa > 1.3", "goff") == selected, mode+"Draw selection on a flag");
+   check(std::string(tree.GetUserInfo()->FindObject("columnPrecision")->GetTitle()).find(packed ? "fixed=fixed:-3:3:12" : "fixed=full") != std::string::npos,
+         mode+"columnPrecision user info");
+}
+
+} // namespace
+
+int main()
+{
+   testTruncateMantissa();
+   testFixed();
+   testSaturate();
+   testTree(false);
+   testTree(true);
+   std::printf("testPackedColumns: %d failures\n", l1eg::test::failures());
+   return l1eg::test::exitStatus();
+}